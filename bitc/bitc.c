@@ -22,6 +22,44 @@
 #include <bitc/ast.h>
 #include <bitc/compiler.h>
 #include <bitc/pass.h>
+#include <bitc/proto.h>
+
+/* extract source name from input path */
+static void source_name_of(const char* input, char* src_name) {
+  const char* base = strrchr(input, '/');
+  if (!base) base = strrchr(input, '\\');
+  if (!base) base = input; else base++;
+  const char* dot = strrchr(base, '.');
+  int n = dot ? (int)(dot - base) : (int)strlen(base);
+  if (n > 200) n = 200;
+  memcpy(src_name, base, n);
+  src_name[n] = '\0';
+}
+
+static int compile_proto(const char* input, const char* output, int argc, char** argv) {
+  char src_name[256];
+  source_name_of(input, src_name);
+
+  compiler_t cc;
+  memset(&cc, 0, sizeof(cc));
+  cc.argc = argc;
+  cc.argv = argv;
+  cc.emit = default_emit;
+  cc.out = output ? fopen(output, "w") : stdout;
+  if (!cc.out) die("cannot open output '%s'", output);
+
+  int errors = proto_compile(&cc, input, src_name);
+  if (output) fclose(cc.out);
+
+  if (errors > 0) {
+    fprintf(stderr, "bitc: %d error(s) in %s\n", errors, input);
+    if (output) remove(output);
+    return 1;
+  }
+
+  if (output) printf("bitc wrotes result to %s\n", output);
+  return 0;
+}
 
 int main(int argc, char** argv) {
   const char* input  = NULL;
@@ -45,10 +83,14 @@ int main(int argc, char** argv) {
   }
 
   if (!input) {
-    fprintf(stderr, "Usage: bitc <input.bit> [-o <output.h>] [-I <bits_dir>] [--plugin <path>] [--optimize]\n");
+    fprintf(stderr, "Usage: bitc <input.bit|input.proto> [-o <output.h>] [-I <bits_dir>] [--plugin <path>] [--optimize]\n");
     return 1;
   }
 
+  /* .proto files have their own frontend */
+  if (proto_is_source(input))
+    return compile_proto(input, output, argc, argv);
+
   /* lex */
   lexer_t lex;
   lexer_open(&lex, input);
@@ -72,16 +114,7 @@ int main(int argc, char** argv) {
 
   /* extract source name from input path */
   char src_name[256];
-  {
-    const char* base = strrchr(input, '/');
-    if (!base) base = strrchr(input, '\\');
-    if (!base) base = input; else base++;
-    const char* dot = strrchr(base, '.');
-    int n = dot ? (int)(dot - base) : (int)strlen(base);
-    if (n > 200) n = 200;
-    memcpy(src_name, base, n);
-    src_name[n] = '\0';
-  }
+  source_name_of(input, src_name);
 
   /* init compiler context */
   compiler_t cc;
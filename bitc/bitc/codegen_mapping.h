@@ -21,6 +21,7 @@ bool endian_overrides(node_t* f, const char** out, const char* type_map(const ch
 const char* field_put_for(node_t* f);
 const char* field_get_for(node_t* f);
 const char* attr_to_prefix(const char* attr);
+const char* prefix_token(const char* prefix);
 bool attr_is_prefix(const char* a);
 
 #endif /* _BITC_CODEGEN_MAPPING_H_ */
\ No newline at end of file
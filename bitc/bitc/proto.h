@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2026 TheSnowfield
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#ifndef _BITC_PROTO_H_
+#define _BITC_PROTO_H_
+
+#include <stdbool.h>
+
+typedef struct compiler_t compiler_t;
+
+/* ── .proto frontend ──
+ *
+ * A proto3 subset: messages, nested messages and enums, scalar fields,
+ * repeated (packed by default) and optional fields. Every message gets
+ * a plain C struct and straight-line size/write/read functions, the
+ * tag bytes are constants in the generated code.
+ */
+
+/* whether the input is a .proto file */
+bool proto_is_source(const char* path);
+
+/* compile a .proto file into a C header, returns the error count */
+int proto_compile(compiler_t* cc, const char* input, const char* source_name);
+
+#endif /* _BITC_PROTO_H_ */
@@ -35,6 +35,7 @@ typedef enum {
   TOK_MINUS,         /* - */
   TOK_ARROW,         /* -> */
   TOK_DOLLAR,        /* $ */
+  TOK_EQUALS,        /* = */
 } token_type_t;
 
 static inline const char* tok_name(token_type_t t) {
@@ -61,6 +62,7 @@ static inline const char* tok_name(token_type_t t) {
     case TOK_MINUS:     return "-";
     case TOK_ARROW:     return "->";
     case TOK_DOLLAR:    return "$";
+    case TOK_EQUALS:    return "=";
     default:            return "?";
   }
 }
@@ -95,11 +95,15 @@ const char* attr_to_prefix(const char* attr) {
     if (strstr(attr, "with-uint16") && strstr(attr, "le"))  return "prefix_uint16le";
     if (strstr(attr, "with-uint32") && strstr(attr, "be"))  return "prefix_uint32be";
     if (strstr(attr, "with-uint32") && strstr(attr, "le"))  return "prefix_uint32le";
-
-    // bytelizer has no uint64 prefix definitions
-    // if (strstr(attr, "with-uint64") && strstr(attr, "be"))  return "prefix_uint64be";
-    // if (strstr(attr, "with-uint64") && strstr(attr, "le"))  return "prefix_uint64le";
+    if (strstr(attr, "with-uint64") && strstr(attr, "be"))  return "prefix_uint64be";
+    if (strstr(attr, "with-uint64") && strstr(attr, "le"))  return "prefix_uint64le";
     return NULL;
 }
 
+/* "prefix_uint16be" -> "uint16be", for the specialized barrier macros */
+const char* prefix_token(const char* prefix) {
+    if (prefix && strncmp(prefix, "prefix_", 7) == 0) return prefix + 7;
+    return prefix;
+}
+
 bool attr_is_prefix(const char* a) { return strstr(a, "with-uint") != NULL; }
\ No newline at end of file
@@ -251,7 +251,7 @@ static void generate_field(compiler_t* cc, node_t* f, type_registry_t* reg,
                 if (outer_pfx) {
                     outer_bid = next_uid(cc);
                     emitf(cc, "%s/* [%s] */\n", indent, outer_pfx);
-                    emitf(cc, "%sbytelizer_barrier_enter(b%d, %s, %s);\n", indent, outer_bid, ctx_var, outer_pfx);
+                    emitf(cc, "%sbytelizer_barrier_enter_static(b%d, %s, length_only, %s);\n", indent, outer_bid, ctx_var, prefix_token(outer_pfx));
                 }
                 int matched[64] = {0};
                 for (int ci = 0; ci < 64; ci++) matched[ci] = 0;
@@ -286,10 +286,10 @@ static void generate_field(compiler_t* cc, node_t* f, type_registry_t* reg,
                         if (pfx) {
                             int uid = next_uid(cc);
                             emitf(cc, "%s/* [%s] */\n", indent, pfx);
-                            emitf(cc, "%sbytelizer_barrier_enter(b%d, %s, %s);\n", indent, uid, ctx_var, pfx);
+                            emitf(cc, "%sbytelizer_barrier_enter_static(b%d, %s, length_only, %s);\n", indent, uid, ctx_var, prefix_token(pfx));
                             if (gen->first_child)
                                 generate_body(cc, gen, reg, ctx_var, depth+1, dir);
-                            emitf(cc, "%sbytelizer_barrier_leave(b%d);\n", indent, uid);
+                            emitf(cc, "%sbytelizer_barrier_leave_static(b%d, length_only, %s);\n", indent, uid, prefix_token(pfx));
                         } else if (gen->first_child) {
                             generate_body(cc, gen, reg, ctx_var, depth, dir);
                         }
@@ -318,7 +318,7 @@ static void generate_field(compiler_t* cc, node_t* f, type_registry_t* reg,
                                 of->line, of->name ? of->name : "(anonymous)", f->name, f->basetype);
             }
             if (outer_pfx)
-                emitf(cc, "%sbytelizer_barrier_leave(b%d);\n", indent, outer_bid);
+                emitf(cc, "%sbytelizer_barrier_leave_static(b%d, length_only, %s);\n", indent, outer_bid, prefix_token(outer_pfx));
             return;
         }
         if (!put) {
@@ -457,7 +457,7 @@ static void generate_body(compiler_t* cc, node_t* block, type_registry_t* reg,
                 int bid = xpfx ? next_uid(cc) : -1;
                 if (xpfx) {
                     emitf(cc, "%s/* [%s] */\n", in, xpfx);
-                    emitf(cc, "%sbytelizer_barrier_enter(b%d, %s, %s);\n", in, bid, ctx_var, xpfx);
+                    emitf(cc, "%sbytelizer_barrier_enter_static(b%d, %s, length_only, %s);\n", in, bid, ctx_var, prefix_token(xpfx));
                 }
                 emitf(cc, "%s/* transform: %s(%s) */\n", in, xname, c->param);
                 emitf(cc, "%sbytelizer_alloc(_bx%d, 512);\n", in, xid);
@@ -470,7 +470,7 @@ static void generate_body(compiler_t* cc, node_t* block, type_registry_t* reg,
                 emitf(cc, "%s  bytelizer_put_bytelizer(%s, _bx%d);\n", in, ctx_var, xid);
                 emitf(cc, "%s}\n", in);
                 emitf(cc, "%sbytelizer_destroy(_bx%d);\n", in, xid);
-                if (xpfx) emitf(cc, "%sbytelizer_barrier_leave(b%d);\n", in, bid);
+                if (xpfx) emitf(cc, "%sbytelizer_barrier_leave_static(b%d, length_only, %s);\n", in, bid, prefix_token(xpfx));
             } else if (c->param && dir == DIR_UNPACK) {
                 int xid = next_uid(cc);
                 const char* xname = c->name ? c->name : "anon";
@@ -510,9 +510,9 @@ static void generate_block_full(compiler_t* cc, node_t* block, type_registry_t*
     if (pfx && dir == DIR_PACK) {
         int uid = next_uid(cc);
         emitf(cc, "%s/* [%s] */\n", in, pfx);
-        emitf(cc, "%sbytelizer_barrier_enter(b%d, %s, %s);\n", in, uid, ctx_var, pfx);
+        emitf(cc, "%sbytelizer_barrier_enter_static(b%d, %s, length_only, %s);\n", in, uid, ctx_var, prefix_token(pfx));
         generate_body(cc, block, reg, ctx_var, depth, dir);
-        emitf(cc, "%sbytelizer_barrier_leave(b%d);\n", in, uid);
+        emitf(cc, "%sbytelizer_barrier_leave_static(b%d, length_only, %s);\n", in, uid, prefix_token(pfx));
     } else if (pfx && dir == DIR_UNPACK) {
         int uid = next_uid(cc);
         emitf(cc, "%s/* [%s] -- skip length prefix */\n", in, pfx);
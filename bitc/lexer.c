@@ -136,6 +136,7 @@ static void lexer_fill(lexer_t* l, token_t* tk) {
     case ')': tk->type = TOK_RPAREN;   break;
     case '*': tk->type = TOK_STAR;     break;
     case '$': tk->type = TOK_DOLLAR;   break;
+    case '=': tk->type = TOK_EQUALS;   break;
     case '-':
       if (p < end && src[p] == '>') {
         p++; l->pos = p; l->col++;
@@ -0,0 +1,1032 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2026 TheSnowfield
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+
+#include <bitc/bitc.h>
+#include <bitc/lexer.h>
+#include <bitc/compiler.h>
+#include <bitc/utils.h>
+#include <bitc/proto.h>
+
+/* ================================================================
+ *  MODEL
+ * ================================================================ */
+
+typedef enum {
+  PROTO_DOUBLE, PROTO_FLOAT,
+  PROTO_INT32, PROTO_INT64, PROTO_UINT32, PROTO_UINT64,
+  PROTO_SINT32, PROTO_SINT64,
+  PROTO_FIXED32, PROTO_FIXED64, PROTO_SFIXED32, PROTO_SFIXED64,
+  PROTO_BOOL, PROTO_STRING, PROTO_BYTES,
+  PROTO_ENUM, PROTO_MESSAGE,
+} proto_kind_t;
+
+enum {
+  WIRE_VARINT    = 0,
+  WIRE_64BIT     = 1,
+  WIRE_DELIMITED = 2,
+  WIRE_32BIT     = 5,
+};
+
+typedef struct {
+  const char*  name;
+  proto_kind_t kind;
+  const char*  ctype;
+  int          wire;
+} proto_scalar_t;
+
+static const proto_scalar_t proto_scalars[] = {
+  { "double",   PROTO_DOUBLE,   "double",              WIRE_64BIT     },
+  { "float",    PROTO_FLOAT,    "float",               WIRE_32BIT     },
+  { "int32",    PROTO_INT32,    "int32_t",             WIRE_VARINT    },
+  { "int64",    PROTO_INT64,    "int64_t",             WIRE_VARINT    },
+  { "uint32",   PROTO_UINT32,   "uint32_t",            WIRE_VARINT    },
+  { "uint64",   PROTO_UINT64,   "uint64_t",            WIRE_VARINT    },
+  { "sint32",   PROTO_SINT32,   "int32_t",             WIRE_VARINT    },
+  { "sint64",   PROTO_SINT64,   "int64_t",             WIRE_VARINT    },
+  { "fixed32",  PROTO_FIXED32,  "uint32_t",            WIRE_32BIT     },
+  { "fixed64",  PROTO_FIXED64,  "uint64_t",            WIRE_64BIT     },
+  { "sfixed32", PROTO_SFIXED32, "int32_t",             WIRE_32BIT     },
+  { "sfixed64", PROTO_SFIXED64, "int64_t",             WIRE_64BIT     },
+  { "bool",     PROTO_BOOL,     "bool",                WIRE_VARINT    },
+  { "string",   PROTO_STRING,   "bytelizer_pbslice_t", WIRE_DELIMITED },
+  { "bytes",    PROTO_BYTES,    "bytelizer_pbslice_t", WIRE_DELIMITED },
+};
+
+typedef struct proto_enum_t {
+  char*  path;     /* Outer.Kind */
+  char*  cname;    /* Outer_Kind */
+  char** names;
+  long long* values;
+  int    count;
+} proto_enum_t;
+
+typedef struct proto_message_t proto_message_t;
+
+typedef struct {
+  char*        name;
+  char*        type;
+  proto_kind_t kind;
+  int          wire;
+  uint32_t     tag;
+  bool         repeated;
+  bool         packed;
+  bool         optional;
+  int          line;
+  proto_message_t* message;
+  proto_enum_t*    enumeration;
+} proto_field_t;
+
+struct proto_message_t {
+  char* path;      /* Outer.Inner */
+  char* cname;     /* Outer_Inner */
+  proto_field_t* fields;
+  int   count;
+  int   state;     /* sorting: 0 pending, 1 in progress, 2 done */
+};
+
+typedef struct {
+  lexer_t lex;
+  char*   package;
+  proto_message_t** messages;
+  int     message_count;
+  proto_enum_t** enums;
+  int     enum_count;
+  proto_message_t** order;
+  int     order_count;
+  int     errors;
+} proto_file_t;
+
+static void proto_error(proto_file_t* pf, int line, const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  fprintf(stderr, "bitc: error: line %d: ", line);
+  vfprintf(stderr, fmt, ap);
+  fprintf(stderr, "\n");
+  va_end(ap);
+  pf->errors++;
+}
+
+static char* proto_join(const char* scope, const char* sep, const char* name) {
+  if (!scope) return xstrdup(name);
+  size_t n = strlen(scope) + strlen(sep) + strlen(name) + 1;
+  char* s = (char*)malloc(n);
+  if (!s) die("oom");
+  snprintf(s, n, "%s%s%s", scope, sep, name);
+  return s;
+}
+
+static const proto_scalar_t* proto_find_scalar(const char* name) {
+  for (size_t i = 0; i < sizeof(proto_scalars) / sizeof(proto_scalars[0]); i++)
+    if (strcmp(proto_scalars[i].name, name) == 0) return &proto_scalars[i];
+  return NULL;
+}
+
+static const char* proto_kind_ctype(proto_kind_t kind) {
+  for (size_t i = 0; i < sizeof(proto_scalars) / sizeof(proto_scalars[0]); i++)
+    if (proto_scalars[i].kind == kind) return proto_scalars[i].ctype;
+  return "int32_t";
+}
+
+/* ================================================================
+ *  PARSER
+ * ================================================================ */
+
+static char* proto_expect_ident(proto_file_t* pf) {
+  lexer_t* l = &pf->lex;
+  if (l->current.type != TOK_IDENT)
+    die("bitc: error: line %d: expected identifier but got '%s'", l->current.line, l->current.text);
+  char* s = xstrdup(l->current.text);
+  lexer_next(l);
+  return s;
+}
+
+static long long proto_expect_number(proto_file_t* pf) {
+  lexer_t* l = &pf->lex;
+  bool negative = lexer_match(l, TOK_MINUS);
+  if (l->current.type != TOK_NUMBER)
+    die("bitc: error: line %d: expected number but got '%s'", l->current.line, l->current.text);
+
+  char* end;
+  long long v = strtoll(l->current.text, &end, 0);
+  if (*end != '\0')
+    die("bitc: error: line %d: invalid number '%s'", l->current.line, l->current.text);
+
+  lexer_next(l);
+  return negative ? -v : v;
+}
+
+/* a.b.c or .a.b.c */
+static char* proto_parse_type(proto_file_t* pf) {
+  lexer_t* l = &pf->lex;
+  char buf[512] = "";
+  if (lexer_match(l, TOK_DOT)) strcat(buf, ".");
+  for (;;) {
+    char* part = proto_expect_ident(pf);
+    if (strlen(buf) + strlen(part) + 2 > sizeof(buf))
+      die("bitc: error: line %d: type name is too long", l->current.line);
+    strcat(buf, part);
+    free(part);
+    if (!lexer_match(l, TOK_DOT)) break;
+    strcat(buf, ".");
+  }
+  return xstrdup(buf);
+}
+
+/* skip to the end of a statement, an aggregate value may hold braces */
+static void proto_skip_statement(proto_file_t* pf) {
+  lexer_t* l = &pf->lex;
+  int depth = 0;
+  while (l->current.type != TOK_EOF) {
+    if (l->current.type == TOK_LBRACE) depth++;
+    if (l->current.type == TOK_RBRACE) depth--;
+    if (depth == 0 && l->current.type == TOK_SEMICOLON) { lexer_next(l); return; }
+    lexer_next(l);
+  }
+}
+
+static void proto_skip_block(proto_file_t* pf) {
+  lexer_t* l = &pf->lex;
+  while (l->current.type != TOK_LBRACE && l->current.type != TOK_EOF) lexer_next(l);
+  int depth = 0;
+  while (l->current.type != TOK_EOF) {
+    if (l->current.type == TOK_LBRACE) depth++;
+    if (l->current.type == TOK_RBRACE && --depth == 0) { lexer_next(l); return; }
+    lexer_next(l);
+  }
+}
+
+/* [packed = false, deprecated = true, (custom) = 1] */
+static void proto_parse_field_options(proto_file_t* pf, proto_field_t* f) {
+  lexer_t* l = &pf->lex;
+  do {
+    char name[128] = "";
+    if (lexer_match(l, TOK_LPAREN)) {
+      while (l->current.type != TOK_RPAREN && l->current.type != TOK_EOF) lexer_next(l);
+      lexer_expect(l, TOK_RPAREN);
+      while (lexer_match(l, TOK_DOT)) free(proto_expect_ident(pf));
+    } else {
+      char* s = proto_parse_type(pf);
+      snprintf(name, sizeof(name), "%s", s);
+      free(s);
+    }
+    lexer_expect(l, TOK_EQUALS);
+
+    /* a negative number */
+    lexer_match(l, TOK_MINUS);
+    if (l->current.type != TOK_IDENT && l->current.type != TOK_NUMBER && l->current.type != TOK_STRING)
+      die("bitc: error: line %d: invalid option value '%s'", l->current.line, l->current.text);
+
+    if (strcmp(name, "packed") == 0) {
+      if (strcmp(l->current.text, "true") == 0) f->packed = true;
+      else if (strcmp(l->current.text, "false") == 0) f->packed = false;
+      else proto_error(pf, l->current.line, "packed must be true or false");
+    }
+    lexer_next(l);
+  } while (lexer_match(l, TOK_COMMA));
+  lexer_expect(l, TOK_RBRACKET);
+}
+
+static void proto_parse_enum(proto_file_t* pf, const char* scope_path, const char* scope_cname) {
+  lexer_t* l = &pf->lex;
+  char* name = proto_expect_ident(pf);
+
+  proto_enum_t* e = (proto_enum_t*)calloc(1, sizeof(proto_enum_t));
+  if (!e) die("oom");
+  e->path  = proto_join(scope_path, ".", name);
+  e->cname = proto_join(scope_cname, "_", name);
+  free(name);
+
+  pf->enums = (proto_enum_t**)realloc(pf->enums, (pf->enum_count + 1) * sizeof(proto_enum_t*));
+  pf->enums[pf->enum_count++] = e;
+
+  lexer_expect(l, TOK_LBRACE);
+  while (!lexer_match(l, TOK_RBRACE)) {
+    if (l->current.type == TOK_EOF)
+      die("bitc: error: line %d: unterminated enum '%s'", l->current.line, e->path);
+    if (lexer_match(l, TOK_SEMICOLON)) continue;
+    if (lexer_match_ident(l, "option") || lexer_match_ident(l, "reserved")) {
+      proto_skip_statement(pf);
+      continue;
+    }
+
+    int line = l->current.line;
+    char* value = proto_expect_ident(pf);
+    lexer_expect(l, TOK_EQUALS);
+    long long v = proto_expect_number(pf);
+    if (lexer_match(l, TOK_LBRACKET)) {
+      proto_field_t ignored = {0};
+      proto_parse_field_options(pf, &ignored);
+    }
+    lexer_expect(l, TOK_SEMICOLON);
+
+    if (v < INT32_MIN || v > INT32_MAX)
+      proto_error(pf, line, "enum value %s of '%s' is out of the int32 range", value, e->path);
+    if (e->count == 0 && v != 0)
+      proto_error(pf, line, "the first value of enum '%s' must be zero in proto3", e->path);
+
+    e->names  = (char**)realloc(e->names, (e->count + 1) * sizeof(char*));
+    e->values = (long long*)realloc(e->values, (e->count + 1) * sizeof(long long));
+    e->names[e->count]  = value;
+    e->values[e->count] = v;
+    e->count++;
+  }
+
+  if (e->count == 0)
+    proto_error(pf, l->current.line, "enum '%s' has no value", e->path);
+}
+
+static void proto_parse_message(proto_file_t* pf, const char* scope_path, const char* scope_cname) {
+  lexer_t* l = &pf->lex;
+  char* name = proto_expect_ident(pf);
+
+  proto_message_t* m = (proto_message_t*)calloc(1, sizeof(proto_message_t));
+  if (!m) die("oom");
+  m->path  = proto_join(scope_path, ".", name);
+  m->cname = proto_join(scope_cname, "_", name);
+  free(name);
+
+  pf->messages = (proto_message_t**)realloc(pf->messages, (pf->message_count + 1) * sizeof(proto_message_t*));
+  pf->messages[pf->message_count++] = m;
+
+  lexer_expect(l, TOK_LBRACE);
+  while (!lexer_match(l, TOK_RBRACE)) {
+    int line = l->current.line;
+
+    if (l->current.type == TOK_EOF)
+      die("bitc: error: line %d: unterminated message '%s'", line, m->path);
+    if (lexer_match(l, TOK_SEMICOLON)) continue;
+
+    if (lexer_match_ident(l, "message")) { proto_parse_message(pf, m->path, m->cname); continue; }
+    if (lexer_match_ident(l, "enum"))    { proto_parse_enum(pf, m->path, m->cname); continue; }
+    if (lexer_match_ident(l, "option") || lexer_match_ident(l, "reserved")) {
+      proto_skip_statement(pf);
+      continue;
+    }
+    if (l->current.type == TOK_IDENT &&
+        (strcmp(l->current.text, "oneof") == 0 || strcmp(l->current.text, "map") == 0 ||
+         strcmp(l->current.text, "group") == 0 || strcmp(l->current.text, "extensions") == 0))
+      die("bitc: error: line %d: '%s' is not supported by the proto frontend", line, l->current.text);
+
+    proto_field_t f = {0};
+    f.line = line;
+    if (lexer_match_ident(l, "repeated")) f.repeated = true;
+    else if (lexer_match_ident(l, "optional")) f.optional = true;
+    else if (l->current.type == TOK_IDENT && strcmp(l->current.text, "required") == 0)
+      die("bitc: error: line %d: 'required' is not a proto3 label", line);
+
+    f.type = proto_parse_type(pf);
+    f.name = proto_expect_ident(pf);
+    lexer_expect(l, TOK_EQUALS);
+    long long tag = proto_expect_number(pf);
+
+    /* proto3 packs repeated scalars unless told otherwise */
+    const proto_scalar_t* scalar = proto_find_scalar(f.type);
+    f.packed = f.repeated;
+    if (lexer_match(l, TOK_LBRACKET)) proto_parse_field_options(pf, &f);
+    lexer_expect(l, TOK_SEMICOLON);
+
+    if (tag < 1 || tag > (1 << 29) - 1 || (tag >= 19000 && tag <= 19999))
+      proto_error(pf, line, "invalid field number %lld of '%s.%s'", tag, m->path, f.name);
+    f.tag = (uint32_t)tag;
+
+    if (scalar) {
+      f.kind = scalar->kind;
+      f.wire = scalar->wire;
+    } else {
+      f.kind = PROTO_MESSAGE;   /* resolved later */
+      f.wire = WIRE_DELIMITED;
+    }
+
+    for (int i = 0; i < m->count; i++) {
+      if (m->fields[i].tag == f.tag)
+        proto_error(pf, line, "field number %u is used twice in '%s'", f.tag, m->path);
+      if (strcmp(m->fields[i].name, f.name) == 0)
+        proto_error(pf, line, "field '%s' is declared twice in '%s'", f.name, m->path);
+    }
+
+    m->fields = (proto_field_t*)realloc(m->fields, (m->count + 1) * sizeof(proto_field_t));
+    m->fields[m->count++] = f;
+  }
+}
+
+static void proto_parse_file(proto_file_t* pf) {
+  lexer_t* l = &pf->lex;
+  while (l->current.type != TOK_EOF) {
+    int line = l->current.line;
+    if (lexer_match(l, TOK_SEMICOLON)) continue;
+
+    if (lexer_match_ident(l, "syntax")) {
+      lexer_expect(l, TOK_EQUALS);
+      if (l->current.type != TOK_STRING || strcmp(l->current.text, "proto3") != 0)
+        proto_error(pf, line, "only proto3 is supported");
+      lexer_next(l);
+      lexer_expect(l, TOK_SEMICOLON);
+    }
+    else if (lexer_match_ident(l, "package")) {
+      free(pf->package);
+      pf->package = proto_parse_type(pf);
+      lexer_expect(l, TOK_SEMICOLON);
+    }
+    else if (lexer_match_ident(l, "import")) {
+      proto_error(pf, line, "imports are not supported, declare the types in one file");
+      proto_skip_statement(pf);
+    }
+    else if (lexer_match_ident(l, "option")) proto_skip_statement(pf);
+    else if (lexer_match_ident(l, "service")) proto_skip_block(pf);
+    else if (lexer_match_ident(l, "message")) proto_parse_message(pf, NULL, NULL);
+    else if (lexer_match_ident(l, "enum")) proto_parse_enum(pf, NULL, NULL);
+    else die("bitc: error: line %d: unexpected '%s'", line, l->current.text);
+  }
+}
+
+/* ================================================================
+ *  TYPE RESOLUTION
+ * ================================================================ */
+
+static bool proto_lookup(proto_file_t* pf, const char* path, proto_field_t* f) {
+  for (int i = 0; i < pf->message_count; i++)
+    if (strcmp(pf->messages[i]->path, path) == 0) {
+      f->kind = PROTO_MESSAGE;
+      f->wire = WIRE_DELIMITED;
+      f->message = pf->messages[i];
+      return true;
+    }
+  for (int i = 0; i < pf->enum_count; i++)
+    if (strcmp(pf->enums[i]->path, path) == 0) {
+      f->kind = PROTO_ENUM;
+      f->wire = WIRE_VARINT;
+      f->enumeration = pf->enums[i];
+      return true;
+    }
+  return false;
+}
+
+/* the innermost scope wins, like protoc */
+static bool proto_resolve_type(proto_file_t* pf, const proto_message_t* m, proto_field_t* f) {
+  const char* type = f->type;
+
+  /* the package is not part of the generated names */
+  size_t plen = pf->package ? strlen(pf->package) : 0;
+  if (type[0] == '.') {
+    type++;
+    if (plen && strncmp(type, pf->package, plen) == 0 && type[plen] == '.') type += plen + 1;
+    return proto_lookup(pf, type, f);
+  }
+  if (plen && strncmp(type, pf->package, plen) == 0 && type[plen] == '.' &&
+      proto_lookup(pf, type + plen + 1, f))
+    return true;
+
+  char scope[512];
+  snprintf(scope, sizeof(scope), "%s", m->path);
+  for (;;) {
+    char* path = proto_join(scope, ".", type);
+    bool found = proto_lookup(pf, path, f);
+    free(path);
+    if (found) return true;
+
+    char* dot = strrchr(scope, '.');
+    if (!dot) break;
+    *dot = '\0';
+  }
+  return proto_lookup(pf, type, f);
+}
+
+static void proto_resolve(proto_file_t* pf) {
+  for (int i = 0; i < pf->message_count; i++) {
+    proto_message_t* m = pf->messages[i];
+    for (int j = 0; j < m->count; j++) {
+      proto_field_t* f = &m->fields[j];
+
+      if (!proto_find_scalar(f->type) && !proto_resolve_type(pf, m, f)) {
+        proto_error(pf, f->line, "unknown type '%s' of '%s.%s'", f->type, m->path, f->name);
+        continue;
+      }
+
+      bool packable = f->wire != WIRE_DELIMITED;
+      if (f->repeated && f->packed && !packable) f->packed = false;
+      if (f->optional && f->kind == PROTO_MESSAGE) f->optional = false;
+    }
+  }
+}
+
+/* ================================================================
+ *  CODE GENERATOR
+ * ================================================================ */
+
+static int proto_tag_bytes(const proto_field_t* f, int wire, uint8_t* out) {
+  uint64_t key = (uint64_t)f->tag << 3 | (uint64_t)wire;
+  int n = 0;
+  do {
+    uint8_t b = key & 0x7f;
+    key >>= 7;
+    out[n++] = key ? (b | 0x80) : b;
+  } while (key);
+  return n;
+}
+
+static uint64_t proto_key(const proto_field_t* f, int wire) {
+  return (uint64_t)f->tag << 3 | (uint64_t)wire;
+}
+
+/* the element type in C */
+static const char* proto_ctype(const proto_field_t* f) {
+  static char buf[256];
+  if (f->kind == PROTO_MESSAGE) { snprintf(buf, sizeof(buf), "%s_t", f->message->cname); return buf; }
+  if (f->kind == PROTO_ENUM) return "int32_t";
+  return proto_kind_ctype(f->kind);
+}
+
+/* the unsigned wire value of a varint field */
+static void proto_varint_expr(const proto_field_t* f, const char* v, char* out, size_t outsz) {
+  switch (f->kind) {
+    case PROTO_INT32:
+    case PROTO_ENUM:   snprintf(out, outsz, "(uint64_t)(int64_t)%s", v); break;
+    case PROTO_INT64:  snprintf(out, outsz, "(uint64_t)%s", v); break;
+    case PROTO_BOOL:   snprintf(out, outsz, "(uint64_t)(%s != 0)", v); break;
+    case PROTO_SINT32: snprintf(out, outsz, "__zigzag_encode32(%s)", v); break;
+    case PROTO_SINT64: snprintf(out, outsz, "__zigzag_encode64(%s)", v); break;
+    default:           snprintf(out, outsz, "%s", v); break;
+  }
+}
+
+/* the bits of a fixed field */
+static void proto_fixed_expr(const proto_field_t* f, const char* v, char* out, size_t outsz) {
+  switch (f->kind) {
+    case PROTO_FLOAT:    snprintf(out, outsz, "__proto_float_bits(%s)", v); break;
+    case PROTO_DOUBLE:   snprintf(out, outsz, "__proto_double_bits(%s)", v); break;
+    case PROTO_SFIXED32: snprintf(out, outsz, "(uint32_t)%s", v); break;
+    case PROTO_SFIXED64: snprintf(out, outsz, "(uint64_t)%s", v); break;
+    default:             snprintf(out, outsz, "%s", v); break;
+  }
+}
+
+/* the C value from the wire value in _value */
+static const char* proto_decode_expr(const proto_field_t* f) {
+  switch (f->kind) {
+    case PROTO_INT32:
+    case PROTO_ENUM:     return "(int32_t)_value";
+    case PROTO_INT64:    return "(int64_t)_value";
+    case PROTO_UINT32:   return "(uint32_t)_value";
+    case PROTO_UINT64:   return "_value";
+    case PROTO_BOOL:     return "_value != 0";
+    case PROTO_SINT32:   return "__zigzag_decode32((uint32_t)_value)";
+    case PROTO_SINT64:   return "__zigzag_decode64(_value)";
+    case PROTO_FIXED32:  return "(uint32_t)_value";
+    case PROTO_SFIXED32: return "(int32_t)(uint32_t)_value";
+    case PROTO_FLOAT:    return "__proto_bits_float((uint32_t)_value)";
+    case PROTO_FIXED64:  return "_value";
+    case PROTO_SFIXED64: return "(int64_t)_value";
+    case PROTO_DOUBLE:   return "__proto_bits_double(_value)";
+    default:             return "_value";
+  }
+}
+
+/* the presence test of a singular field */
+static void proto_present_expr(const proto_field_t* f, char* out, size_t outsz) {
+  if (f->optional || f->kind == PROTO_MESSAGE) { snprintf(out, outsz, "msg->has_%s", f->name); return; }
+  switch (f->kind) {
+    case PROTO_FLOAT:  snprintf(out, outsz, "__proto_float_bits(msg->%s) != 0", f->name); break;
+    case PROTO_DOUBLE: snprintf(out, outsz, "__proto_double_bits(msg->%s) != 0", f->name); break;
+    case PROTO_STRING:
+    case PROTO_BYTES:  snprintf(out, outsz, "msg->%s.length != 0", f->name); break;
+    default:           snprintf(out, outsz, "msg->%s != 0", f->name); break;
+  }
+}
+
+static int proto_fixed_width(const proto_field_t* f) {
+  return f->wire == WIRE_32BIT ? 4 : 8;
+}
+
+static void emit_tag(compiler_t* cc, const char* in, const proto_field_t* f, int wire) {
+  uint8_t bytes[8];
+  int n = proto_tag_bytes(f, wire, bytes);
+  emitf(cc, "%s", in);
+  for (int i = 0; i < n; i++)
+    emitf(cc, "%s*_cursor++ = 0x%02x;", i ? " " : "", bytes[i]);
+  emitf(cc, "\n");
+}
+
+static void emit_helpers(compiler_t* cc) {
+  emitf(cc,
+    "#ifndef _BYTELIZER_PROTO_HELPERS_\n"
+    "#define _BYTELIZER_PROTO_HELPERS_\n\n"
+    "static inline uint32_t __proto_float_bits(float value) {\n"
+    "  uint32_t _bits; memcpy(&_bits, &value, sizeof(_bits)); return _bits;\n"
+    "}\n\n"
+    "static inline uint64_t __proto_double_bits(double value) {\n"
+    "  uint64_t _bits; memcpy(&_bits, &value, sizeof(_bits)); return _bits;\n"
+    "}\n\n"
+    "static inline float __proto_bits_float(uint32_t bits) {\n"
+    "  float _value; memcpy(&_value, &bits, sizeof(_value)); return _value;\n"
+    "}\n\n"
+    "static inline double __proto_bits_double(uint64_t bits) {\n"
+    "  double _value; memcpy(&_value, &bits, sizeof(_value)); return _value;\n"
+    "}\n\n"
+    "static inline uint8_t* __proto_put32(uint8_t* cursor, uint32_t value) {\n"
+    "  for (int i = 0; i < 4; i++) cursor[i] = (uint8_t)(value >> (i * 8));\n"
+    "  return cursor + 4;\n"
+    "}\n\n"
+    "static inline uint8_t* __proto_put64(uint8_t* cursor, uint64_t value) {\n"
+    "  for (int i = 0; i < 8; i++) cursor[i] = (uint8_t)(value >> (i * 8));\n"
+    "  return cursor + 8;\n"
+    "}\n\n"
+    "static inline bool __proto_get_varint(const uint8_t** cursor, const uint8_t* end, uint64_t* value) {\n"
+    "  uint32_t _length = __varint_decode(*cursor, end, value);\n"
+    "  *cursor += _length;\n"
+    "  return _length != 0;\n"
+    "}\n\n"
+    "static inline bool __proto_get_fixed(const uint8_t** cursor, const uint8_t* end, uint32_t width, uint64_t* value) {\n"
+    "  if ((size_t)(end - *cursor) < width) return false;\n"
+    "  *value = 0;\n"
+    "  for (uint32_t i = 0; i < width; i++) *value |= (uint64_t)(*cursor)[i] << (i * 8);\n"
+    "  *cursor += width;\n"
+    "  return true;\n"
+    "}\n\n"
+    "static inline bool __proto_get_delimited(const uint8_t** cursor, const uint8_t* end,\n"
+    "                                         const uint8_t** data, uint32_t* length) {\n"
+    "  uint64_t _length;\n"
+    "  if (!__proto_get_varint(cursor, end, &_length) || _length > (uint64_t)(end - *cursor)) return false;\n"
+    "  *data = *cursor;\n"
+    "  *length = (uint32_t)_length;\n"
+    "  *cursor += _length;\n"
+    "  return true;\n"
+    "}\n\n"
+    "/* unknown fields are skipped, groups are refused */\n"
+    "static inline bool __proto_skip(const uint8_t** cursor, const uint8_t* end, uint64_t key) {\n"
+    "  uint64_t _value; const uint8_t* _data; uint32_t _length;\n"
+    "  if ((key >> 3) == 0 || (key >> 3) > BYTELIZER_PBTAG_MAX) return false;\n"
+    "  switch (key & 0x7) {\n"
+    "    case 0: return __proto_get_varint(cursor, end, &_value);\n"
+    "    case 1: return __proto_get_fixed(cursor, end, 8, &_value);\n"
+    "    case 2: return __proto_get_delimited(cursor, end, &_data, &_length);\n"
+    "    case 5: return __proto_get_fixed(cursor, end, 4, &_value);\n"
+    "    default: return false;\n"
+    "  }\n"
+    "}\n\n"
+    "#endif /* _BYTELIZER_PROTO_HELPERS_ */\n\n");
+}
+
+static void emit_enum(compiler_t* cc, const proto_enum_t* e) {
+  emitf(cc, "/* enum %s */\n", e->path);
+  emitf(cc, "typedef enum {\n");
+  for (int i = 0; i < e->count; i++)
+    emitf(cc, "  %s_%s = %lld,\n", e->cname, e->names[i], e->values[i]);
+  emitf(cc, "} %s_t;\n\n", e->cname);
+}
+
+/* singular messages are stored by value, so they are defined first */
+static void proto_sort(proto_file_t* pf, proto_message_t* m, int line) {
+  if (m->state == 2) return;
+  if (m->state == 1) {
+    proto_error(pf, line, "message '%s' contains itself, make the field repeated", m->path);
+    return;
+  }
+
+  m->state = 1;
+  for (int i = 0; i < m->count; i++) {
+    proto_field_t* f = &m->fields[i];
+    if (f->kind == PROTO_MESSAGE && f->message && !f->repeated) proto_sort(pf, f->message, f->line);
+  }
+  m->state = 2;
+
+  pf->order[pf->order_count++] = m;
+}
+
+static void emit_struct(compiler_t* cc, const proto_message_t* m) {
+  emitf(cc, "/* message %s */\n", m->path);
+  emitf(cc, "struct _%s_t {\n", m->cname);
+  for (int i = 0; i < m->count; i++) {
+    const proto_field_t* f = &m->fields[i];
+    const char* ctype = proto_ctype(f);
+    const char* note = f->kind == PROTO_ENUM ? f->enumeration->cname : NULL;
+
+    if (f->repeated) {
+      emitf(cc, "  struct { %s* data; uint32_t count; uint32_t capacity; } %s;", ctype, f->name);
+      emitf(cc, note ? " /* %u, %s_t */\n" : " /* %u */\n", f->tag, note);
+      continue;
+    }
+    if (f->optional || f->kind == PROTO_MESSAGE)
+      emitf(cc, "  bool has_%s;\n", f->name);
+    emitf(cc, "  %s %s;", ctype, f->name);
+    emitf(cc, note ? " /* %u, %s_t */\n" : " /* %u */\n", f->tag, note);
+  }
+  emitf(cc, "  /* filled by %s_size */\n", m->cname);
+  emitf(cc, "  uint32_t _cached_size;\n");
+  emitf(cc, "};\n\n");
+}
+
+static void emit_size_function(compiler_t* cc, const proto_message_t* m) {
+  char present[256], expr[256], item[256];
+  uint8_t bytes[8];
+
+  emitf(cc, "static inline uint32_t %s_size(%s_t* msg) {\n", m->cname, m->cname);
+  emitf(cc, "  uint32_t _size = 0;\n");
+
+  for (int i = 0; i < m->count; i++) {
+    const proto_field_t* f = &m->fields[i];
+    int tl = proto_tag_bytes(f, f->packed ? WIRE_DELIMITED : f->wire, bytes);
+
+    if (!f->repeated) {
+      proto_present_expr(f, present, sizeof(present));
+      snprintf(item, sizeof(item), "msg->%s", f->name);
+      if (f->wire == WIRE_VARINT) {
+        proto_varint_expr(f, item, expr, sizeof(expr));
+        emitf(cc, "  if (%s) _size += %d + __varint_length(%s);\n", present, tl, expr);
+      } else if (f->wire != WIRE_DELIMITED) {
+        emitf(cc, "  if (%s) _size += %d;\n", present, tl + proto_fixed_width(f));
+      } else if (f->kind == PROTO_MESSAGE) {
+        emitf(cc, "  if (%s) {\n", present);
+        emitf(cc, "    uint32_t _length = %s_size(&msg->%s);\n", f->message->cname, f->name);
+        emitf(cc, "    _size += %d + __varint_length(_length) + _length;\n", tl);
+        emitf(cc, "  }\n");
+      } else {
+        emitf(cc, "  if (%s) _size += %d + __varint_length(msg->%s.length) + msg->%s.length;\n",
+              present, tl, f->name, f->name);
+      }
+      continue;
+    }
+
+    snprintf(item, sizeof(item), "msg->%s.data[i]", f->name);
+    if (f->packed) {
+      emitf(cc, "  if (msg->%s.count != 0) {\n", f->name);
+      if (f->wire == WIRE_VARINT) {
+        proto_varint_expr(f, item, expr, sizeof(expr));
+        emitf(cc, "    uint32_t _length = 0;\n");
+        emitf(cc, "    for (uint32_t i = 0; i < msg->%s.count; ++i) _length += __varint_length(%s);\n", f->name, expr);
+      } else {
+        emitf(cc, "    uint32_t _length = msg->%s.count * %d;\n", f->name, proto_fixed_width(f));
+      }
+      emitf(cc, "    _size += %d + __varint_length(_length) + _length;\n", tl);
+      emitf(cc, "  }\n");
+    } else if (f->wire == WIRE_VARINT) {
+      proto_varint_expr(f, item, expr, sizeof(expr));
+      emitf(cc, "  for (uint32_t i = 0; i < msg->%s.count; ++i) _size += %d + __varint_length(%s);\n",
+            f->name, tl, expr);
+    } else if (f->wire != WIRE_DELIMITED) {
+      emitf(cc, "  _size += msg->%s.count * %d;\n", f->name, tl + proto_fixed_width(f));
+    } else if (f->kind == PROTO_MESSAGE) {
+      emitf(cc, "  for (uint32_t i = 0; i < msg->%s.count; ++i) {\n", f->name);
+      emitf(cc, "    uint32_t _length = %s_size(&msg->%s.data[i]);\n", f->message->cname, f->name);
+      emitf(cc, "    _size += %d + __varint_length(_length) + _length;\n", tl);
+      emitf(cc, "  }\n");
+    } else {
+      emitf(cc, "  for (uint32_t i = 0; i < msg->%s.count; ++i)\n", f->name);
+      emitf(cc, "    _size += %d + __varint_length(%s.length) + %s.length;\n", tl, item, item);
+    }
+  }
+
+  emitf(cc, "  msg->_cached_size = _size;\n");
+  emitf(cc, "  return _size;\n");
+  emitf(cc, "}\n\n");
+}
+
+/* write one value of a field, the tag is written by the caller,
+   nonempty if the presence test has checked the bytes length already */
+static void emit_write_value(compiler_t* cc, const char* in, const proto_field_t* f, const char* v, bool nonempty) {
+  char expr[256];
+  if (f->wire == WIRE_VARINT) {
+    proto_varint_expr(f, v, expr, sizeof(expr));
+    emitf(cc, "%s_cursor += __varint_encode(%s, _cursor, _end);\n", in, expr);
+  } else if (f->wire == WIRE_32BIT) {
+    proto_fixed_expr(f, v, expr, sizeof(expr));
+    emitf(cc, "%s_cursor = __proto_put32(_cursor, %s);\n", in, expr);
+  } else if (f->wire == WIRE_64BIT) {
+    proto_fixed_expr(f, v, expr, sizeof(expr));
+    emitf(cc, "%s_cursor = __proto_put64(_cursor, %s);\n", in, expr);
+  } else if (f->kind == PROTO_MESSAGE) {
+    emitf(cc, "%s_cursor += __varint_encode(%s._cached_size, _cursor, _end);\n", in, v);
+    emitf(cc, "%s_cursor = %s_write(&%s, _cursor, _end);\n", in, f->message->cname, v);
+  } else {
+    emitf(cc, "%s_cursor += __varint_encode(%s.length, _cursor, _end);\n", in, v);
+    if (nonempty) emitf(cc, "%smemcpy(_cursor, %s.data, %s.length);\n", in, v, v);
+    else emitf(cc, "%sif (%s.length != 0) memcpy(_cursor, %s.data, %s.length);\n", in, v, v, v);
+    emitf(cc, "%s_cursor += %s.length;\n", in, v);
+  }
+}
+
+static void emit_write_function(compiler_t* cc, const proto_message_t* m) {
+  char present[256], expr[256], item[256];
+
+  emitf(cc, "/* the sizes must be cached by %s_size first */\n", m->cname);
+  emitf(cc, "static inline uint8_t* %s_write(const %s_t* msg, uint8_t* _cursor, uint8_t* _end) {\n",
+        m->cname, m->cname);
+
+  for (int i = 0; i < m->count; i++) {
+    const proto_field_t* f = &m->fields[i];
+
+    if (!f->repeated) {
+      proto_present_expr(f, present, sizeof(present));
+      snprintf(item, sizeof(item), "msg->%s", f->name);
+      emitf(cc, "  if (%s) {\n", present);
+      emit_tag(cc, "    ", f, f->wire);
+      emit_write_value(cc, "    ", f, item, !f->optional);
+      emitf(cc, "  }\n");
+      continue;
+    }
+
+    snprintf(item, sizeof(item), "msg->%s.data[i]", f->name);
+    if (f->packed) {
+      emitf(cc, "  if (msg->%s.count != 0) {\n", f->name);
+      if (f->wire == WIRE_VARINT) {
+        proto_varint_expr(f, item, expr, sizeof(expr));
+        emitf(cc, "    uint32_t _length = 0;\n");
+        emitf(cc, "    for (uint32_t i = 0; i < msg->%s.count; ++i) _length += __varint_length(%s);\n", f->name, expr);
+      } else {
+        emitf(cc, "    uint32_t _length = msg->%s.count * %d;\n", f->name, proto_fixed_width(f));
+      }
+      emit_tag(cc, "    ", f, WIRE_DELIMITED);
+      emitf(cc, "    _cursor += __varint_encode(_length, _cursor, _end);\n");
+      emitf(cc, "    for (uint32_t i = 0; i < msg->%s.count; ++i) {\n", f->name);
+      emit_write_value(cc, "      ", f, item, false);
+      emitf(cc, "    }\n");
+      emitf(cc, "  }\n");
+      continue;
+    }
+
+    emitf(cc, "  for (uint32_t i = 0; i < msg->%s.count; ++i) {\n", f->name);
+    emit_tag(cc, "    ", f, f->wire);
+    emit_write_value(cc, "    ", f, item, false);
+    emitf(cc, "  }\n");
+  }
+
+  emitf(cc, "  return _cursor;\n");
+  emitf(cc, "}\n\n");
+}
+
+/* read one value of a field into target, the key is consumed already */
+static void emit_read_value(compiler_t* cc, const char* in, const proto_field_t* f,
+                            const char* cursor, const char* end, const char* target) {
+  if (f->wire == WIRE_VARINT) {
+    emitf(cc, "%sif (!__proto_get_varint(&%s, %s, &_value)) return false;\n", in, cursor, end);
+    emitf(cc, "%s%s = %s;\n", in, target, proto_decode_expr(f));
+  } else if (f->wire != WIRE_DELIMITED) {
+    emitf(cc, "%sif (!__proto_get_fixed(&%s, %s, %d, &_value)) return false;\n",
+          in, cursor, end, proto_fixed_width(f));
+    emitf(cc, "%s%s = %s;\n", in, target, proto_decode_expr(f));
+  } else if (f->kind == PROTO_MESSAGE) {
+    emitf(cc, "%sif (!__proto_get_delimited(&%s, %s, &_data, &_length) ||\n", in, cursor, end);
+    emitf(cc, "%s    !%s_read(&%s, _data, _data + _length, _depth + 1)) return false;\n",
+          in, f->message->cname, target);
+  } else {
+    emitf(cc, "%sif (!__proto_get_delimited(&%s, %s, &_data, &_length)) return false;\n", in, cursor, end);
+    emitf(cc, "%s%s = (bytelizer_pbslice_t) { .data = _data, .length = _length };\n", in, target);
+  }
+}
+
+static void emit_read_function(compiler_t* cc, const proto_message_t* m) {
+  char target[256];
+
+  emitf(cc, "static inline bool %s_read(%s_t* msg, const uint8_t* _cursor, const uint8_t* _end, uint32_t _depth) {\n",
+        m->cname, m->cname);
+  emitf(cc, "  uint64_t _key, _value;\n");
+  emitf(cc, "  const uint8_t* _data;\n");
+  emitf(cc, "  uint32_t _length;\n");
+  emitf(cc, "  (void)_value; (void)_data; (void)_length;\n\n");
+  emitf(cc, "  if (_depth > BYTELIZER_PBSTRUCT_DEPTH) return false;\n\n");
+
+  /* the defaults, the caller arrays stay */
+  for (int i = 0; i < m->count; i++) {
+    const proto_field_t* f = &m->fields[i];
+    if (f->repeated) emitf(cc, "  msg->%s.count = 0;\n", f->name);
+    else if (f->kind == PROTO_MESSAGE) emitf(cc, "  msg->has_%s = false;\n", f->name);
+    else {
+      if (f->optional) emitf(cc, "  msg->has_%s = false;\n", f->name);
+      if (f->wire == WIRE_DELIMITED)
+        emitf(cc, "  msg->%s = (bytelizer_pbslice_t) { 0 };\n", f->name);
+      else
+        emitf(cc, "  msg->%s = 0;\n", f->name);
+    }
+  }
+
+  emitf(cc, "\n  while (_cursor < _end) {\n");
+  emitf(cc, "    if (!__proto_get_varint(&_cursor, _end, &_key)) return false;\n");
+  emitf(cc, "    switch (_key) {\n");
+
+  for (int i = 0; i < m->count; i++) {
+    const proto_field_t* f = &m->fields[i];
+
+    if (!f->repeated) {
+      snprintf(target, sizeof(target), "msg->%s", f->name);
+      emitf(cc, "      case 0x%llx: /* %s */\n", (unsigned long long)proto_key(f, f->wire), f->name);
+      emit_read_value(cc, "        ", f, "_cursor", "_end", target);
+      if (f->optional || f->kind == PROTO_MESSAGE)
+        emitf(cc, "        msg->has_%s = true;\n", f->name);
+      emitf(cc, "        break;\n");
+      continue;
+    }
+
+    snprintf(target, sizeof(target), "msg->%s.data[msg->%s.count++]", f->name, f->name);
+
+    /* one element, a parser must accept both forms of a packable field */
+    emitf(cc, "      case 0x%llx: /* %s */\n", (unsigned long long)proto_key(f, f->wire), f->name);
+    emitf(cc, "        if (msg->%s.count >= msg->%s.capacity) return false;\n", f->name, f->name);
+    emit_read_value(cc, "        ", f, "_cursor", "_end", target);
+    emitf(cc, "        break;\n");
+
+    if (f->wire == WIRE_DELIMITED) continue;
+
+    emitf(cc, "      case 0x%llx: { /* %s, packed */\n", (unsigned long long)proto_key(f, WIRE_DELIMITED), f->name);
+    emitf(cc, "        const uint8_t* _items;\n");
+    emitf(cc, "        if (!__proto_get_delimited(&_cursor, _end, &_items, &_length)) return false;\n");
+    emitf(cc, "        for (const uint8_t* _items_end = _items + _length; _items < _items_end;) {\n");
+    emitf(cc, "          if (msg->%s.count >= msg->%s.capacity) return false;\n", f->name, f->name);
+    emit_read_value(cc, "          ", f, "_items", "_items_end", target);
+    emitf(cc, "        }\n");
+    emitf(cc, "        break;\n");
+    emitf(cc, "      }\n");
+  }
+
+  emitf(cc, "      default:\n");
+  emitf(cc, "        if (!__proto_skip(&_cursor, _end, _key)) return false;\n");
+  emitf(cc, "        break;\n");
+  emitf(cc, "    }\n");
+  emitf(cc, "  }\n\n");
+  emitf(cc, "  return _cursor == _end;\n");
+  emitf(cc, "}\n\n");
+}
+
+static void emit_context_functions(compiler_t* cc, const proto_message_t* m) {
+  const char* n = m->cname;
+
+  emitf(cc, "/* put the message, the sizes are cached in it */\n");
+  emitf(cc, "static inline bool bytelizer_put_%s(bytelizer_ctx_t* ctx, %s_t* msg) {\n", n, n);
+  emitf(cc, "  uint32_t _size = %s_size(msg);\n", n);
+  emitf(cc, "  if (_size == 0) return true;\n");
+  emitf(cc, "  if (!bytelizer_ensure_available(ctx, _size)) return false;\n");
+  emitf(cc, "  %s_write(msg, ctx->cursor, ctx->cursor + _size);\n", n);
+  emitf(cc, "  bytelizer_update_cursor(ctx, _size);\n");
+  emitf(cc, "  return true;\n");
+  emitf(cc, "}\n\n");
+
+  emitf(cc, "/* get a message of the given length from a linear buffer, the bytes\n");
+  emitf(cc, " * fields point into it and the repeated fields use the caller arrays */\n");
+  emitf(cc, "static inline bool bytelizer_get_%s(bytelizer_ctx_t* ctx, %s_t* msg, uint32_t length) {\n", n, n);
+  emitf(cc, "  if (ctx->blocks != NULL || length > bytelizer_remain(ctx)) return false;\n");
+  emitf(cc, "  if (!%s_read(msg, ctx->cursor, ctx->cursor + length, 0)) return false;\n", n);
+  emitf(cc, "  bytelizer_update_cursor(ctx, length);\n");
+  emitf(cc, "  return true;\n");
+  emitf(cc, "}\n\n");
+}
+
+static void proto_generate(proto_file_t* pf, compiler_t* cc, const char* source_name) {
+  emitf(cc, "/* @brief Compile-time built protobuf file\n");
+  emitf(cc, " * @name %s.proto\n", source_name);
+  if (cc->argc > 0) {
+    emitf(cc, " * @cmdline \"%s", cc->argv[0]);
+    for (int i = 1; i < cc->argc; i++)
+      emitf(cc, " \\%s\n *     %s", "", cc->argv[i]);
+    emitf(cc, "\"\n");
+  }
+  emitf(cc, " */\n\n");
+
+  char guard[256];
+  str_toupper(source_name, guard, sizeof(guard));
+
+  emitf(cc, "#ifndef _BYTELIZER_PROTO_COMPILED_%s_H_\n", guard);
+  emitf(cc, "#define _BYTELIZER_PROTO_COMPILED_%s_H_\n\n", guard);
+  emitf(cc, "#include <string.h>\n");
+  emitf(cc, "#include <bytelizer/codec.h>\n");
+  emitf(cc, "#include <bytelizer/protobuf.h>\n\n");
+
+  emit_helpers(cc);
+
+  for (int i = 0; i < pf->enum_count; i++)
+    emit_enum(cc, pf->enums[i]);
+
+  for (int i = 0; i < pf->message_count; i++)
+    emitf(cc, "typedef struct _%s_t %s_t;\n", pf->messages[i]->cname, pf->messages[i]->cname);
+  emitf(cc, "\n");
+
+  for (int i = 0; i < pf->order_count; i++)
+    emit_struct(cc, pf->order[i]);
+
+  for (int i = 0; i < pf->message_count; i++) {
+    const char* n = pf->messages[i]->cname;
+    emitf(cc, "static inline uint32_t %s_size(%s_t* msg);\n", n, n);
+    emitf(cc, "static inline uint8_t* %s_write(const %s_t* msg, uint8_t* _cursor, uint8_t* _end);\n", n, n);
+    emitf(cc, "static inline bool %s_read(%s_t* msg, const uint8_t* _cursor, const uint8_t* _end, uint32_t _depth);\n", n, n);
+  }
+  emitf(cc, "\n");
+
+  for (int i = 0; i < pf->message_count; i++) {
+    emit_size_function(cc, pf->messages[i]);
+    emit_write_function(cc, pf->messages[i]);
+    emit_read_function(cc, pf->messages[i]);
+    emit_context_functions(cc, pf->messages[i]);
+  }
+
+  emitf(cc, "#endif /* _BYTELIZER_PROTO_COMPILED_%s_H_ */\n", guard);
+}
+
+static void proto_free(proto_file_t* pf) {
+  for (int i = 0; i < pf->message_count; i++) {
+    proto_message_t* m = pf->messages[i];
+    for (int j = 0; j < m->count; j++) {
+      free(m->fields[j].name);
+      free(m->fields[j].type);
+    }
+    free(m->fields);
+    free(m->path);
+    free(m->cname);
+    free(m);
+  }
+  for (int i = 0; i < pf->enum_count; i++) {
+    proto_enum_t* e = pf->enums[i];
+    for (int j = 0; j < e->count; j++) free(e->names[j]);
+    free(e->names);
+    free(e->values);
+    free(e->path);
+    free(e->cname);
+    free(e);
+  }
+  free(pf->messages);
+  free(pf->enums);
+  free(pf->order);
+  free(pf->package);
+}
+
+/* ================================================================
+ *  ENTRY
+ * ================================================================ */
+
+bool proto_is_source(const char* path) {
+  const char* dot = strrchr(path, '.');
+  return dot && strcmp(dot, ".proto") == 0;
+}
+
+int proto_compile(compiler_t* cc, const char* input, const char* source_name) {
+  proto_file_t pf;
+  memset(&pf, 0, sizeof(pf));
+
+  lexer_open(&pf.lex, input);
+  proto_parse_file(&pf);
+  proto_resolve(&pf);
+
+  if (pf.errors == 0) {
+    pf.order = (proto_message_t**)calloc(pf.message_count + 1, sizeof(proto_message_t*));
+    if (!pf.order) die("oom");
+    for (int i = 0; i < pf.message_count; i++)
+      proto_sort(&pf, pf.messages[i], 0);
+  }
+
+  if (pf.errors == 0)
+    proto_generate(&pf, cc, source_name);
+
+  int errors = pf.errors;
+  proto_free(&pf);
+  lexer_close(&pf.lex);
+  return errors;
+}
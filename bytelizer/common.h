@@ -32,6 +32,15 @@
   #define BYTELIZER_INLINE_FUNCTIONS true
 #endif
 
+#ifndef BYTELIZER_ENABLE_SIMD
+  /**
+   * @brief Enable SIMD kernels
+   * Bulk routines pick an SSSE3/AVX2 code path at runtime
+   * if the cpu supports it, otherwise the scalar code is used.
+   */
+  #define BYTELIZER_ENABLE_SIMD true
+#endif
+
 #ifndef BYTELIZER_ENABLE_LOG
 
   /**
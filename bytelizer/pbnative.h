@@ -0,0 +1,15 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#ifndef _BYTELIZER_API_PBNATIVE_H
+#define _BYTELIZER_API_PBNATIVE_H
+
+#include "../src/pbnative.h"
+
+#endif /* _BYTELIZER_API_PBNATIVE_H */
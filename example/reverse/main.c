@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <time.h>
+#include <bytelizer/codec.h>
+#include <bytelizer/protobuf.h>
+#include <bytelizer/reverse.h>
+
+#define ROUNDS 200000
+
+static uint8_t payload[200];
+
+// a telemetry-like message, four levels deep
+PBSTRUCT_EXPORT(report, (PBSTRUCT {
+  PB_VARINT (1, id, 123456789),
+  PB_MESSAGE (2, _, (PBSTRUCT {
+    PB_VARINT (1, seq, 42),
+    PB_MESSAGE (2, _, (PBSTRUCT {
+      PB_CSTRING (1, name, "sensor-17"),
+      PB_MESSAGE (2, _, (PBSTRUCT {
+        PB_FIXED32 (1, value, 1000),
+        PB_FIXED64 (2, time, 1700000000),
+        PB_BYTES (3, raw, payload, sizeof(payload)),
+      PB_MESSAGE_END })),
+    PB_MESSAGE_END })),
+    PB_MESSAGE (3, _, (PBSTRUCT {
+      PB_VARINT (1, min, 1),
+      PB_VARINT (2, max, 300),
+    PB_MESSAGE_END })),
+  PB_MESSAGE_END })),
+PB_MESSAGE_END }));
+
+static double elapsed(struct timespec* begin) {
+  struct timespec _end;
+  clock_gettime(CLOCK_MONOTONIC, &_end);
+  return (_end.tv_sec - begin->tv_sec) + (_end.tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+int main() {
+
+  struct timespec _begin;
+  uint32_t _length = 0;
+
+  // 1. forward encoding, the sizes are measured before writing
+  clock_gettime(CLOCK_MONOTONIC, &_begin);
+  for(int i = 0; i < ROUNDS; ++i) {
+    bytelizer_alloc(_ctx, 512); {
+      bytelizer_put_pbstruct(_ctx, _pb_struct_report);
+      _length = bytelizer_length(_ctx);
+    }
+    bytelizer_destroy(_ctx);
+  }
+  double _forward = elapsed(&_begin);
+
+  // 2. reverse encoding, the prefixes are written after the bodies
+  clock_gettime(CLOCK_MONOTONIC, &_begin);
+  for(int i = 0; i < ROUNDS; ++i) {
+    bytelizer_ralloc(_ctx, 512); {
+      bytelizer_rput_pbstruct(_ctx, _pb_struct_report);
+      _length = bytelizer_rlength(_ctx);
+    }
+    bytelizer_rdestroy(_ctx);
+  }
+  double _reverse = elapsed(&_begin);
+
+  printf("message length  %u bytes\n", _length);
+  printf("forward encode  %.1f ns/msg\n", _forward / ROUNDS * 1e9);
+  printf("reverse encode  %.1f ns/msg\n", _reverse / ROUNDS * 1e9);
+}
@@ -15,6 +15,8 @@
 #include <bytelizer/error.h>
 #include "codec.h"
 #include "bitwise.h"
+#include "varint.h"
+#include "encoding.h"
 #include "debug/log.h"
 
 #define MKFLAG(x) (1 << x)
@@ -27,7 +29,14 @@ typedef enum {
   prefix_uint16le    = MKFLAG(4),
   prefix_uint32be    = MKFLAG(5),
   prefix_uint32le    = MKFLAG(6),
-  prefix_max         = MKFLAG(7),
+  prefix_uint64be    = MKFLAG(7),
+  prefix_uint64le    = MKFLAG(8),
+  prefix_varint      = MKFLAG(9),
+  prefix_max         = MKFLAG(10),
+
+  // barrier only, shrink the reserved varint on leave
+  // instead of writing a redundant padded varint
+  prefix_compact     = MKFLAG(11),
 } bytelizer_prefix_t;
 
 #undef MKFLAG
@@ -358,17 +367,32 @@ _inline static size_t __get_prefix_length_by_type(bytelizer_prefix_t prefix) {
     case prefix_uint16le: return 2;
     case prefix_uint32be:
     case prefix_uint32le: return 4;
+    case prefix_uint64be:
+    case prefix_uint64le: return 8;
+
+    // the maximal width, lengths are uint32
+    case prefix_varint: return BYTELIZER_VARINT32_MAX;
     default:
       __bytelizer_log("wrong prefix type enum %d", prefix);
       return 0;
   }
 }
 
-static void __put_prefix(bytelizer_ctx_t* ctx,
+_inline static void __put_prefix_inline(bytelizer_ctx_t* ctx,
 bytelizer_prefix_t base_type, bytelizer_prefix_t length_type, uint32_t value) {
 
-  if(base_type == prefix_withself)
-    value += __get_prefix_length_by_type(length_type);
+  if(base_type == prefix_withself) {
+
+    // the varint width depends on the value itself
+    if(length_type == prefix_varint) {
+      uint32_t _width = __varint_length(value);
+      while(__varint_length((uint64_t)value + _width) != _width)
+        _width = __varint_length((uint64_t)value + _width);
+      value += _width;
+    }
+
+    else value += __get_prefix_length_by_type(length_type);
+  }
 
   switch(length_type) {
     case prefix_uint8:
@@ -391,18 +415,37 @@ bytelizer_prefix_t base_type, bytelizer_prefix_t length_type, uint32_t value) {
       bytelizer_put_uint32_be(ctx, value);
       break;
 
+    case prefix_uint64le:
+      bytelizer_put_uint64_le(ctx, (uint64_t)value);
+      break;
+
+    case prefix_uint64be:
+      bytelizer_put_uint64_be(ctx, (uint64_t)value);
+      break;
+
+    case prefix_varint:
+      bytelizer_put_varint(ctx, value);
+      break;
+
     default:
       __bytelizer_log("unsupported prefix type: %d", length_type);
       break;
   }
 }
 
+static void __put_prefix(bytelizer_ctx_t* ctx,
+bytelizer_prefix_t base_type, bytelizer_prefix_t length_type, uint32_t value) {
+  __put_prefix_inline(ctx, base_type, length_type, value);
+}
+
 _inline static size_t __get_prefix_length_by_index(bytelizer_prefix_t prefix) {
 
   static const uint32_t _table_length[] = {
     0, 0, sizeof(uint8_t),
     sizeof(uint16_t), sizeof(uint16_t),
-    sizeof(uint32_t), sizeof(uint32_t)
+    sizeof(uint32_t), sizeof(uint32_t),
+    sizeof(uint64_t), sizeof(uint64_t),
+    BYTELIZER_VARINT32_MAX
   };
 
   return _table_length[prefix];
@@ -458,6 +501,141 @@ bytelizer_prefix_t prefix, uint32_t srcsize) {
   return true;
 }
 
+/**
+ * @brief get a length prefix from an attached buffer
+ * @param ctx the bytelizer context
+ * @param prefix the prefix, the same as putting
+ * @param length the plain data length
+ * @return false if the buffer is too short or the prefix is malformed,
+ * the cursor is not moved in this case
+*/
+_inline static bool bytelizer_get_prefix(bytelizer_ctx_t* ctx,
+bytelizer_prefix_t prefix, uint32_t* length) {
+
+  bytelizer_prefix_t _basetype, _lentype;
+  __parse_prefix(prefix, 0, &_basetype, &_lentype);
+
+  uint32_t _remain = bytelizer_remain(ctx);
+  uint32_t _width = 0;
+  uint64_t _value = 0;
+
+  if(_lentype == prefix_varint) {
+    if((_width = __varint_decode(ctx->cursor, ctx->cursor + _remain, &_value)) == 0) {
+      __bytelizer_log("truncated varint prefix");
+      return false;
+    }
+  }
+
+  else {
+
+    _width = (uint32_t)__get_prefix_length_by_type(_lentype);
+    if(_width == 0 || _width > _remain) {
+      __bytelizer_log("truncated prefix");
+      return false;
+    }
+
+    uint8_t* _cursor = ctx->cursor;
+    uint16_t _u16; uint32_t _u32; uint64_t _u64;
+
+    switch(_lentype) {
+      case prefix_uint8: _value = *_cursor; break;
+      case prefix_uint16le: memcpy(&_u16, _cursor, 2); _value = bitwise_le16(_u16); break;
+      case prefix_uint16be: memcpy(&_u16, _cursor, 2); _value = bitwise_be16(_u16); break;
+      case prefix_uint32le: memcpy(&_u32, _cursor, 4); _value = bitwise_le32(_u32); break;
+      case prefix_uint32be: memcpy(&_u32, _cursor, 4); _value = bitwise_be32(_u32); break;
+      case prefix_uint64le: memcpy(&_u64, _cursor, 8); _value = bitwise_le64(_u64); break;
+      case prefix_uint64be: memcpy(&_u64, _cursor, 8); _value = bitwise_be64(_u64); break;
+      default: return false;
+    }
+  }
+
+  if(_basetype == prefix_withself) {
+    if(_value < _width) {
+      __bytelizer_log("prefix is shorter than itself");
+      return false;
+    }
+    _value -= _width;
+  }
+
+  if(_value > UINT32_MAX) {
+    __bytelizer_log("prefix value is too large");
+    return false;
+  }
+
+  bytelizer_update_cursor(ctx, _width);
+  if(length) *length = (uint32_t)_value;
+
+  return true;
+}
+
+/**
+ * @brief every constant prefix that has a specialized entry point,
+ * X(base, len) is expanded for each of them
+ */
+#define __BYTELIZER_PREFIX_TYPES(X, base) \
+  X(base, uint8) \
+  X(base, uint16le) X(base, uint16be) \
+  X(base, uint32le) X(base, uint32be) \
+  X(base, uint64le) X(base, uint64be) \
+  X(base, varint)
+
+#define __BYTELIZER_PREFIX_SPECS(X) \
+  __BYTELIZER_PREFIX_TYPES(X, length_only) \
+  __BYTELIZER_PREFIX_TYPES(X, withself)
+
+// specialized prefix writers, the flag parsing
+// and the switch are folded away at compile time
+#define __DEFINE_PREFIX_SPEC(base, len) \
+  _inline static void bytelizer_put_prefix_##base##_##len(bytelizer_ctx_t* ctx, \
+  uint32_t length) { \
+    __put_prefix_inline(ctx, prefix_##base, prefix_##len, length); \
+  } \
+  _inline static void bytelizer_put_bytes_##base##_##len(bytelizer_ctx_t* ctx, \
+  const uint8_t* const value, uint32_t length) { \
+    __put_prefix_inline(ctx, prefix_##base, prefix_##len, length); \
+    bytelizer_put_bytes(ctx, value, length); \
+  } \
+  _inline static void bytelizer_put_bytelizer_##base##_##len(bytelizer_ctx_t* ctx, \
+  bytelizer_ctx_t* value) { \
+    __put_prefix_inline(ctx, prefix_##base, prefix_##len, value->total_length); \
+    bytelizer_put_bytelizer(ctx, value); \
+  }
+
+__BYTELIZER_PREFIX_SPECS(__DEFINE_PREFIX_SPEC)
+
+#undef __DEFINE_PREFIX_SPEC
+
+/**
+ * @brief put bytes into buffer with a constant length prefix
+ * @param ctx the bytelizer context
+ * @param value the value
+ * @param length the length of value
+ * @param base the base type without `prefix_`, length_only or withself
+ * @param len the length type without `prefix_`, e.g. uint16be or varint
+*/
+#define bytelizer_put_bytes_static(ctx, value, length, base, len) \
+  bytelizer_put_bytes_##base##_##len(ctx, value, length)
+
+/**
+ * @brief put another bytelizer into buffer with a constant length prefix
+ * @param ctx the bytelizer context
+ * @param value the bytelizer context to be put
+ * @param base the base type without `prefix_`, length_only or withself
+ * @param len the length type without `prefix_`, e.g. uint16be or varint
+*/
+#define bytelizer_put_bytelizer_static(ctx, value, base, len) \
+  bytelizer_put_bytelizer_##base##_##len(ctx, value)
+
+/**
+ * @brief put string into buffer with a constant length prefix
+ * @param ctx the bytelizer context
+ * @param value the value
+ * @param base the base type without `prefix_`, length_only or withself
+ * @param len the length type without `prefix_`, e.g. uint16be or varint
+*/
+#define bytelizer_put_string_static(ctx, value, base, len) \
+  bytelizer_put_bytes_##base##_##len(ctx, (const uint8_t* const)value, (uint32_t)strlen(value))
+
 /**
  * @brief put bytes string
  * @param ctx the bytelizer context
@@ -486,21 +664,7 @@ uint8_t* value, uint32_t length, bytelizer_prefix_t prefix) {
     }
   }
 
-  int32_t _counter = _hexstr_len;
-  static char* _hex_table = "0123456789ABCDEF";
-
-  while(--_counter >= 0) {
-
-    // aligned with 2
-    uint8_t _byte = value[_counter >> 1];
-
-    // teardown one byte into high and low parts
-    // example: 0xE9 became 0xE and 0x9
-    uint8_t _part = _byte >> ((1 - ((_counter & 1))) << 2);
-
-    // match the result from the hex table
-    ctx->cursor[_counter] = _hex_table[_part & 0x0F];
-  }
+  bytelizer_hex_encode((char *)ctx->cursor, value, length, hexcase_upper);
 
   // update the cursor
   bytelizer_update_cursor(ctx, _hexstr_len);
@@ -20,16 +20,33 @@
 #include "debug/log.h"
 
 typedef struct _bytelizer_anchor_t {
-  bytelizer_ctx_t old;
-  // uint8_t* cursor;
-  // uint8_t* block;
-  // uint32_t counter;
-  // uint32_t total;
+  uint8_t* block;
+  uint32_t offset;
   uint32_t userdata;
 } bytelizer_anchor_t;
 
 /**
- * @brief get safe anchor with a specific length
+ * @brief get the buffer being written, the stack or the last heap block
+ * @param ctx the bytelizer context
+ */
+_inline static uint8_t* __anchor_current_block(bytelizer_ctx_t* ctx) {
+
+  if(ctx->blocks == NULL)
+    return ctx->stack;
+
+  return (uint8_t *)*(bytelizer_block_t **)ctx->blocks->tail->data + sizeof(bytelizer_block_t);
+}
+
+/**
+ * @brief get the memory location of an anchor
+ * @param anchor the anchor handle
+ */
+#define bytelizer_anchor_cursor(anchor) \
+  ((anchor)->block + (anchor)->offset)
+
+/**
+ * @brief get safe anchor with a specific length,
+ * only the location is remembered, not the whole context
  * @param anchor the anchor handle
  * @param ctx the bytelizer context
  * @param size the size to be locked
@@ -39,15 +56,11 @@ bytelizer_ctx_t* ctx, uint32_t userdata, uint32_t size) {
 
   if(bytelizer_ensure_available(ctx, size)) {
 
-    memcpy(&anchor->old, ctx, sizeof(bytelizer_ctx_t));
+    // save the location
+    anchor->block = __anchor_current_block(ctx);
+    anchor->offset = (uint32_t)(ctx->cursor - anchor->block);
     anchor->userdata = userdata;
 
-    // // save context information
-    // anchor->cursor = ctx->cursor;
-    // anchor->total = ctx->total_length;
-    // anchor->counter = *ctx->counter;
-    // anchor->block = (ctx->blocks != NULL) ? ctx->blocks->tail : ctx->stack;
-
     // jsut move cursor ahead
     bytelizer_update_cursor(ctx, size);
 
@@ -59,19 +72,26 @@ bytelizer_ctx_t* ctx, uint32_t userdata, uint32_t size) {
 }
 
 /**
- * @brief move the cursor to an anchor
+ * @brief move the cursor back to an anchor, the data written
+ * after the anchor is dropped
  * @param anchor the anchor handle
  * @param ctx the bytelizer context
+ * @return false if the anchor is not in the buffer being written
  */
-_inline static void bytelizer_move_to_anchor(bytelizer_anchor_t* anchor,
+_inline static bool bytelizer_move_to_anchor(bytelizer_anchor_t* anchor,
 bytelizer_ctx_t* ctx) {
 
-  memcpy(ctx, &anchor->old, sizeof(bytelizer_ctx_t));
+  if(__anchor_current_block(ctx) != anchor->block) {
+    __bytelizer_log("move to anchor failed, the anchor is in a previous block");
+    return false;
+  }
 
-  // ctx->cursor = anchor->cursor;
-  // ctx->blocks->tail = anchor->block;
-  // ctx->counter = anchor->counter;
+  uint32_t _drop = (uint32_t)(ctx->cursor - bytelizer_anchor_cursor(anchor));
+  ctx->cursor -= _drop;
+  ctx->total_length -= _drop;
+  *ctx->counter -= _drop;
 
+  return true;
 }
 
 #endif /* _BYTELIZER_ANCHOR_H */
@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#ifndef _BYTELIZER_ARENA_H
+#define _BYTELIZER_ARENA_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <bytelizer/common.h>
+
+#include "compiler.h"
+#include "debug/log.h"
+
+/*
+  An arena hands out memory from one caller buffer by bumping an
+  offset, there is no free, everything is released by a reset:
+
+    bytelizer_arena_alloc(arena, 4096);
+      for(...) {
+        bytelizer_arena_reset(arena);
+        view = bytelizer_pbview_decode(data, length, schema, arena);
+      }
+    bytelizer_arena_destroy(arena);
+*/
+
+// the alignment of every allocation
+#define BYTELIZER_ARENA_ALIGN 8
+
+typedef struct {
+  uint8_t* buffer;
+  uint32_t size;
+  uint32_t used;
+} bytelizer_arena_t;
+
+/**
+ * @brief arena initialize on the stack
+ * @param arena the arena
+ * @param capacity the arena size
+ */
+#define bytelizer_arena_alloc(arena, capacity) { \
+  uint64_t arena##_buf[((capacity) + sizeof(uint64_t) - 1) / sizeof(uint64_t)]; \
+  bytelizer_arena_t* arena = &(bytelizer_arena_t) { \
+    .buffer = (uint8_t *)arena##_buf, \
+    .size = capacity, \
+    .used = 0, \
+  };
+
+/**
+ * @brief arena initialize on a caller buffer
+ * @param arena the arena
+ * @param memory the buffer pointer
+ * @param capacity the buffer size
+ */
+#define bytelizer_arena_attach(arena, memory, capacity) { \
+  bytelizer_arena_t* arena = &(bytelizer_arena_t) { \
+    .buffer = (uint8_t *)(memory), \
+    .size = capacity, \
+    .used = 0, \
+  };
+
+/**
+ * @brief close the arena scope, nothing to release
+ * @param arena the arena
+ */
+#define bytelizer_arena_destroy(arena) }
+
+/**
+ * @brief release everything in the arena at once
+ * @param arena the arena
+ */
+#define bytelizer_arena_reset(arena) ((arena)->used = 0)
+
+/**
+ * @brief get the used bytes of the arena
+ * @param arena the arena
+ */
+#define bytelizer_arena_used(arena) ((arena)->used)
+
+/**
+ * @brief allocate from the arena
+ * @param arena the arena
+ * @param size the size
+ * @return the memory, NULL if the arena is full
+ */
+_inline static void* bytelizer_arena_push(bytelizer_arena_t* arena, uint32_t size) {
+
+  uintptr_t _base = (uintptr_t)arena->buffer;
+  uintptr_t _aligned = (_base + arena->used + (BYTELIZER_ARENA_ALIGN - 1)) & ~(uintptr_t)(BYTELIZER_ARENA_ALIGN - 1);
+  uint64_t _end = (uint64_t)(_aligned - _base) + size;
+
+  if(_end > arena->size) {
+    __bytelizer_log("arena is full, %u of %u bytes used, %u requested",
+      arena->used, arena->size, size);
+    return NULL;
+  }
+
+  arena->used = (uint32_t)_end;
+  return (void *)_aligned;
+}
+
+/**
+ * @brief allocate zeroed memory from the arena
+ * @param arena the arena
+ * @param size the size
+ * @return the memory, NULL if the arena is full
+ */
+_inline static void* bytelizer_arena_push_zero(bytelizer_arena_t* arena, uint32_t size) {
+
+  void* _memory = bytelizer_arena_push(arena, size);
+  if(_memory != NULL) memset(_memory, 0, size);
+
+  return _memory;
+}
+
+#endif /* _BYTELIZER_ARENA_H */
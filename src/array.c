@@ -0,0 +1,178 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <bytelizer/common.h>
+#include "debug/log.h"
+#include "bitwise.h"
+#include "simd.h"
+#include "codec.h"
+#include "array.h"
+
+typedef void (* __swap_kernel_t)(uint8_t* dst, const uint8_t* src, size_t count, uint32_t width);
+
+static void __swap_scalar(uint8_t* dst, const uint8_t* src, size_t count, uint32_t width) {
+
+  // memcpy keeps the unaligned access well-defined,
+  // compilers turn it into a plain load/store
+  switch(width) {
+    case sizeof(uint16_t):
+      for(size_t i = 0; i < count; ++i, src += 2, dst += 2) {
+        uint16_t _value; memcpy(&_value, src, 2);
+        _value = _swap_16(_value); memcpy(dst, &_value, 2);
+      }
+      break;
+
+    case sizeof(uint32_t):
+      for(size_t i = 0; i < count; ++i, src += 4, dst += 4) {
+        uint32_t _value; memcpy(&_value, src, 4);
+        _value = _swap_32(_value); memcpy(dst, &_value, 4);
+      }
+      break;
+
+    case sizeof(uint64_t):
+      for(size_t i = 0; i < count; ++i, src += 8, dst += 8) {
+        uint64_t _value; memcpy(&_value, src, 8);
+        _value = _swap_64(_value); memcpy(dst, &_value, 8);
+      }
+      break;
+
+    default:
+      __bytelizer_log("unsupported array element width %u", width);
+      break;
+  }
+}
+
+#if BYTELIZER_SIMD_X86
+
+// pshufb masks reversing every 2/4/8 bytes lane
+static const uint8_t __swap_mask[3][16] = {
+  { 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14 },
+  { 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12 },
+  { 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8 },
+};
+
+_inline static const uint8_t* __swap_mask_of(uint32_t width) {
+  return __swap_mask[width == 2 ? 0 : (width == 4 ? 1 : 2)];
+}
+
+__simd_target("ssse3")
+static void __swap_ssse3(uint8_t* dst, const uint8_t* src, size_t count, uint32_t width) {
+
+  size_t _bytes = count * width;
+  size_t _vectors = _bytes / 16;
+  __m128i _mask = _mm_loadu_si128((const __m128i *)__swap_mask_of(width));
+
+  for(size_t i = 0; i < _vectors; ++i, src += 16, dst += 16) {
+    __m128i _value = _mm_loadu_si128((const __m128i *)src);
+    _mm_storeu_si128((__m128i *)dst, _mm_shuffle_epi8(_value, _mask));
+  }
+
+  // the tail is always less than 16 bytes
+  __swap_scalar(dst, src, (_bytes % 16) / width, width);
+}
+
+__simd_target("avx2")
+static void __swap_avx2(uint8_t* dst, const uint8_t* src, size_t count, uint32_t width) {
+
+  size_t _bytes = count * width;
+  size_t _vectors = _bytes / 32;
+  __m256i _mask = _mm256_broadcastsi128_si256(
+    _mm_loadu_si128((const __m128i *)__swap_mask_of(width)));
+
+  // unrolled by two, telemetry arrays are usually thousands of elements
+  for(; _vectors >= 2; _vectors -= 2, src += 64, dst += 64) {
+    __m256i _v0 = _mm256_loadu_si256((const __m256i *)src);
+    __m256i _v1 = _mm256_loadu_si256((const __m256i *)(src + 32));
+    _mm256_storeu_si256((__m256i *)dst, _mm256_shuffle_epi8(_v0, _mask));
+    _mm256_storeu_si256((__m256i *)(dst + 32), _mm256_shuffle_epi8(_v1, _mask));
+  }
+
+  if(_vectors > 0) {
+    __m256i _value = _mm256_loadu_si256((const __m256i *)src);
+    _mm256_storeu_si256((__m256i *)dst, _mm256_shuffle_epi8(_value, _mask));
+    src += 32; dst += 32;
+  }
+
+  __swap_scalar(dst, src, (_bytes % 32) / width, width);
+}
+
+#endif /* BYTELIZER_SIMD_X86 */
+
+static void __swap_array(uint8_t* dst, const uint8_t* src, size_t count, uint32_t width) {
+
+  static __swap_kernel_t _kernel = NULL;
+
+  // pick the kernel once, racing threads
+  // always resolve to the same pointer
+  if(_kernel == NULL) {
+    __swap_kernel_t _selected = __swap_scalar;
+  #if BYTELIZER_SIMD_X86
+    if(bytelizer_simd_has(simd_feature_avx2)) _selected = __swap_avx2;
+    else if(bytelizer_simd_has(simd_feature_ssse3)) _selected = __swap_ssse3;
+  #endif
+    _kernel = _selected;
+  }
+
+  _kernel(dst, src, count, width);
+}
+
+void bytelizer_put_array(bytelizer_ctx_t* ctx, const void* values,
+uint32_t count, uint32_t width, bool swap) {
+
+  if(values == NULL || count == 0)
+    return;
+
+  size_t _length = (size_t)count * width;
+  if(_length > UINT32_MAX) {
+    __bytelizer_log("array is too large, %u elements", count);
+    return;
+  }
+
+  // only one capacity reservation for the whole array
+  if(!bytelizer_ensure_available(ctx, _length)) {
+    __bytelizer_log("put array failed, is it out of memory?");
+    return;
+  }
+
+  if(swap) __swap_array(ctx->cursor, (const uint8_t *)values, count, width);
+  else memcpy(ctx->cursor, values, _length);
+
+  bytelizer_update_cursor(ctx, (uint32_t)_length);
+}
+
+void bytelizer_get_array(bytelizer_ctx_t* ctx, void* values,
+uint32_t count, uint32_t width, bool swap) {
+
+  if(values == NULL || count == 0)
+    return;
+
+  size_t _length = (size_t)count * width;
+
+  if(swap) __swap_array((uint8_t *)values, ctx->cursor, count, width);
+  else memcpy(values, ctx->cursor, _length);
+
+  bytelizer_update_cursor(ctx, (uint32_t)_length);
+}
+
+uint8_t* bytelizer_swap_array(bytelizer_ctx_t* ctx,
+uint32_t count, uint32_t width, bool swap) {
+
+  uint8_t* _begin = ctx->cursor;
+  size_t _length = (size_t)count * width;
+
+  if(swap && count > 0)
+    __swap_array(_begin, _begin, count, width);
+
+  bytelizer_update_cursor(ctx, (uint32_t)_length);
+  return _begin;
+}
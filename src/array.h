@@ -0,0 +1,475 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#ifndef _BYTELIZER_ARRAY_H
+#define _BYTELIZER_ARRAY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <bytelizer/common.h>
+#include "codec.h"
+
+/**
+ * @brief put an array into buffer with a single reservation
+ * @param ctx the bytelizer context
+ * @param values the array
+ * @param count the count of elements
+ * @param width the width of one element, 2, 4 or 8
+ * @param swap byte swap every element
+*/
+void bytelizer_put_array(bytelizer_ctx_t* ctx, const void* values,
+uint32_t count, uint32_t width, bool swap);
+
+/**
+ * @brief get an array from buffer
+ * @param ctx the bytelizer context
+ * @param values the array to be filled
+ * @param count the count of elements
+ * @param width the width of one element, 2, 4 or 8
+ * @param swap byte swap every element
+*/
+void bytelizer_get_array(bytelizer_ctx_t* ctx, void* values,
+uint32_t count, uint32_t width, bool swap);
+
+/**
+ * @brief byte swap an array in the buffer in place, then skip it
+ * @param ctx the bytelizer context (usually attached)
+ * @param count the count of elements
+ * @param width the width of one element, 2, 4 or 8
+ * @param swap byte swap every element
+ * @return the beginning of the array in the buffer
+*/
+uint8_t* bytelizer_swap_array(bytelizer_ctx_t* ctx,
+uint32_t count, uint32_t width, bool swap);
+
+#if BYTELIZER_ENDIANNESS == BYTELIZER_BIG_ENDIAN
+  #define __array_swap_le true
+  #define __array_swap_be false
+#else
+  #define __array_swap_le false
+  #define __array_swap_be true
+#endif
+
+/**
+ * @brief put uint16 array into the buffer as little endian
+ * @param ctx the bytelizer context
+ * @param values the array
+ * @param count the count of elements
+*/
+#define bytelizer_put_uint16_array_le(ctx, values, count) \
+  bytelizer_put_array(ctx, values, count, sizeof(uint16_t), __array_swap_le)
+
+/**
+ * @brief put uint32 array into the buffer as little endian
+ * @param ctx the bytelizer context
+ * @param values the array
+ * @param count the count of elements
+*/
+#define bytelizer_put_uint32_array_le(ctx, values, count) \
+  bytelizer_put_array(ctx, values, count, sizeof(uint32_t), __array_swap_le)
+
+/**
+ * @brief put uint64 array into the buffer as little endian
+ * @param ctx the bytelizer context
+ * @param values the array
+ * @param count the count of elements
+*/
+#define bytelizer_put_uint64_array_le(ctx, values, count) \
+  bytelizer_put_array(ctx, values, count, sizeof(uint64_t), __array_swap_le)
+
+/**
+ * @brief put int16 array into the buffer as little endian
+ * @param ctx the bytelizer context
+ * @param values the array
+ * @param count the count of elements
+*/
+#define bytelizer_put_int16_array_le(ctx, values, count) \
+  bytelizer_put_array(ctx, values, count, sizeof(int16_t), __array_swap_le)
+
+/**
+ * @brief put int32 array into the buffer as little endian
+ * @param ctx the bytelizer context
+ * @param values the array
+ * @param count the count of elements
+*/
+#define bytelizer_put_int32_array_le(ctx, values, count) \
+  bytelizer_put_array(ctx, values, count, sizeof(int32_t), __array_swap_le)
+
+/**
+ * @brief put int64 array into the buffer as little endian
+ * @param ctx the bytelizer context
+ * @param values the array
+ * @param count the count of elements
+*/
+#define bytelizer_put_int64_array_le(ctx, values, count) \
+  bytelizer_put_array(ctx, values, count, sizeof(int64_t), __array_swap_le)
+
+/**
+ * @brief put float array into the buffer as little endian
+ * @param ctx the bytelizer context
+ * @param values the array
+ * @param count the count of elements
+*/
+#define bytelizer_put_float_array_le(ctx, values, count) \
+  bytelizer_put_array(ctx, values, count, sizeof(float), __array_swap_le)
+
+/**
+ * @brief put double array into the buffer as little endian
+ * @param ctx the bytelizer context
+ * @param values the array
+ * @param count the count of elements
+*/
+#define bytelizer_put_double_array_le(ctx, values, count) \
+  bytelizer_put_array(ctx, values, count, sizeof(double), __array_swap_le)
+
+/**
+ * @brief put uint16 array into the buffer as big endian
+ * @param ctx the bytelizer context
+ * @param values the array
+ * @param count the count of elements
+*/
+#define bytelizer_put_uint16_array_be(ctx, values, count) \
+  bytelizer_put_array(ctx, values, count, sizeof(uint16_t), __array_swap_be)
+
+/**
+ * @brief put uint32 array into the buffer as big endian
+ * @param ctx the bytelizer context
+ * @param values the array
+ * @param count the count of elements
+*/
+#define bytelizer_put_uint32_array_be(ctx, values, count) \
+  bytelizer_put_array(ctx, values, count, sizeof(uint32_t), __array_swap_be)
+
+/**
+ * @brief put uint64 array into the buffer as big endian
+ * @param ctx the bytelizer context
+ * @param values the array
+ * @param count the count of elements
+*/
+#define bytelizer_put_uint64_array_be(ctx, values, count) \
+  bytelizer_put_array(ctx, values, count, sizeof(uint64_t), __array_swap_be)
+
+/**
+ * @brief put int16 array into the buffer as big endian
+ * @param ctx the bytelizer context
+ * @param values the array
+ * @param count the count of elements
+*/
+#define bytelizer_put_int16_array_be(ctx, values, count) \
+  bytelizer_put_array(ctx, values, count, sizeof(int16_t), __array_swap_be)
+
+/**
+ * @brief put int32 array into the buffer as big endian
+ * @param ctx the bytelizer context
+ * @param values the array
+ * @param count the count of elements
+*/
+#define bytelizer_put_int32_array_be(ctx, values, count) \
+  bytelizer_put_array(ctx, values, count, sizeof(int32_t), __array_swap_be)
+
+/**
+ * @brief put int64 array into the buffer as big endian
+ * @param ctx the bytelizer context
+ * @param values the array
+ * @param count the count of elements
+*/
+#define bytelizer_put_int64_array_be(ctx, values, count) \
+  bytelizer_put_array(ctx, values, count, sizeof(int64_t), __array_swap_be)
+
+/**
+ * @brief put float array into the buffer as big endian
+ * @param ctx the bytelizer context
+ * @param values the array
+ * @param count the count of elements
+*/
+#define bytelizer_put_float_array_be(ctx, values, count) \
+  bytelizer_put_array(ctx, values, count, sizeof(float), __array_swap_be)
+
+/**
+ * @brief put double array into the buffer as big endian
+ * @param ctx the bytelizer context
+ * @param values the array
+ * @param count the count of elements
+*/
+#define bytelizer_put_double_array_be(ctx, values, count) \
+  bytelizer_put_array(ctx, values, count, sizeof(double), __array_swap_be)
+
+/**
+ * @brief get uint16 array from the buffer as little endian
+ * @param ctx the bytelizer context
+ * @param values the array to be filled
+ * @param count the count of elements
+*/
+#define bytelizer_get_uint16_array_le(ctx, values, count) \
+  bytelizer_get_array(ctx, values, count, sizeof(uint16_t), __array_swap_le)
+
+/**
+ * @brief get uint32 array from the buffer as little endian
+ * @param ctx the bytelizer context
+ * @param values the array to be filled
+ * @param count the count of elements
+*/
+#define bytelizer_get_uint32_array_le(ctx, values, count) \
+  bytelizer_get_array(ctx, values, count, sizeof(uint32_t), __array_swap_le)
+
+/**
+ * @brief get uint64 array from the buffer as little endian
+ * @param ctx the bytelizer context
+ * @param values the array to be filled
+ * @param count the count of elements
+*/
+#define bytelizer_get_uint64_array_le(ctx, values, count) \
+  bytelizer_get_array(ctx, values, count, sizeof(uint64_t), __array_swap_le)
+
+/**
+ * @brief get int16 array from the buffer as little endian
+ * @param ctx the bytelizer context
+ * @param values the array to be filled
+ * @param count the count of elements
+*/
+#define bytelizer_get_int16_array_le(ctx, values, count) \
+  bytelizer_get_array(ctx, values, count, sizeof(int16_t), __array_swap_le)
+
+/**
+ * @brief get int32 array from the buffer as little endian
+ * @param ctx the bytelizer context
+ * @param values the array to be filled
+ * @param count the count of elements
+*/
+#define bytelizer_get_int32_array_le(ctx, values, count) \
+  bytelizer_get_array(ctx, values, count, sizeof(int32_t), __array_swap_le)
+
+/**
+ * @brief get int64 array from the buffer as little endian
+ * @param ctx the bytelizer context
+ * @param values the array to be filled
+ * @param count the count of elements
+*/
+#define bytelizer_get_int64_array_le(ctx, values, count) \
+  bytelizer_get_array(ctx, values, count, sizeof(int64_t), __array_swap_le)
+
+/**
+ * @brief get float array from the buffer as little endian
+ * @param ctx the bytelizer context
+ * @param values the array to be filled
+ * @param count the count of elements
+*/
+#define bytelizer_get_float_array_le(ctx, values, count) \
+  bytelizer_get_array(ctx, values, count, sizeof(float), __array_swap_le)
+
+/**
+ * @brief get double array from the buffer as little endian
+ * @param ctx the bytelizer context
+ * @param values the array to be filled
+ * @param count the count of elements
+*/
+#define bytelizer_get_double_array_le(ctx, values, count) \
+  bytelizer_get_array(ctx, values, count, sizeof(double), __array_swap_le)
+
+/**
+ * @brief get uint16 array from the buffer as big endian
+ * @param ctx the bytelizer context
+ * @param values the array to be filled
+ * @param count the count of elements
+*/
+#define bytelizer_get_uint16_array_be(ctx, values, count) \
+  bytelizer_get_array(ctx, values, count, sizeof(uint16_t), __array_swap_be)
+
+/**
+ * @brief get uint32 array from the buffer as big endian
+ * @param ctx the bytelizer context
+ * @param values the array to be filled
+ * @param count the count of elements
+*/
+#define bytelizer_get_uint32_array_be(ctx, values, count) \
+  bytelizer_get_array(ctx, values, count, sizeof(uint32_t), __array_swap_be)
+
+/**
+ * @brief get uint64 array from the buffer as big endian
+ * @param ctx the bytelizer context
+ * @param values the array to be filled
+ * @param count the count of elements
+*/
+#define bytelizer_get_uint64_array_be(ctx, values, count) \
+  bytelizer_get_array(ctx, values, count, sizeof(uint64_t), __array_swap_be)
+
+/**
+ * @brief get int16 array from the buffer as big endian
+ * @param ctx the bytelizer context
+ * @param values the array to be filled
+ * @param count the count of elements
+*/
+#define bytelizer_get_int16_array_be(ctx, values, count) \
+  bytelizer_get_array(ctx, values, count, sizeof(int16_t), __array_swap_be)
+
+/**
+ * @brief get int32 array from the buffer as big endian
+ * @param ctx the bytelizer context
+ * @param values the array to be filled
+ * @param count the count of elements
+*/
+#define bytelizer_get_int32_array_be(ctx, values, count) \
+  bytelizer_get_array(ctx, values, count, sizeof(int32_t), __array_swap_be)
+
+/**
+ * @brief get int64 array from the buffer as big endian
+ * @param ctx the bytelizer context
+ * @param values the array to be filled
+ * @param count the count of elements
+*/
+#define bytelizer_get_int64_array_be(ctx, values, count) \
+  bytelizer_get_array(ctx, values, count, sizeof(int64_t), __array_swap_be)
+
+/**
+ * @brief get float array from the buffer as big endian
+ * @param ctx the bytelizer context
+ * @param values the array to be filled
+ * @param count the count of elements
+*/
+#define bytelizer_get_float_array_be(ctx, values, count) \
+  bytelizer_get_array(ctx, values, count, sizeof(float), __array_swap_be)
+
+/**
+ * @brief get double array from the buffer as big endian
+ * @param ctx the bytelizer context
+ * @param values the array to be filled
+ * @param count the count of elements
+*/
+#define bytelizer_get_double_array_be(ctx, values, count) \
+  bytelizer_get_array(ctx, values, count, sizeof(double), __array_swap_be)
+
+/**
+ * @brief convert uint16 array in the buffer from little endian in place
+ * @param ctx the bytelizer context
+ * @param count the count of elements
+*/
+#define bytelizer_swap_uint16_array_le(ctx, count) \
+  ((uint16_t *)bytelizer_swap_array(ctx, count, sizeof(uint16_t), __array_swap_le))
+
+/**
+ * @brief convert uint32 array in the buffer from little endian in place
+ * @param ctx the bytelizer context
+ * @param count the count of elements
+*/
+#define bytelizer_swap_uint32_array_le(ctx, count) \
+  ((uint32_t *)bytelizer_swap_array(ctx, count, sizeof(uint32_t), __array_swap_le))
+
+/**
+ * @brief convert uint64 array in the buffer from little endian in place
+ * @param ctx the bytelizer context
+ * @param count the count of elements
+*/
+#define bytelizer_swap_uint64_array_le(ctx, count) \
+  ((uint64_t *)bytelizer_swap_array(ctx, count, sizeof(uint64_t), __array_swap_le))
+
+/**
+ * @brief convert int16 array in the buffer from little endian in place
+ * @param ctx the bytelizer context
+ * @param count the count of elements
+*/
+#define bytelizer_swap_int16_array_le(ctx, count) \
+  ((int16_t *)bytelizer_swap_array(ctx, count, sizeof(int16_t), __array_swap_le))
+
+/**
+ * @brief convert int32 array in the buffer from little endian in place
+ * @param ctx the bytelizer context
+ * @param count the count of elements
+*/
+#define bytelizer_swap_int32_array_le(ctx, count) \
+  ((int32_t *)bytelizer_swap_array(ctx, count, sizeof(int32_t), __array_swap_le))
+
+/**
+ * @brief convert int64 array in the buffer from little endian in place
+ * @param ctx the bytelizer context
+ * @param count the count of elements
+*/
+#define bytelizer_swap_int64_array_le(ctx, count) \
+  ((int64_t *)bytelizer_swap_array(ctx, count, sizeof(int64_t), __array_swap_le))
+
+/**
+ * @brief convert float array in the buffer from little endian in place
+ * @param ctx the bytelizer context
+ * @param count the count of elements
+*/
+#define bytelizer_swap_float_array_le(ctx, count) \
+  ((float *)bytelizer_swap_array(ctx, count, sizeof(float), __array_swap_le))
+
+/**
+ * @brief convert double array in the buffer from little endian in place
+ * @param ctx the bytelizer context
+ * @param count the count of elements
+*/
+#define bytelizer_swap_double_array_le(ctx, count) \
+  ((double *)bytelizer_swap_array(ctx, count, sizeof(double), __array_swap_le))
+
+/**
+ * @brief convert uint16 array in the buffer from big endian in place
+ * @param ctx the bytelizer context
+ * @param count the count of elements
+*/
+#define bytelizer_swap_uint16_array_be(ctx, count) \
+  ((uint16_t *)bytelizer_swap_array(ctx, count, sizeof(uint16_t), __array_swap_be))
+
+/**
+ * @brief convert uint32 array in the buffer from big endian in place
+ * @param ctx the bytelizer context
+ * @param count the count of elements
+*/
+#define bytelizer_swap_uint32_array_be(ctx, count) \
+  ((uint32_t *)bytelizer_swap_array(ctx, count, sizeof(uint32_t), __array_swap_be))
+
+/**
+ * @brief convert uint64 array in the buffer from big endian in place
+ * @param ctx the bytelizer context
+ * @param count the count of elements
+*/
+#define bytelizer_swap_uint64_array_be(ctx, count) \
+  ((uint64_t *)bytelizer_swap_array(ctx, count, sizeof(uint64_t), __array_swap_be))
+
+/**
+ * @brief convert int16 array in the buffer from big endian in place
+ * @param ctx the bytelizer context
+ * @param count the count of elements
+*/
+#define bytelizer_swap_int16_array_be(ctx, count) \
+  ((int16_t *)bytelizer_swap_array(ctx, count, sizeof(int16_t), __array_swap_be))
+
+/**
+ * @brief convert int32 array in the buffer from big endian in place
+ * @param ctx the bytelizer context
+ * @param count the count of elements
+*/
+#define bytelizer_swap_int32_array_be(ctx, count) \
+  ((int32_t *)bytelizer_swap_array(ctx, count, sizeof(int32_t), __array_swap_be))
+
+/**
+ * @brief convert int64 array in the buffer from big endian in place
+ * @param ctx the bytelizer context
+ * @param count the count of elements
+*/
+#define bytelizer_swap_int64_array_be(ctx, count) \
+  ((int64_t *)bytelizer_swap_array(ctx, count, sizeof(int64_t), __array_swap_be))
+
+/**
+ * @brief convert float array in the buffer from big endian in place
+ * @param ctx the bytelizer context
+ * @param count the count of elements
+*/
+#define bytelizer_swap_float_array_be(ctx, count) \
+  ((float *)bytelizer_swap_array(ctx, count, sizeof(float), __array_swap_be))
+
+/**
+ * @brief convert double array in the buffer from big endian in place
+ * @param ctx the bytelizer context
+ * @param count the count of elements
+*/
+#define bytelizer_swap_double_array_be(ctx, count) \
+  ((double *)bytelizer_swap_array(ctx, count, sizeof(double), __array_swap_be))
+
+#endif /* _BYTELIZER_ARRAY_H */
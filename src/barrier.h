@@ -10,6 +10,7 @@
 #ifndef _BYTELIZER_BARRIER_H
 #define _BYTELIZER_BARRIER_H
 
+#include <stdlib.h>
 #include <bytelizer/common.h>
 
 #include "compiler.h"
@@ -17,32 +18,47 @@
 #include "advanced.h"
 #include "anchor.h"
 #include "bitwise.h"
+#include "varint.h"
+#include "checksum.h"
 #include "debug/log.h"
 
-typedef struct {
+typedef enum {
+  digest_trailer = 0x00,
+  digest_header  = 0x01,
+  digest_le      = 0x00,
+  digest_be      = 0x02,
+} bytelizer_digest_t;
+
+typedef struct _bytelizer_barrier_t {
   bytelizer_ctx_t* ref;
   bytelizer_anchor_t anchor;
   uint32_t prefix_len;
   bytelizer_prefix_t prefix_basetype;
   bytelizer_prefix_t prefix_lentype;
+  bool compact;
+
+  // running checksum over the barrier body
+  bytelizer_hash_t hash;
+  bytelizer_digest_t digest;
+  uint8_t* digest_cursor;
+  bytelizer_list_node_t* hash_node;
+  uint8_t* hash_cursor;
 } bytelizer_barrier_t;
 
-_inline static bool __barrier_enter(bytelizer_barrier_t* barrier,
-bytelizer_ctx_t* ref, bytelizer_prefix_t prefix) {
+_inline static bool __barrier_enter_inline(bytelizer_barrier_t* barrier,
+bytelizer_ctx_t* ref, bytelizer_prefix_t basetype, bytelizer_prefix_t lentype, bool compact) {
 
-  uint32_t _value;
-  bytelizer_prefix_t _basetype, _lentype; {
-    __parse_prefix(prefix, 0, &_basetype, &_lentype);
-    _value = __get_prefix_length_by_type(_lentype);
-  }
+  uint32_t _value = __get_prefix_length_by_type(lentype);
 
   if(bytelizer_mark_anchor(&barrier->anchor,
     ref, ref->total_length, _value)) {
     
     barrier->ref = ref;
     barrier->prefix_len = _value;
-    barrier->prefix_basetype = _basetype;
-    barrier->prefix_lentype = _lentype;
+    barrier->prefix_basetype = basetype;
+    barrier->prefix_lentype = lentype;
+    barrier->compact = compact;
+    barrier->hash.algorithm = checksum_none;
 
     return true;
   }
@@ -51,7 +67,175 @@ bytelizer_ctx_t* ref, bytelizer_prefix_t prefix) {
   return false;
 }
 
-static bool __barrier_leave(bytelizer_barrier_t* barrier, uint32_t offset) {
+_inline static bool __barrier_enter(bytelizer_barrier_t* barrier,
+bytelizer_ctx_t* ref, bytelizer_prefix_t prefix) {
+
+  bytelizer_prefix_t _basetype, _lentype;
+  __parse_prefix(prefix, 0, &_basetype, &_lentype);
+
+  return __barrier_enter_inline(barrier, ref,
+    _basetype, _lentype, (prefix & prefix_compact) != 0);
+}
+
+/**
+ * @brief move the barrier body backward to drop unused prefix bytes
+ * @param barrier the barrier
+ * @param shrink the bytes to drop
+ * @return false if the body has spilled into another block
+ */
+static bool __barrier_shrink(bytelizer_barrier_t* barrier, uint32_t shrink) {
+
+  bytelizer_ctx_t* _ref = barrier->ref;
+
+  // the prefix and the body must be in the same block,
+  // a spilled body can't be moved across the blocks
+  if(__anchor_current_block(_ref) != barrier->anchor.block)
+    return false;
+
+  uint8_t* _body = bytelizer_anchor_cursor(&barrier->anchor) + barrier->prefix_len;
+  memmove(_body - shrink, _body, _ref->cursor - _body);
+
+  _ref->cursor -= shrink;
+  _ref->total_length -= shrink;
+  *_ref->counter -= shrink;
+
+  return true;
+}
+
+static bool __barrier_leave_varint(bytelizer_barrier_t* barrier,
+bytelizer_prefix_t basetype, uint32_t body) {
+
+  uint32_t _width = barrier->prefix_len;
+
+  if(barrier->compact) {
+
+    uint32_t _compact = __varint_length(body);
+    if(basetype == prefix_withself) {
+      while(__varint_length((uint64_t)body + _compact) != _compact)
+        _compact = __varint_length((uint64_t)body + _compact);
+    }
+
+    // fallback to the padded varint if the body can't be moved
+    if(_compact < _width && __barrier_shrink(barrier, _width - _compact))
+      _width = _compact;
+  }
+
+  if(basetype == prefix_withself)
+    body += _width;
+
+  __number_tovarint_padded(body, bytelizer_anchor_cursor(&barrier->anchor), _width);
+  return true;
+}
+
+/**
+ * @brief start a running checksum right after the prefix
+ * @param barrier the entered barrier
+ * @param algorithm the algorithm, see @ref bytelizer_checksum_t
+ * @param digest where and how the digest is written, see @ref bytelizer_digest_t
+ */
+static bool __barrier_begin_checksum(bytelizer_barrier_t* barrier,
+bytelizer_checksum_t algorithm, bytelizer_digest_t digest) {
+
+  bytelizer_ctx_t* _ref = barrier->ref;
+
+  // reserve the digest in front of the body
+  if(digest & digest_header) {
+
+    if(!bytelizer_ensure_available(_ref, sizeof(uint32_t))) {
+      __bytelizer_log("reserve checksum failed, is it out of memory?");
+      return false;
+    }
+
+    barrier->digest_cursor = _ref->cursor;
+    bytelizer_update_cursor(_ref, sizeof(uint32_t));
+  }
+
+  bytelizer_hash_init(&barrier->hash, algorithm);
+  barrier->digest = digest;
+  barrier->hash_node = (_ref->blocks != NULL) ? _ref->blocks->tail : NULL;
+  barrier->hash_cursor = _ref->cursor;
+
+  return true;
+}
+
+_inline static bool __barrier_enter_checksum_inline(bytelizer_barrier_t* barrier,
+bytelizer_ctx_t* ref, bytelizer_prefix_t basetype, bytelizer_prefix_t lentype,
+bytelizer_checksum_t algorithm, bytelizer_digest_t digest) {
+  return __barrier_enter_inline(barrier, ref, basetype, lentype, false) &&
+    __barrier_begin_checksum(barrier, algorithm, digest);
+}
+
+_inline static bool __barrier_enter_checksum(bytelizer_barrier_t* barrier,
+bytelizer_ctx_t* ref, bytelizer_prefix_t prefix,
+bytelizer_checksum_t algorithm, bytelizer_digest_t digest) {
+  return __barrier_enter(barrier, ref, prefix) &&
+    __barrier_begin_checksum(barrier, algorithm, digest);
+}
+
+/**
+ * @brief hash the bytes written since the last update,
+ * walking into the blocks created meanwhile
+ * @param barrier the barrier
+ */
+static void __barrier_update_checksum(bytelizer_barrier_t* barrier) {
+
+  bytelizer_ctx_t* _ref = barrier->ref;
+
+  for(;;) {
+
+    // the written end of the region being hashed
+    uint8_t* _end;
+    if(barrier->hash_node == NULL) {
+      _end = _ref->stack + _ref->stack_wrotes;
+    }
+    else {
+      bytelizer_block_t* _block = *(bytelizer_block_t **)barrier->hash_node->data;
+      _end = (uint8_t *)_block + sizeof(bytelizer_block_t) + _block->wrotes;
+    }
+
+    if(_end > barrier->hash_cursor) {
+      bytelizer_hash_update(&barrier->hash, barrier->hash_cursor, _end - barrier->hash_cursor);
+      barrier->hash_cursor = _end;
+    }
+
+    bytelizer_list_node_t* _next = (barrier->hash_node == NULL)
+      ? (_ref->blocks != NULL ? _ref->blocks->head : NULL)
+      : barrier->hash_node->next;
+
+    if(_next == NULL)
+      break;
+
+    barrier->hash_node = _next;
+    barrier->hash_cursor = (uint8_t *)*(bytelizer_block_t **)_next->data + sizeof(bytelizer_block_t);
+  }
+}
+
+static bool __barrier_finish_checksum(bytelizer_barrier_t* barrier) {
+
+  __barrier_update_checksum(barrier);
+
+  uint32_t _digest = bytelizer_hash_digest(&barrier->hash);
+  _digest = (barrier->digest & digest_be) ? bitwise_be32(_digest) : bitwise_le32(_digest);
+
+  // the trailer is a part of the body, so it's counted by the prefix
+  if(barrier->digest & digest_header) {
+    bytelizer_write_value_unsafe(barrier->digest_cursor, uint32_t, _digest);
+  }
+  else {
+    bytelizer_put_bytes(barrier->ref, (const uint8_t *)&_digest, sizeof(uint32_t));
+  }
+
+  barrier->hash.algorithm = checksum_none;
+  return true;
+}
+
+_inline static bool __barrier_leave_inline(bytelizer_barrier_t* barrier,
+uint32_t offset, bytelizer_prefix_t basetype, bytelizer_prefix_t lentype) {
+
+  uint32_t _prefix_len = (uint32_t)__get_prefix_length_by_type(lentype);
+
+  if(barrier->hash.algorithm != checksum_none)
+    __barrier_finish_checksum(barrier);
 
   uint32_t length = 0; {
     length += offset;
@@ -59,40 +243,88 @@ static bool __barrier_leave(bytelizer_barrier_t* barrier, uint32_t offset) {
     
     // remove self length
     // because (total_length - anchor.userdata) including prefix length
-    if(barrier->prefix_basetype == prefix_length_only)
-      length -= barrier->prefix_len;
+    if(basetype == prefix_length_only)
+      length -= _prefix_len;
+  }
+
+  // the width of varint is decided on leave
+  if(lentype == prefix_varint) {
+    uint32_t _body = length;
+    if(basetype == prefix_withself)
+      _body -= _prefix_len;
+
+    return __barrier_leave_varint(barrier, basetype, _body);
   }
 
   // write anchor value
-  switch(barrier->prefix_lentype) {
+  uint8_t* _cursor = bytelizer_anchor_cursor(&barrier->anchor);
+  switch(lentype) {
     case prefix_uint8:
-      bytelizer_write_value_unsafe(barrier->anchor.old.cursor, uint8_t, (uint8_t)length);
+      bytelizer_write_value_unsafe(_cursor, uint8_t, (uint8_t)length);
       break;
 
     case prefix_uint16le:
-      bytelizer_write_value_unsafe(barrier->anchor.old.cursor, uint16_t, bitwise_le16((uint16_t)length));
+      bytelizer_write_value_unsafe(_cursor, uint16_t, bitwise_le16((uint16_t)length));
       break;
 
     case prefix_uint32le:
-      bytelizer_write_value_unsafe(barrier->anchor.old.cursor, uint32_t, bitwise_le32(length));
+      bytelizer_write_value_unsafe(_cursor, uint32_t, bitwise_le32(length));
       break;
 
     case prefix_uint16be:
-      bytelizer_write_value_unsafe(barrier->anchor.old.cursor, uint16_t, bitwise_be16((uint16_t)length));
+      bytelizer_write_value_unsafe(_cursor, uint16_t, bitwise_be16((uint16_t)length));
       break;
 
     case prefix_uint32be:
-      bytelizer_write_value_unsafe(barrier->anchor.old.cursor, uint32_t, bitwise_be32(length));
+      bytelizer_write_value_unsafe(_cursor, uint32_t, bitwise_be32(length));
+      break;
+
+    case prefix_uint64le:
+      bytelizer_write_value_unsafe(_cursor, uint64_t, bitwise_le64((uint64_t)length));
+      break;
+
+    case prefix_uint64be:
+      bytelizer_write_value_unsafe(_cursor, uint64_t, bitwise_be64((uint64_t)length));
       break;
 
     default:
-     __bytelizer_log("unsupported prefix type: %d", barrier->prefix_lentype);
+     __bytelizer_log("unsupported prefix type: %d", lentype);
       return false;
   }
 
   return true;
 }
 
+static bool __barrier_leave(bytelizer_barrier_t* barrier, uint32_t offset) {
+  return __barrier_leave_inline(barrier, offset,
+    barrier->prefix_basetype, barrier->prefix_lentype);
+}
+
+// specialized enter/leave for every constant prefix,
+// the prefix parsing and the switch are folded away
+#define __DEFINE_BARRIER_SPEC(base, len) \
+  _inline static bool __barrier_enter_##base##_##len(bytelizer_barrier_t* barrier, \
+  bytelizer_ctx_t* ref, bytelizer_prefix_t modifiers) { \
+    return __barrier_enter_inline(barrier, ref, \
+      prefix_##base, prefix_##len, (modifiers & prefix_compact) != 0); \
+  } \
+  _inline static bool __barrier_leave_##base##_##len(bytelizer_barrier_t* barrier, \
+  uint32_t offset) { \
+    return __barrier_leave_inline(barrier, offset, prefix_##base, prefix_##len); \
+  }
+
+__BYTELIZER_PREFIX_SPECS(__DEFINE_BARRIER_SPEC)
+
+#undef __DEFINE_BARRIER_SPEC
+
+/**
+ * @brief enter a barrier, the length prefix is filled on leave
+ * @param barrier the barrier name
+ * @param ref the bytelizer context
+ * @param prefix the prefix, a varint prefix reserves the maximal width
+ * and is padded on leave, or compacted with `prefix_compact`
+ * (anchors inside a compacted barrier will be moved)
+*/
 #define bytelizer_barrier_enter(barrier, ref, prefix) \
   bytelizer_barrier_t _barrier##barrier; \
   __barrier_enter(&_barrier##barrier, ref, prefix)
@@ -103,4 +335,198 @@ static bool __barrier_leave(bytelizer_barrier_t* barrier, uint32_t offset) {
 #define bytelizer_barrier_leave_offset(barrier, offset)\
   __barrier_leave(&_barrier##barrier, offset)
 
+/**
+ * @brief enter a barrier with a constant prefix
+ * @param barrier the barrier name
+ * @param ref the bytelizer context
+ * @param base the base type without `prefix_`, length_only or withself
+ * @param len the length type without `prefix_`, e.g. uint16be or varint
+*/
+#define bytelizer_barrier_enter_static(barrier, ref, base, len) \
+  bytelizer_barrier_t _barrier##barrier; \
+  __barrier_enter_##base##_##len(&_barrier##barrier, ref, 0)
+
+/**
+ * @brief enter a barrier with a constant prefix and modifiers
+ * @param barrier the barrier name
+ * @param ref the bytelizer context
+ * @param base the base type without `prefix_`, length_only or withself
+ * @param len the length type without `prefix_`, e.g. uint16be or varint
+ * @param modifiers the modifiers, e.g. prefix_compact
+*/
+#define bytelizer_barrier_enter_static_ex(barrier, ref, base, len, modifiers) \
+  bytelizer_barrier_t _barrier##barrier; \
+  __barrier_enter_##base##_##len(&_barrier##barrier, ref, modifiers)
+
+/**
+ * @brief leave a barrier entered with a constant prefix
+ * @param barrier the barrier name
+ * @param base the same base type as entering
+ * @param len the same length type as entering
+*/
+#define bytelizer_barrier_leave_static(barrier, base, len) \
+  __barrier_leave_##base##_##len(&_barrier##barrier, 0)
+
+#define bytelizer_barrier_leave_offset_static(barrier, offset, base, len) \
+  __barrier_leave_##base##_##len(&_barrier##barrier, offset)
+
+/**
+ * @brief enter a barrier that keeps a running checksum of its body,
+ * the digest is written on leave, leave it as a normal barrier
+ * @param barrier the barrier name
+ * @param ref the bytelizer context
+ * @param prefix the prefix
+ * @param algorithm the algorithm, see @ref bytelizer_checksum_t
+ * @param digest where and how the digest is written, see @ref bytelizer_digest_t
+*/
+#define bytelizer_barrier_enter_checksum(barrier, ref, prefix, algorithm, digest) \
+  bytelizer_barrier_t _barrier##barrier; \
+  __barrier_enter_checksum(&_barrier##barrier, ref, prefix, algorithm, digest)
+
+#define bytelizer_barrier_enter_static_checksum(barrier, ref, base, len, algorithm, digest) \
+  bytelizer_barrier_t _barrier##barrier; \
+  __barrier_enter_checksum_inline(&_barrier##barrier, ref, \
+    prefix_##base, prefix_##len, algorithm, digest)
+
+/**
+ * @brief hash the body written so far while it is still in the cache,
+ * optional, the rest is hashed on leave anyway
+ * @param barrier the barrier name
+*/
+#define bytelizer_barrier_update(barrier) \
+  __barrier_update_checksum(&_barrier##barrier)
+
+/*
+  The barrier stack lives in the context, so barriers can be opened
+  in loops and recursive encoders without naming them:
+
+    bytelizer_barrier_push(ctx, prefix_length_only | prefix_varint);
+      ...
+      bytelizer_barrier_push(ctx, prefix_length_only | prefix_uint8);
+      ...
+      bytelizer_barrier_pop(ctx);
+    bytelizer_barrier_pop(ctx);
+
+  Every level costs one frame in a growing array,
+  the frame is released by bytelizer_destroy/clear.
+*/
+
+#define BYTELIZER_BARRIER_STACK_INIT 8
+
+static bool __barrier_stack_grow(bytelizer_ctx_t* ctx) {
+
+  uint32_t _capacity = ctx->barrier_capacity
+    ? ctx->barrier_capacity * 2
+    : BYTELIZER_BARRIER_STACK_INIT;
+
+  bytelizer_barrier_t* _barriers = (bytelizer_barrier_t *)realloc(ctx->barriers,
+    _capacity * sizeof(bytelizer_barrier_t));
+
+  if(_barriers == NULL) {
+    __bytelizer_log("grow barrier stack failed, is it out of memory?");
+    return false;
+  }
+
+  ctx->barriers = _barriers;
+  ctx->barrier_capacity = _capacity;
+  return true;
+}
+
+_inline static bytelizer_barrier_t* __barrier_stack_push(bytelizer_ctx_t* ctx) {
+
+  if(ctx->barrier_depth == ctx->barrier_capacity && !__barrier_stack_grow(ctx))
+    return NULL;
+
+  return &ctx->barriers[ctx->barrier_depth++];
+}
+
+_inline static bytelizer_barrier_t* __barrier_stack_pop(bytelizer_ctx_t* ctx) {
+
+  if(ctx->barrier_depth == 0) {
+    __bytelizer_log("pop barrier failed, the barrier stack is empty");
+    return NULL;
+  }
+
+  return &ctx->barriers[--ctx->barrier_depth];
+}
+
+/**
+ * @brief open a barrier on the barrier stack of the context
+ * @param ctx the bytelizer context
+ * @param prefix the prefix, the same as @ref bytelizer_barrier_enter
+ * @return false if the barrier can't be entered
+*/
+_inline static bool bytelizer_barrier_push(bytelizer_ctx_t* ctx, bytelizer_prefix_t prefix) {
+
+  bytelizer_barrier_t* _barrier = __barrier_stack_push(ctx);
+  if(_barrier == NULL) return false;
+
+  if(!__barrier_enter(_barrier, ctx, prefix)) {
+    --ctx->barrier_depth;
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief close the innermost barrier of the context and fill its prefix
+ * @param ctx the bytelizer context
+ * @param offset the length to be added to the prefix
+*/
+_inline static bool bytelizer_barrier_pop_offset(bytelizer_ctx_t* ctx, uint32_t offset) {
+
+  bytelizer_barrier_t* _barrier = __barrier_stack_pop(ctx);
+  if(_barrier == NULL) return false;
+
+  return __barrier_leave(_barrier, offset);
+}
+
+#define bytelizer_barrier_pop(ctx) \
+  bytelizer_barrier_pop_offset(ctx, 0)
+
+/**
+ * @brief get the count of the opened barriers on the stack
+ * @param ctx the bytelizer context
+*/
+#define bytelizer_barrier_depth(ctx) ((ctx)->barrier_depth)
+
+// stack variants of the constant prefix barriers
+#define __DEFINE_BARRIER_STACK_SPEC(base, len) \
+  _inline static bool __barrier_push_##base##_##len(bytelizer_ctx_t* ctx) { \
+    bytelizer_barrier_t* _barrier = __barrier_stack_push(ctx); \
+    if(_barrier == NULL) return false; \
+    if(!__barrier_enter_##base##_##len(_barrier, ctx, 0)) { \
+      --ctx->barrier_depth; \
+      return false; \
+    } \
+    return true; \
+  } \
+  _inline static bool __barrier_pop_##base##_##len(bytelizer_ctx_t* ctx) { \
+    bytelizer_barrier_t* _barrier = __barrier_stack_pop(ctx); \
+    return _barrier != NULL && __barrier_leave_##base##_##len(_barrier, 0); \
+  }
+
+__BYTELIZER_PREFIX_SPECS(__DEFINE_BARRIER_STACK_SPEC)
+
+#undef __DEFINE_BARRIER_STACK_SPEC
+
+/**
+ * @brief open a barrier with a constant prefix on the barrier stack
+ * @param ctx the bytelizer context
+ * @param base the base type without `prefix_`, length_only or withself
+ * @param len the length type without `prefix_`, e.g. uint16be or varint
+*/
+#define bytelizer_barrier_push_static(ctx, base, len) \
+  __barrier_push_##base##_##len(ctx)
+
+/**
+ * @brief close the innermost barrier opened with a constant prefix
+ * @param ctx the bytelizer context
+ * @param base the same base type as pushing
+ * @param len the same length type as pushing
+*/
+#define bytelizer_barrier_pop_static(ctx, base, len) \
+  __barrier_pop_##base##_##len(ctx)
+
 #endif /* _BYTELIZER_BARRIER_H */
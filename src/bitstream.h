@@ -0,0 +1,322 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#ifndef _BYTELIZER_BITSTREAM_H
+#define _BYTELIZER_BITSTREAM_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <bytelizer/common.h>
+
+#include "compiler.h"
+#include "codec.h"
+#include "advanced.h"
+#include "bitwise.h"
+#include "debug/log.h"
+
+typedef enum {
+  bitorder_msb_first = 0,
+  bitorder_lsb_first,
+} bytelizer_bitorder_t;
+
+typedef struct {
+  bytelizer_ctx_t* ctx;
+  uint64_t acc;
+  uint32_t bits;
+  bytelizer_bitorder_t order;
+} bytelizer_bitwriter_t;
+
+typedef struct {
+  bytelizer_ctx_t* ctx;
+  const uint8_t* cursor;
+  const uint8_t* end;
+  uint64_t acc;
+  uint32_t bits;
+  bytelizer_bitorder_t order;
+} bytelizer_bitreader_t;
+
+/*
+  Both directions keep the pending bits in a 64-bit accumulator.
+
+  msb first: the first bit goes to the highest bit of the first byte,
+             the writer shifts new fields in from the right and
+             the reader keeps the valid bits left aligned.
+
+  lsb first: the first bit goes to the lowest bit of the first byte,
+             new fields are or-ed above the pending bits.
+
+  A full accumulator is emitted as one uint64 (big endian for msb first,
+  little endian for lsb first), which gives exactly the stream byte order.
+*/
+
+_inline static uint64_t __bits_mask(uint32_t nbits) {
+  return nbits >= 64 ? ~(uint64_t)0 : (((uint64_t)1 << nbits) - 1);
+}
+
+_inline static uint64_t __bits_shl(uint64_t value, uint32_t shift) {
+  return shift >= 64 ? 0 : value << shift;
+}
+
+_inline static uint64_t __bits_shr(uint64_t value, uint32_t shift) {
+  return shift >= 64 ? 0 : value >> shift;
+}
+
+/**
+ * @brief initialize a bit writer on a bytelizer context
+ * @param writer the bit writer
+ * @param ctx the bytelizer context
+ * @param order the bit order, see @ref bytelizer_bitorder_t
+ */
+_inline static void bytelizer_bitwriter_init(bytelizer_bitwriter_t* writer,
+bytelizer_ctx_t* ctx, bytelizer_bitorder_t order) {
+  writer->ctx = ctx;
+  writer->acc = 0;
+  writer->bits = 0;
+  writer->order = order;
+}
+
+_inline static void __bitwriter_spill(bytelizer_bitwriter_t* writer, uint64_t word) {
+  if(writer->order == bitorder_msb_first) {
+    bytelizer_put_uint64_be(writer->ctx, word);
+  }
+  else {
+    bytelizer_put_uint64_le(writer->ctx, word);
+  }
+}
+
+/**
+ * @brief put bits into the bit writer
+ * @param writer the bit writer
+ * @param value the value, only the low nbits are used
+ * @param nbits the bit count, 1 ~ 64
+ */
+_inline static void bytelizer_put_bits(bytelizer_bitwriter_t* writer,
+uint64_t value, uint32_t nbits) {
+
+  if(nbits == 0 || nbits > 64) {
+    __bytelizer_log("wrong bit count %u", nbits);
+    return;
+  }
+
+  value &= __bits_mask(nbits);
+
+  uint32_t _total = writer->bits + nbits;
+
+  if(writer->order == bitorder_msb_first) {
+
+    // fast path, the field still fits in the accumulator
+    if(_total < 64) {
+      writer->acc = (writer->acc << nbits) | value;
+      writer->bits = _total;
+      return;
+    }
+
+    // complete the accumulator with the high part of the field
+    uint32_t _spill = _total - 64;
+    __bitwriter_spill(writer, __bits_shl(writer->acc, 64 - writer->bits) | (value >> _spill));
+
+    writer->acc = value & __bits_mask(_spill);
+    writer->bits = _spill;
+  }
+
+  else {
+
+    writer->acc |= __bits_shl(value, writer->bits);
+
+    if(_total < 64) {
+      writer->bits = _total;
+      return;
+    }
+
+    // keep the bits that did not fit
+    __bitwriter_spill(writer, writer->acc);
+    writer->acc = __bits_shr(value, 64 - writer->bits);
+    writer->bits = _total - 64;
+  }
+}
+
+/**
+ * @brief pad the pending bits with zeros to a byte boundary
+ * @param writer the bit writer
+ */
+_inline static void bytelizer_bitwriter_align(bytelizer_bitwriter_t* writer) {
+
+  uint32_t _pad = (8 - (writer->bits & 7)) & 7;
+  if(_pad > 0) bytelizer_put_bits(writer, 0, _pad);
+}
+
+/**
+ * @brief align and write all pending bytes into the context,
+ * the context can be used directly after flushing.
+ * @param writer the bit writer
+ */
+_inline static void bytelizer_bitwriter_flush(bytelizer_bitwriter_t* writer) {
+
+  bytelizer_bitwriter_align(writer);
+
+  uint32_t _bytes = writer->bits >> 3;
+  if(_bytes == 0) return;
+
+  if(!bytelizer_ensure_available(writer->ctx, _bytes)) {
+    __bytelizer_log("flush bits failed, is it out of memory?");
+    return;
+  }
+
+  for(uint32_t i = 0; i < _bytes; ++i) {
+    writer->ctx->cursor[i] = (writer->order == bitorder_msb_first)
+      ? (uint8_t)(writer->acc >> ((_bytes - 1 - i) << 3))
+      : (uint8_t)(writer->acc >> (i << 3));
+  }
+
+  bytelizer_update_cursor(writer->ctx, _bytes);
+  writer->acc = 0;
+  writer->bits = 0;
+}
+
+/**
+ * @brief initialize a bit reader on an attached context
+ * @param reader the bit reader
+ * @param ctx the bytelizer context
+ * @param order the bit order, see @ref bytelizer_bitorder_t
+ */
+_inline static void bytelizer_bitreader_init(bytelizer_bitreader_t* reader,
+bytelizer_ctx_t* ctx, bytelizer_bitorder_t order) {
+  reader->ctx = ctx;
+  reader->cursor = ctx->cursor;
+  reader->end = ctx->cursor + bytelizer_remain(ctx);
+  reader->acc = 0;
+  reader->bits = 0;
+  reader->order = order;
+}
+
+_inline static void __bitreader_refill(bytelizer_bitreader_t* reader) {
+
+  // load a whole word and take as many bytes as fit,
+  // the extra bits loaded are the next stream bits,
+  // so or-ing them again in the next refill is harmless
+  if(reader->end - reader->cursor >= 8) {
+
+    uint64_t _word;
+    memcpy(&_word, reader->cursor, sizeof(uint64_t));
+
+    if(reader->order == bitorder_msb_first)
+      reader->acc |= bitwise_be64(_word) >> reader->bits;
+    else
+      reader->acc |= __bits_shl(bitwise_le64(_word), reader->bits);
+
+    uint32_t _bytes = (63 - reader->bits) >> 3;
+    reader->cursor += _bytes;
+    reader->bits += _bytes << 3;
+    return;
+  }
+
+  // near the end of the buffer
+  while(reader->bits <= 56 && reader->cursor < reader->end) {
+
+    uint64_t _byte = *reader->cursor++;
+
+    if(reader->order == bitorder_msb_first)
+      reader->acc |= _byte << (56 - reader->bits);
+    else
+      reader->acc |= _byte << reader->bits;
+
+    reader->bits += 8;
+  }
+}
+
+_inline static bool __bitreader_take(bytelizer_bitreader_t* reader,
+uint64_t* value, uint32_t nbits) {
+
+  if(reader->bits < nbits) {
+    __bitreader_refill(reader);
+
+    if(reader->bits < nbits) {
+      __bytelizer_log("bit reader out of range");
+      return false;
+    }
+  }
+
+  if(reader->order == bitorder_msb_first) {
+    *value = reader->acc >> (64 - nbits);
+    reader->acc = __bits_shl(reader->acc, nbits);
+  }
+
+  else {
+    *value = reader->acc & __bits_mask(nbits);
+    reader->acc = __bits_shr(reader->acc, nbits);
+  }
+
+  reader->bits -= nbits;
+  return true;
+}
+
+/**
+ * @brief get bits from the bit reader
+ * @param reader the bit reader
+ * @param value the value
+ * @param nbits the bit count, 1 ~ 64
+ * @return false if the buffer has not enough bits
+ */
+_inline static bool bytelizer_get_bits(bytelizer_bitreader_t* reader,
+uint64_t* value, uint32_t nbits) {
+
+  if(nbits == 0 || nbits > 64) {
+    __bytelizer_log("wrong bit count %u", nbits);
+    return false;
+  }
+
+  // a refill guarantees 57 bits at least
+  if(nbits <= 56)
+    return __bitreader_take(reader, value, nbits);
+
+  uint64_t _first, _second;
+  if(!__bitreader_take(reader, &_first, 32) ||
+     !__bitreader_take(reader, &_second, nbits - 32))
+    return false;
+
+  *value = (reader->order == bitorder_msb_first)
+    ? (_first << (nbits - 32)) | _second
+    : _first | (_second << 32);
+
+  return true;
+}
+
+/**
+ * @brief drop the bits to the next byte boundary
+ * @param reader the bit reader
+ */
+_inline static void bytelizer_bitreader_align(bytelizer_bitreader_t* reader) {
+
+  uint32_t _drop = reader->bits & 7;
+  if(_drop == 0) return;
+
+  uint64_t _unused;
+  __bitreader_take(reader, &_unused, _drop);
+}
+
+/**
+ * @brief align and give the unread bytes back to the context,
+ * the context can be used directly after finishing.
+ * @param reader the bit reader
+ */
+_inline static void bytelizer_bitreader_finish(bytelizer_bitreader_t* reader) {
+
+  bytelizer_bitreader_align(reader);
+
+  // whole bytes left in the accumulator were never consumed
+  uint32_t _consumed = (uint32_t)(reader->cursor - reader->ctx->cursor) - (reader->bits >> 3);
+  bytelizer_update_cursor(reader->ctx, _consumed);
+
+  reader->cursor = reader->ctx->cursor;
+  reader->acc = 0;
+  reader->bits = 0;
+}
+
+#endif /* _BYTELIZER_BITSTREAM_H */
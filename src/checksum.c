@@ -0,0 +1,304 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include <bytelizer/common.h>
+#include "debug/log.h"
+#include "compiler.h"
+#include "bitwise.h"
+#include "simd.h"
+#include "codec.h"
+#include "checksum.h"
+
+typedef uint32_t (* __crc32c_kernel_t)(uint32_t crc, const uint8_t* data, size_t length);
+
+// slicing-by-8 tables, reflected castagnoli polynomial
+static uint32_t __crc32c_table[8][256];
+static pthread_once_t __crc32c_once = PTHREAD_ONCE_INIT;
+static __crc32c_kernel_t __crc32c_kernel = NULL;
+
+static void __crc32c_init_table(void) {
+
+  for(uint32_t i = 0; i < 256; ++i) {
+    uint32_t _crc = i;
+    for(int j = 0; j < 8; ++j)
+      _crc = (_crc >> 1) ^ (0x82f63b78 & (0 - (_crc & 1)));
+    __crc32c_table[0][i] = _crc;
+  }
+
+  for(uint32_t i = 0; i < 256; ++i) {
+    for(int j = 1; j < 8; ++j) {
+      uint32_t _prev = __crc32c_table[j - 1][i];
+      __crc32c_table[j][i] = (_prev >> 8) ^ __crc32c_table[0][_prev & 0xff];
+    }
+  }
+}
+
+static uint32_t __crc32c_scalar(uint32_t crc, const uint8_t* data, size_t length) {
+
+  for(; length >= 8; length -= 8, data += 8) {
+    uint32_t _lo, _hi;
+    memcpy(&_lo, data, 4);
+    memcpy(&_hi, data + 4, 4);
+    _lo = bitwise_le32(_lo) ^ crc;
+    _hi = bitwise_le32(_hi);
+
+    crc = __crc32c_table[7][_lo & 0xff] ^ __crc32c_table[6][(_lo >> 8) & 0xff] ^
+          __crc32c_table[5][(_lo >> 16) & 0xff] ^ __crc32c_table[4][_lo >> 24] ^
+          __crc32c_table[3][_hi & 0xff] ^ __crc32c_table[2][(_hi >> 8) & 0xff] ^
+          __crc32c_table[1][(_hi >> 16) & 0xff] ^ __crc32c_table[0][_hi >> 24];
+  }
+
+  while(length--)
+    crc = (crc >> 8) ^ __crc32c_table[0][(crc ^ *data++) & 0xff];
+
+  return crc;
+}
+
+#if BYTELIZER_SIMD_X86
+
+__simd_target("sse4.2")
+static uint32_t __crc32c_sse42(uint32_t crc, const uint8_t* data, size_t length) {
+
+#if defined(__x86_64__)
+  uint64_t _crc = crc;
+  for(; length >= 8; length -= 8, data += 8) {
+    uint64_t _value; memcpy(&_value, data, 8);
+    _crc = _mm_crc32_u64(_crc, _value);
+  }
+  crc = (uint32_t)_crc;
+#endif
+
+  for(; length >= 4; length -= 4, data += 4) {
+    uint32_t _value; memcpy(&_value, data, 4);
+    crc = _mm_crc32_u32(crc, _value);
+  }
+
+  while(length--)
+    crc = _mm_crc32_u8(crc, *data++);
+
+  return crc;
+}
+
+#endif /* BYTELIZER_SIMD_X86 */
+
+// build the tables and pick the kernel, once for every thread
+static void __crc32c_init(void) {
+
+  __crc32c_init_table();
+  __crc32c_kernel = __crc32c_scalar;
+
+#if BYTELIZER_SIMD_X86
+  if(bytelizer_simd_has(simd_feature_sse42)) __crc32c_kernel = __crc32c_sse42;
+#endif
+}
+
+uint32_t bytelizer_crc32c(uint32_t crc, const uint8_t* data, size_t length) {
+
+  if(data == NULL || length == 0)
+    return crc;
+
+  pthread_once(&__crc32c_once, __crc32c_init);
+  return ~__crc32c_kernel(~crc, data, length);
+}
+
+#define XXH_PRIME1 0x9e3779b1u
+#define XXH_PRIME2 0x85ebca77u
+#define XXH_PRIME3 0xc2b2ae3du
+#define XXH_PRIME4 0x27d4eb2fu
+#define XXH_PRIME5 0x165667b1u
+
+_inline static uint32_t __rotl32(uint32_t value, uint32_t shift) {
+  return (value << shift) | (value >> (32 - shift));
+}
+
+_inline static uint32_t __read32(const uint8_t* data) {
+  uint32_t _value; memcpy(&_value, data, 4);
+  return bitwise_le32(_value);
+}
+
+_inline static uint32_t __xxh32_round(uint32_t acc, uint32_t input) {
+  acc += input * XXH_PRIME2;
+  acc = __rotl32(acc, 13);
+  return acc * XXH_PRIME1;
+}
+
+void bytelizer_xxh32_init(bytelizer_xxh32_t* state, uint32_t seed) {
+  memset(state, 0, sizeof(bytelizer_xxh32_t));
+  state->seed = seed;
+  state->v[0] = seed + XXH_PRIME1 + XXH_PRIME2;
+  state->v[1] = seed + XXH_PRIME2;
+  state->v[2] = seed;
+  state->v[3] = seed - XXH_PRIME1;
+}
+
+void bytelizer_xxh32_update(bytelizer_xxh32_t* state, const uint8_t* data, size_t length) {
+
+  if(data == NULL || length == 0)
+    return;
+
+  // the total wraps like the reference, a long input is kept by the flag
+  state->total += (uint32_t)length;
+  state->large |= (length >= 16) | (state->total >= 16);
+
+  // not enough for a stripe yet
+  if(state->memsize + length < 16) {
+    memcpy(state->mem + state->memsize, data, length);
+    state->memsize += (uint32_t)length;
+    return;
+  }
+
+  // complete the pending stripe
+  if(state->memsize > 0) {
+    uint32_t _fill = 16 - state->memsize;
+    memcpy(state->mem + state->memsize, data, _fill);
+    for(int i = 0; i < 4; ++i)
+      state->v[i] = __xxh32_round(state->v[i], __read32(state->mem + i * 4));
+    data += _fill;
+    length -= _fill;
+    state->memsize = 0;
+  }
+
+  uint32_t _v0 = state->v[0], _v1 = state->v[1];
+  uint32_t _v2 = state->v[2], _v3 = state->v[3];
+
+  for(; length >= 16; length -= 16, data += 16) {
+    _v0 = __xxh32_round(_v0, __read32(data));
+    _v1 = __xxh32_round(_v1, __read32(data + 4));
+    _v2 = __xxh32_round(_v2, __read32(data + 8));
+    _v3 = __xxh32_round(_v3, __read32(data + 12));
+  }
+
+  state->v[0] = _v0; state->v[1] = _v1;
+  state->v[2] = _v2; state->v[3] = _v3;
+
+  if(length > 0) {
+    memcpy(state->mem, data, length);
+    state->memsize = (uint32_t)length;
+  }
+}
+
+uint32_t bytelizer_xxh32_digest(const bytelizer_xxh32_t* state) {
+
+  uint32_t _hash;
+
+  if(state->large) {
+    _hash = __rotl32(state->v[0], 1) + __rotl32(state->v[1], 7) +
+            __rotl32(state->v[2], 12) + __rotl32(state->v[3], 18);
+  }
+  else {
+    _hash = state->seed + XXH_PRIME5;
+  }
+
+  _hash += state->total;
+
+  const uint8_t* _p = state->mem;
+  const uint8_t* _end = state->mem + state->memsize;
+
+  for(; _p + 4 <= _end; _p += 4) {
+    _hash += __read32(_p) * XXH_PRIME3;
+    _hash = __rotl32(_hash, 17) * XXH_PRIME4;
+  }
+
+  for(; _p < _end; ++_p) {
+    _hash += (*_p) * XXH_PRIME5;
+    _hash = __rotl32(_hash, 11) * XXH_PRIME1;
+  }
+
+  _hash ^= _hash >> 15;
+  _hash *= XXH_PRIME2;
+  _hash ^= _hash >> 13;
+  _hash *= XXH_PRIME3;
+  _hash ^= _hash >> 16;
+
+  return _hash;
+}
+
+uint32_t bytelizer_xxh32(const uint8_t* data, size_t length, uint32_t seed) {
+  bytelizer_xxh32_t _state;
+  bytelizer_xxh32_init(&_state, seed);
+  bytelizer_xxh32_update(&_state, data, length);
+  return bytelizer_xxh32_digest(&_state);
+}
+
+void bytelizer_hash_init(bytelizer_hash_t* hash, bytelizer_checksum_t algorithm) {
+
+  hash->algorithm = algorithm;
+
+  switch(algorithm) {
+    case checksum_crc32c:
+      hash->crc = 0;
+      break;
+
+    case checksum_xxh32:
+      bytelizer_xxh32_init(&hash->xxh, 0);
+      break;
+
+    default:
+      break;
+  }
+}
+
+void bytelizer_hash_update(bytelizer_hash_t* hash, const uint8_t* data, size_t length) {
+
+  switch(hash->algorithm) {
+    case checksum_crc32c:
+      hash->crc = bytelizer_crc32c(hash->crc, data, length);
+      break;
+
+    case checksum_xxh32:
+      bytelizer_xxh32_update(&hash->xxh, data, length);
+      break;
+
+    default:
+      break;
+  }
+}
+
+uint32_t bytelizer_hash_digest(const bytelizer_hash_t* hash) {
+
+  switch(hash->algorithm) {
+    case checksum_crc32c:
+      return hash->crc;
+
+    case checksum_xxh32:
+      return bytelizer_xxh32_digest(&hash->xxh);
+
+    default:
+      return 0;
+  }
+}
+
+uint32_t bytelizer_checksum(bytelizer_ctx_t* ctx, bytelizer_checksum_t algorithm) {
+
+  bytelizer_hash_t _hash;
+  bytelizer_hash_init(&_hash, algorithm);
+
+  // hash stack first
+  bytelizer_hash_update(&_hash, ctx->stack, ctx->stack_wrotes);
+
+  // then the block buffers
+  if(ctx->blocks != NULL) {
+
+    bytelizer_list_node_t* _node = ctx->blocks->head;
+    while(_node != NULL) {
+
+      bytelizer_block_t* _block = *(bytelizer_block_t **)_node->data;
+      bytelizer_hash_update(&_hash, (uint8_t *)_block + sizeof(bytelizer_block_t), _block->wrotes);
+
+      _node = _node->next;
+    }
+  }
+
+  return bytelizer_hash_digest(&_hash);
+}
@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#ifndef _BYTELIZER_CHECKSUM_H
+#define _BYTELIZER_CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <bytelizer/common.h>
+#include "codec.h"
+
+typedef enum {
+  checksum_none = 0,
+  checksum_crc32c,
+  checksum_xxh32,
+} bytelizer_checksum_t;
+
+typedef struct {
+  uint32_t v[4];
+  // the total length modulo 2^32, large once it reaches a stripe
+  uint32_t total;
+  uint32_t large;
+  uint32_t seed;
+  uint8_t mem[16];
+  uint32_t memsize;
+} bytelizer_xxh32_t;
+
+typedef struct {
+  bytelizer_checksum_t algorithm;
+  union {
+    uint32_t crc;
+    bytelizer_xxh32_t xxh;
+  };
+} bytelizer_hash_t;
+
+/**
+ * @brief update a crc32c (castagnoli), hardware accelerated with sse4.2
+ * @param crc the previous result, 0 for the first call
+ * @param data the data
+ * @param length the length of the data
+ * @return the crc32c of all the data so far
+ */
+uint32_t bytelizer_crc32c(uint32_t crc, const uint8_t* data, size_t length);
+
+/**
+ * @brief initialize a streaming xxh32 state
+ * @param state the xxh32 state
+ * @param seed the seed
+ */
+void bytelizer_xxh32_init(bytelizer_xxh32_t* state, uint32_t seed);
+
+/**
+ * @brief feed data into a streaming xxh32 state
+ * @param state the xxh32 state
+ * @param data the data
+ * @param length the length of the data
+ */
+void bytelizer_xxh32_update(bytelizer_xxh32_t* state, const uint8_t* data, size_t length);
+
+/**
+ * @brief get the xxh32 digest, the state is not modified
+ * @param state the xxh32 state
+ */
+uint32_t bytelizer_xxh32_digest(const bytelizer_xxh32_t* state);
+
+/**
+ * @brief one-shot xxh32
+ * @param data the data
+ * @param length the length of the data
+ * @param seed the seed
+ */
+uint32_t bytelizer_xxh32(const uint8_t* data, size_t length, uint32_t seed);
+
+/**
+ * @brief initialize a hash of any algorithm, xxh32 uses seed 0
+ * @param hash the hash state
+ * @param algorithm the algorithm, see @ref bytelizer_checksum_t
+ */
+void bytelizer_hash_init(bytelizer_hash_t* hash, bytelizer_checksum_t algorithm);
+
+/**
+ * @brief feed data into a hash
+ * @param hash the hash state
+ * @param data the data
+ * @param length the length of the data
+ */
+void bytelizer_hash_update(bytelizer_hash_t* hash, const uint8_t* data, size_t length);
+
+/**
+ * @brief get the digest of a hash
+ * @param hash the hash state
+ */
+uint32_t bytelizer_hash_digest(const bytelizer_hash_t* hash);
+
+/**
+ * @brief hash all the bytes of a context, block by block
+ * @param ctx the bytelizer context
+ * @param algorithm the algorithm, see @ref bytelizer_checksum_t
+ */
+uint32_t bytelizer_checksum(bytelizer_ctx_t* ctx, bytelizer_checksum_t algorithm);
+
+#endif /* _BYTELIZER_CHECKSUM_H */
@@ -222,6 +222,9 @@ uint32_t bytelizer_copy_to(void* userdata, bytelizer_ctx_t* ctx, bytelizer_callb
 
 void bytelizer_destroy_unsafe(bytelizer_ctx_t* ctx) {
 
+  // the barrier stack
+  free(ctx->barriers);
+
   if(ctx->blocks == NULL) return;
 
   bytelizer_list_node_t* _node = ctx->blocks->head;
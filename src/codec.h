@@ -24,6 +24,8 @@ typedef struct _bytelizer_block_t {
   // it's minimal length has been defined in BYTELIZER_REALLOC
 } bytelizer_block_t;
 
+struct _bytelizer_barrier_t;
+
 typedef struct _bytelizer_ctx_t {
   uint32_t total_length;
   uint8_t* stack;
@@ -32,6 +34,11 @@ typedef struct _bytelizer_ctx_t {
   bytelizer_list_ctx_t* blocks;
   uint8_t* cursor;
   uint32_t* counter;
+
+  // the barrier stack, created on the first push
+  struct _bytelizer_barrier_t* barriers;
+  uint32_t barrier_depth;
+  uint32_t barrier_capacity;
 } bytelizer_ctx_t;
 
 typedef void (* bytelizer_callback_copy_t)(void* userdata, uint8_t* buffer, size_t length);
@@ -60,16 +67,27 @@ typedef void (* bytelizer_callback_copy_t)(void* userdata, uint8_t* buffer, size
 #define bytelizer_alloc(ctx, size) { bytelizer_alloc_unsafe(ctx, size)
 
 /**
- * @brief release heap blocks and clean without pairing
+ * @brief release heap blocks and rewind without pairing,
+ * the stack is not cleared, it is overwritten by the next puts
  * @param ctx the bytelizer context
  */
-#define bytelizer_clear_unsafe(ctx) \
+#define bytelizer_reset_unsafe(ctx) \
     bytelizer_destroy_unsafe(ctx); \
     ctx->stack_wrotes = 0; \
     ctx->total_length = 0; \
     ctx->blocks = NULL; \
+    ctx->barriers = NULL; \
+    ctx->barrier_depth = 0; \
+    ctx->barrier_capacity = 0; \
     ctx->cursor = ctx->stack; \
     ctx->counter = &ctx->stack_wrotes; \
+
+/**
+ * @brief release heap blocks and clean without pairing
+ * @param ctx the bytelizer context
+ */
+#define bytelizer_clear_unsafe(ctx) \
+    bytelizer_reset_unsafe(ctx) \
     memset(ctx->stack, 0, ctx->stack_length); \
 
 /**
@@ -111,6 +129,9 @@ typedef void (* bytelizer_callback_copy_t)(void* userdata, uint8_t* buffer, size
     ctx->stack_wrotes = 0; \
     ctx->total_length = 0; \
     ctx->blocks = NULL; \
+    ctx->barriers = NULL; \
+    ctx->barrier_depth = 0; \
+    ctx->barrier_capacity = 0; \
     ctx->cursor = ctx->stack; \
     ctx->counter = &ctx->stack_wrotes; \
     memset(ctx->stack, 0, ctx->stack_length); \
@@ -127,6 +148,13 @@ typedef void (* bytelizer_callback_copy_t)(void* userdata, uint8_t* buffer, size
  */
 #define bytelizer_length(ctx) (ctx->total_length)
 
+/**
+ * @brief get the readable length left in an attached buffer
+ * @param ctx the bytelizer context
+ */
+#define bytelizer_remain(ctx) \
+  ((uint32_t)(ctx->stack + ctx->stack_length - ctx->cursor))
+
 #define bytelizer_update_cursor(ctx, size) { \
   ctx->cursor += size; \
   ctx->total_length += size; \
@@ -35,4 +35,13 @@
   #define _inline
 #endif /* BYTELIZER_INLINE_FUNCTIONS */
 
+/**
+ * @brief the parameter may be unused
+ */
+#if defined(__GNUC__) || defined(__clang__)
+  #define _maybe_unused __attribute__((unused))
+#else
+  #define _maybe_unused
+#endif
+
 #endif /* _BYTELIZER_COMPILER_H */
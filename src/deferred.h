@@ -0,0 +1,222 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#ifndef _BYTELIZER_DEFERRED_H
+#define _BYTELIZER_DEFERRED_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <bytelizer/common.h>
+
+#include "compiler.h"
+#include "codec.h"
+#include "anchor.h"
+#include "bitwise.h"
+#include "debug/log.h"
+
+/*
+  A deferred field reserves a zeroed slot and is filled later by handle,
+  e.g. an element count known after the elements:
+
+    bytelizer_deferred_t count;
+    bytelizer_defer_uint16_be(ctx, &count);
+    for(...) { ...; ++n; }
+    bytelizer_fill(&count, n);
+
+  The slot keeps pointing to its block, so it can be filled
+  after the context has spilled into new heap blocks.
+  Positions are stream offsets from the beginning of the context.
+*/
+
+typedef struct {
+  bytelizer_anchor_t anchor;
+  uint32_t width;
+  bool big_endian;
+} bytelizer_deferred_t;
+
+/**
+ * @brief get the stream offset of the cursor
+ * @param ctx the bytelizer context
+ */
+#define bytelizer_offset(ctx) ((ctx)->total_length)
+
+/**
+ * @brief get the stream offset of a deferred slot
+ * @param deferred the deferred field
+ */
+#define bytelizer_deferred_offset(deferred) ((deferred)->anchor.userdata)
+
+/**
+ * @brief reserve a deferred slot
+ * @param ctx the bytelizer context
+ * @param deferred the deferred field
+ * @param width the slot width, 1, 2, 4 or 8
+ * @param big_endian the byte order of the value
+ */
+_inline static bool bytelizer_defer(bytelizer_ctx_t* ctx,
+bytelizer_deferred_t* deferred, uint32_t width, bool big_endian) {
+
+  if(width != 1 && width != 2 && width != 4 && width != 8) {
+    __bytelizer_log("wrong deferred width %u", width);
+    return false;
+  }
+
+  if(!bytelizer_mark_anchor(&deferred->anchor, ctx, ctx->total_length, width))
+    return false;
+
+  // a reused buffer may hold old data
+  memset(bytelizer_anchor_cursor(&deferred->anchor), 0, width);
+
+  deferred->width = width;
+  deferred->big_endian = big_endian;
+  return true;
+}
+
+/**
+ * @brief fill a deferred slot
+ * @param deferred the deferred field
+ * @param value the value
+ * @return false if the value does not fit the slot, nothing is written
+ */
+_inline static bool bytelizer_fill(bytelizer_deferred_t* deferred, uint64_t value) {
+
+  uint8_t* _cursor = bytelizer_anchor_cursor(&deferred->anchor);
+
+  switch(deferred->width) {
+    case sizeof(uint8_t): {
+      if(value > UINT8_MAX) break;
+      *_cursor = (uint8_t)value;
+      return true;
+    }
+
+    case sizeof(uint16_t): {
+      if(value > UINT16_MAX) break;
+      uint16_t _value = deferred->big_endian
+        ? bitwise_be16((uint16_t)value) : bitwise_le16((uint16_t)value);
+      memcpy(_cursor, &_value, sizeof(uint16_t));
+      return true;
+    }
+
+    case sizeof(uint32_t): {
+      if(value > UINT32_MAX) break;
+      uint32_t _value = deferred->big_endian
+        ? bitwise_be32((uint32_t)value) : bitwise_le32((uint32_t)value);
+      memcpy(_cursor, &_value, sizeof(uint32_t));
+      return true;
+    }
+
+    case sizeof(uint64_t): {
+      uint64_t _value = deferred->big_endian
+        ? bitwise_be64(value) : bitwise_le64(value);
+      memcpy(_cursor, &_value, sizeof(uint64_t));
+      return true;
+    }
+
+    default:
+      break;
+  }
+
+  __bytelizer_log("deferred value %llu does not fit %u bytes",
+    (unsigned long long)value, deferred->width);
+  return false;
+}
+
+/**
+ * @brief read back the value of a deferred slot
+ * @param deferred the deferred field
+ */
+_inline static uint64_t bytelizer_deferred_value(bytelizer_deferred_t* deferred) {
+
+  uint8_t* _cursor = bytelizer_anchor_cursor(&deferred->anchor);
+
+  switch(deferred->width) {
+    case sizeof(uint8_t):
+      return *_cursor;
+
+    case sizeof(uint16_t): {
+      uint16_t _value; memcpy(&_value, _cursor, sizeof(uint16_t));
+      return deferred->big_endian ? bitwise_be16(_value) : bitwise_le16(_value);
+    }
+
+    case sizeof(uint32_t): {
+      uint32_t _value; memcpy(&_value, _cursor, sizeof(uint32_t));
+      return deferred->big_endian ? bitwise_be32(_value) : bitwise_le32(_value);
+    }
+
+    case sizeof(uint64_t): {
+      uint64_t _value; memcpy(&_value, _cursor, sizeof(uint64_t));
+      return deferred->big_endian ? bitwise_be64(_value) : bitwise_le64(_value);
+    }
+
+    default:
+      return 0;
+  }
+}
+
+/**
+ * @brief merge bits into a deferred slot, e.g. a flag bitmap
+ * @param deferred the deferred field
+ * @param bits the bits to be set
+ */
+_inline static bool bytelizer_fill_or(bytelizer_deferred_t* deferred, uint64_t bits) {
+  return bytelizer_fill(deferred, bytelizer_deferred_value(deferred) | bits);
+}
+
+/**
+ * @brief fill a deferred slot with the distance between two stream offsets
+ * @param deferred the deferred field
+ * @param origin the offset the distance is counted from
+ * @param target the offset to be pointed to, not before the origin
+ */
+_inline static bool bytelizer_fill_offset_of(bytelizer_deferred_t* deferred,
+uint32_t origin, uint32_t target) {
+
+  if(target < origin) {
+    __bytelizer_log("offset target %u is before the origin %u", target, origin);
+    return false;
+  }
+
+  return bytelizer_fill(deferred, target - origin);
+}
+
+/**
+ * @brief fill a deferred slot with the stream offset of the cursor
+ * @param deferred the deferred field
+ * @param ctx the bytelizer context
+ */
+#define bytelizer_fill_position(deferred, ctx) \
+  bytelizer_fill(deferred, bytelizer_offset(ctx))
+
+/**
+ * @brief fill a deferred slot with the distance from the end of the slot
+ * to the cursor, the usual relative offset to a following section
+ * @param deferred the deferred field
+ * @param ctx the bytelizer context
+ */
+#define bytelizer_fill_relative(deferred, ctx) \
+  bytelizer_fill_offset_of(deferred, \
+    bytelizer_deferred_offset(deferred) + (deferred)->width, bytelizer_offset(ctx))
+
+#define __DEFINE_DEFER(type, width) \
+  _inline static bool bytelizer_defer_##type##_le(bytelizer_ctx_t* ctx, bytelizer_deferred_t* deferred) { \
+    return bytelizer_defer(ctx, deferred, width, false); \
+  } \
+  _inline static bool bytelizer_defer_##type##_be(bytelizer_ctx_t* ctx, bytelizer_deferred_t* deferred) { \
+    return bytelizer_defer(ctx, deferred, width, true); \
+  }
+
+__DEFINE_DEFER(uint8, sizeof(uint8_t))
+__DEFINE_DEFER(uint16, sizeof(uint16_t))
+__DEFINE_DEFER(uint32, sizeof(uint32_t))
+__DEFINE_DEFER(uint64, sizeof(uint64_t))
+
+#undef __DEFINE_DEFER
+
+#endif /* _BYTELIZER_DEFERRED_H */
@@ -0,0 +1,525 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <bytelizer/common.h>
+#include "compiler.h"
+#include "debug/log.h"
+#include "simd.h"
+#include "codec.h"
+#include "encoding.h"
+
+static const char* __hex_alphabet[2] = {
+  "0123456789ABCDEF",
+  "0123456789abcdef",
+};
+
+static const char* __base64_alphabet[2] = {
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/",
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_",
+};
+
+// -1 marks the invalid characters
+static const int8_t __hex_table[256] = {
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+   0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+  -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+static const int8_t __base64_table[2][256] = {
+  {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,
+    -1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+    -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  },
+  {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,
+    -1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, 63,
+    -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  },
+};
+
+/* ================================================================
+ *  SCALAR KERNELS
+ * ================================================================ */
+
+static void __hex_encode_scalar(char* dst, const uint8_t* src,
+size_t length, const char* alphabet) {
+
+  for(size_t i = 0; i < length; ++i) {
+    dst[i << 1] = alphabet[src[i] >> 4];
+    dst[(i << 1) + 1] = alphabet[src[i] & 0x0F];
+  }
+}
+
+static bool __hex_decode_scalar(uint8_t* dst, const char* src,
+size_t length, bool validate) {
+
+  int8_t _invalid = 0;
+
+  for(size_t i = 0; i < length; ++i) {
+    int8_t _hi = __hex_table[(uint8_t)src[i << 1]];
+    int8_t _lo = __hex_table[(uint8_t)src[(i << 1) + 1]];
+
+    // the invalid entries are negative, collect the sign bits
+    _invalid |= _hi | _lo;
+    dst[i] = (uint8_t)(((uint8_t)_hi << 4) | (_lo & 0x0F));
+  }
+
+  return !validate || _invalid >= 0;
+}
+
+static void __base64_encode_scalar(char* dst, const uint8_t* src,
+size_t length, const char* alphabet) {
+
+  for(size_t i = 0; i < length; i += 3, src += 3, dst += 4) {
+    uint32_t _triple = ((uint32_t)src[0] << 16) | ((uint32_t)src[1] << 8) | src[2];
+    dst[0] = alphabet[(_triple >> 18) & 0x3F];
+    dst[1] = alphabet[(_triple >> 12) & 0x3F];
+    dst[2] = alphabet[(_triple >> 6) & 0x3F];
+    dst[3] = alphabet[_triple & 0x3F];
+  }
+}
+
+static bool __base64_decode_scalar(uint8_t* dst, const char* src,
+size_t quads, const int8_t* table, bool validate) {
+
+  int32_t _invalid = 0;
+
+  for(size_t i = 0; i < quads; ++i, src += 4, dst += 3) {
+    int32_t _a = table[(uint8_t)src[0]], _b = table[(uint8_t)src[1]];
+    int32_t _c = table[(uint8_t)src[2]], _d = table[(uint8_t)src[3]];
+
+    _invalid |= _a | _b | _c | _d;
+    uint32_t _triple = ((uint32_t)_a << 18) | ((uint32_t)_b << 12) | ((uint32_t)_c << 6) | (uint32_t)_d;
+    dst[0] = (uint8_t)(_triple >> 16);
+    dst[1] = (uint8_t)(_triple >> 8);
+    dst[2] = (uint8_t)_triple;
+  }
+
+  return !validate || _invalid >= 0;
+}
+
+/* ================================================================
+ *  SSSE3 KERNELS
+ * ================================================================ */
+
+#if BYTELIZER_SIMD_X86
+
+/*
+  Each kernel processes the whole vectors and returns the input
+  length it has consumed, the scalar kernels finish the tail.
+*/
+
+__simd_target("ssse3")
+static size_t __hex_encode_ssse3(char* dst, const uint8_t* src,
+size_t length, const char* alphabet) {
+
+  size_t i = 0;
+  __m128i _lut = _mm_loadu_si128((const __m128i *)alphabet);
+  __m128i _nibble = _mm_set1_epi8(0x0F);
+
+  for(; i + 16 <= length; i += 16, dst += 32) {
+    __m128i _value = _mm_loadu_si128((const __m128i *)(src + i));
+    __m128i _hi = _mm_shuffle_epi8(_lut, _mm_and_si128(_mm_srli_epi16(_value, 4), _nibble));
+    __m128i _lo = _mm_shuffle_epi8(_lut, _mm_and_si128(_value, _nibble));
+
+    // interleave, the high nibble comes first
+    _mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi8(_hi, _lo));
+    _mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi8(_hi, _lo));
+  }
+
+  return i;
+}
+
+__simd_target("ssse3")
+_inline static __m128i __hex_translate_ssse3(__m128i chars, __m128i* invalid) {
+
+  // signed compares, the non-ascii bytes are negative and never match
+  __m128i _digit = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)),
+                                 _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), chars));
+
+  // fold 'A'-'F' into 'a'-'f'
+  __m128i _lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+  __m128i _alpha = _mm_and_si128(_mm_cmpgt_epi8(_lower, _mm_set1_epi8('a' - 1)),
+                                 _mm_cmpgt_epi8(_mm_set1_epi8('f' + 1), _lower));
+
+  *invalid = _mm_or_si128(*invalid, _mm_andnot_si128(_mm_or_si128(_digit, _alpha), _mm_set1_epi8(-1)));
+
+  return _mm_or_si128(
+    _mm_and_si128(_digit, _mm_sub_epi8(chars, _mm_set1_epi8('0'))),
+    _mm_and_si128(_alpha, _mm_sub_epi8(_lower, _mm_set1_epi8('a' - 10))));
+}
+
+__simd_target("ssse3")
+static size_t __hex_decode_ssse3(uint8_t* dst, const char* src,
+size_t length, bool* valid) {
+
+  size_t i = 0;
+  __m128i _invalid = _mm_setzero_si128();
+  __m128i _weight = _mm_set1_epi16(0x0110);
+
+  for(; i + 16 <= length; i += 16, src += 32) {
+    __m128i _v0 = __hex_translate_ssse3(_mm_loadu_si128((const __m128i *)src), &_invalid);
+    __m128i _v1 = __hex_translate_ssse3(_mm_loadu_si128((const __m128i *)(src + 16)), &_invalid);
+
+    // hi * 16 + lo for every pair, then narrow to bytes
+    _v0 = _mm_maddubs_epi16(_v0, _weight);
+    _v1 = _mm_maddubs_epi16(_v1, _weight);
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(_v0, _v1));
+  }
+
+  *valid = _mm_movemask_epi8(_invalid) == 0;
+  return i;
+}
+
+/*
+  The base64 kernels follow Wojciech Mula's ssse3 layout:
+  12 bytes are spread into 16 lanes of 6 bits by a shuffle and
+  two multiplies, the lanes are then translated by range offsets,
+  so both alphabets share the same code.
+*/
+
+__simd_target("ssse3")
+static size_t __base64_encode_ssse3(char* dst, const uint8_t* src,
+size_t length, const char* alphabet) {
+
+  size_t i = 0;
+
+  // offsets added on top of 'A' by the ranges of the index
+  int8_t _c62 = (int8_t)alphabet[62], _c63 = (int8_t)alphabet[63];
+  __m128i _d26 = _mm_set1_epi8('a' - 26 - 'A');
+  __m128i _d52 = _mm_set1_epi8(('0' - 52) - ('a' - 26));
+  __m128i _d62 = _mm_set1_epi8((int8_t)((_c62 - 62) - ('0' - 52)));
+  __m128i _d63 = _mm_set1_epi8((int8_t)((_c63 - 63) - (_c62 - 62)));
+
+  // the load reads 16 bytes and uses 12 of them
+  for(; i + 16 <= length; i += 12, dst += 16) {
+    __m128i _in = _mm_loadu_si128((const __m128i *)(src + i));
+    _in = _mm_shuffle_epi8(_in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+
+    __m128i _t0 = _mm_mulhi_epu16(_mm_and_si128(_in, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+    __m128i _t1 = _mm_mullo_epi16(_mm_and_si128(_in, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+    __m128i _index = _mm_or_si128(_t0, _t1);
+
+    __m128i _out = _mm_add_epi8(_index, _mm_set1_epi8('A'));
+    _out = _mm_add_epi8(_out, _mm_and_si128(_mm_cmpgt_epi8(_index, _mm_set1_epi8(25)), _d26));
+    _out = _mm_add_epi8(_out, _mm_and_si128(_mm_cmpgt_epi8(_index, _mm_set1_epi8(51)), _d52));
+    _out = _mm_add_epi8(_out, _mm_and_si128(_mm_cmpgt_epi8(_index, _mm_set1_epi8(61)), _d62));
+    _out = _mm_add_epi8(_out, _mm_and_si128(_mm_cmpgt_epi8(_index, _mm_set1_epi8(62)), _d63));
+
+    _mm_storeu_si128((__m128i *)dst, _out);
+  }
+
+  return i;
+}
+
+__simd_target("ssse3")
+static size_t __base64_decode_ssse3(uint8_t* dst, const char* src,
+size_t length, const char* alphabet, bool* valid) {
+
+  size_t i = 0;
+  __m128i _invalid = _mm_setzero_si128();
+  __m128i _c62 = _mm_set1_epi8(alphabet[62]);
+  __m128i _c63 = _mm_set1_epi8(alphabet[63]);
+
+  // the store writes 16 bytes and keeps 12 of them,
+  // leave at least 4 output bytes behind for the scalar tail
+  for(; i + 24 <= length; i += 16, dst += 12) {
+    __m128i _in = _mm_loadu_si128((const __m128i *)(src + i));
+
+    __m128i _upper = _mm_and_si128(_mm_cmpgt_epi8(_in, _mm_set1_epi8('A' - 1)),
+                                   _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), _in));
+    __m128i _lower = _mm_and_si128(_mm_cmpgt_epi8(_in, _mm_set1_epi8('a' - 1)),
+                                   _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), _in));
+    __m128i _digit = _mm_and_si128(_mm_cmpgt_epi8(_in, _mm_set1_epi8('0' - 1)),
+                                   _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), _in));
+    __m128i _is62 = _mm_cmpeq_epi8(_in, _c62);
+    __m128i _is63 = _mm_cmpeq_epi8(_in, _c63);
+
+    __m128i _value = _mm_and_si128(_upper, _mm_sub_epi8(_in, _mm_set1_epi8('A')));
+    _value = _mm_or_si128(_value, _mm_and_si128(_lower, _mm_sub_epi8(_in, _mm_set1_epi8('a' - 26))));
+    _value = _mm_or_si128(_value, _mm_and_si128(_digit, _mm_add_epi8(_in, _mm_set1_epi8(52 - '0'))));
+    _value = _mm_or_si128(_value, _mm_and_si128(_is62, _mm_set1_epi8(62)));
+    _value = _mm_or_si128(_value, _mm_and_si128(_is63, _mm_set1_epi8(63)));
+
+    __m128i _matched = _mm_or_si128(_mm_or_si128(_upper, _lower), _mm_or_si128(_digit, _mm_or_si128(_is62, _is63)));
+    _invalid = _mm_or_si128(_invalid, _mm_andnot_si128(_matched, _mm_set1_epi8(-1)));
+
+    // merge 4 x 6 bits into 24 bits per dword, then squeeze out the gaps
+    _value = _mm_maddubs_epi16(_value, _mm_set1_epi32(0x01400140));
+    _value = _mm_madd_epi16(_value, _mm_set1_epi32(0x00011000));
+    _value = _mm_shuffle_epi8(_value, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+    _mm_storeu_si128((__m128i *)dst, _value);
+  }
+
+  *valid = _mm_movemask_epi8(_invalid) == 0;
+  return i;
+}
+
+#endif /* BYTELIZER_SIMD_X86 */
+
+/* ================================================================
+ *  DISPATCH
+ * ================================================================ */
+
+#if BYTELIZER_SIMD_X86
+  #define __has_ssse3() bytelizer_simd_has(simd_feature_ssse3)
+#else
+  #define __has_ssse3() false
+#endif
+
+void bytelizer_hex_encode(char* dst, const uint8_t* src,
+size_t length, bytelizer_hexcase_t hexcase) {
+
+  size_t _done = 0;
+  const char* _alphabet = __hex_alphabet[hexcase == hexcase_lower];
+
+#if BYTELIZER_SIMD_X86
+  if(__has_ssse3())
+    _done = __hex_encode_ssse3(dst, src, length, _alphabet);
+#endif
+
+  __hex_encode_scalar(dst + (_done << 1), src + _done, length - _done, _alphabet);
+}
+
+bool bytelizer_hex_decode(uint8_t* dst, const char* src,
+size_t length, bool validate) {
+
+  if(length & 1) {
+    __bytelizer_log("odd length of hex string %zu", length);
+    return false;
+  }
+
+  size_t _done = 0;
+  bool _valid = true;
+  length >>= 1;
+
+#if BYTELIZER_SIMD_X86
+  if(__has_ssse3())
+    _done = __hex_decode_ssse3(dst, src, length, &_valid);
+#endif
+
+  if(!__hex_decode_scalar(dst + _done, src + (_done << 1), length - _done, validate))
+    _valid = false;
+
+  return !validate || _valid;
+}
+
+size_t bytelizer_base64_encode(char* dst, const uint8_t* src,
+size_t length, bytelizer_base64_t alphabet) {
+
+  size_t _done = 0;
+  const char* _alphabet = __base64_alphabet[alphabet == base64_urlsafe];
+
+#if BYTELIZER_SIMD_X86
+  if(__has_ssse3())
+    _done = __base64_encode_ssse3(dst, src, length, _alphabet);
+#endif
+
+  // whole triples
+  size_t _tail = (length - _done) % 3;
+  __base64_encode_scalar(dst + _done / 3 * 4, src + _done, length - _done - _tail, _alphabet);
+
+  char* _out = dst + (length - _tail) / 3 * 4;
+  const uint8_t* _in = src + length - _tail;
+
+  // the last one or two bytes
+  if(_tail > 0) {
+    uint32_t _triple = ((uint32_t)_in[0] << 16) | (_tail > 1 ? (uint32_t)_in[1] << 8 : 0);
+    *_out++ = _alphabet[(_triple >> 18) & 0x3F];
+    *_out++ = _alphabet[(_triple >> 12) & 0x3F];
+    if(_tail > 1) *_out++ = _alphabet[(_triple >> 6) & 0x3F];
+
+    // the url-safe alphabet goes without padding
+    if(alphabet == base64_standard) {
+      if(_tail < 2) *_out++ = '=';
+      *_out++ = '=';
+    }
+  }
+
+  return (size_t)(_out - dst);
+}
+
+size_t bytelizer_base64_decoded_length(const char* src, size_t length) {
+
+  // strip the paddings
+  if(length > 0 && src[length - 1] == '=') --length;
+  if(length > 0 && src[length - 1] == '=') --length;
+
+  return length / 4 * 3 + ((length & 3) > 1 ? (length & 3) - 1 : 0);
+}
+
+bool bytelizer_base64_decode(uint8_t* dst, const char* src,
+size_t length, bytelizer_base64_t alphabet, bool validate) {
+
+  size_t _padding = 0;
+  while(_padding < 2 && length > 0 && src[length - 1] == '=') {
+    --length;
+    ++_padding;
+  }
+
+  // one character can't carry a whole byte
+  if((length & 3) == 1 || (validate && _padding > 0 && ((length + _padding) & 3) != 0)) {
+    __bytelizer_log("wrong length of base64 string %zu", length + _padding);
+    return false;
+  }
+
+  size_t _done = 0;
+  bool _valid = true;
+  const int8_t* _table = __base64_table[alphabet == base64_urlsafe];
+
+#if BYTELIZER_SIMD_X86
+  if(__has_ssse3())
+    _done = __base64_decode_ssse3(dst, src, length,
+      __base64_alphabet[alphabet == base64_urlsafe], &_valid);
+#endif
+
+  uint8_t* _out = dst + _done / 4 * 3;
+  const char* _in = src + _done;
+  size_t _tail = (length - _done) & 3;
+
+  if(!__base64_decode_scalar(_out, _in, (length - _done) >> 2, _table, validate))
+    _valid = false;
+
+  _out += (length - _done) / 4 * 3;
+  _in += (length - _done - _tail);
+
+  // the last two or three characters
+  if(_tail > 0) {
+    int32_t _a = _table[(uint8_t)_in[0]], _b = _table[(uint8_t)_in[1]];
+    int32_t _c = _tail > 2 ? _table[(uint8_t)_in[2]] : 0;
+
+    if((_a | _b | _c) < 0) _valid = false;
+
+    uint32_t _triple = ((uint32_t)_a << 18) | ((uint32_t)_b << 12) | ((uint32_t)_c << 6);
+    *_out++ = (uint8_t)(_triple >> 16);
+    if(_tail > 2) *_out++ = (uint8_t)(_triple >> 8);
+  }
+
+  return !validate || _valid;
+}
+
+/* ================================================================
+ *  CONTEXT API
+ * ================================================================ */
+
+void bytelizer_put_hex(bytelizer_ctx_t* ctx, const uint8_t* value,
+uint32_t length, bytelizer_hexcase_t hexcase) {
+
+  if(value == NULL || length == 0)
+    return;
+
+  size_t _length = (size_t)length << 1;
+  if(_length > UINT32_MAX || !bytelizer_ensure_available(ctx, _length)) {
+    __bytelizer_log("put hex failed, is it out of memory?");
+    return;
+  }
+
+  bytelizer_hex_encode((char *)ctx->cursor, value, length, hexcase);
+  bytelizer_update_cursor(ctx, (uint32_t)_length);
+}
+
+bool bytelizer_put_unhex(bytelizer_ctx_t* ctx, const char* value,
+uint32_t length, bool validate) {
+
+  if(value == NULL || length == 0)
+    return true;
+
+  if(!bytelizer_ensure_available(ctx, length >> 1)) {
+    __bytelizer_log("put unhex failed, is it out of memory?");
+    return false;
+  }
+
+  // the cursor only moves if the string is valid
+  if(!bytelizer_hex_decode(ctx->cursor, value, length, validate))
+    return false;
+
+  bytelizer_update_cursor(ctx, length >> 1);
+  return true;
+}
+
+void bytelizer_put_base64(bytelizer_ctx_t* ctx, const uint8_t* value,
+uint32_t length, bytelizer_base64_t alphabet) {
+
+  if(value == NULL || length == 0)
+    return;
+
+  size_t _length = bytelizer_base64_length(length);
+  if(_length > UINT32_MAX || !bytelizer_ensure_available(ctx, _length)) {
+    __bytelizer_log("put base64 failed, is it out of memory?");
+    return;
+  }
+
+  _length = bytelizer_base64_encode((char *)ctx->cursor, value, length, alphabet);
+  bytelizer_update_cursor(ctx, (uint32_t)_length);
+}
+
+bool bytelizer_put_unbase64(bytelizer_ctx_t* ctx, const char* value,
+uint32_t length, bytelizer_base64_t alphabet, bool validate) {
+
+  if(value == NULL || length == 0)
+    return true;
+
+  uint32_t _length = (uint32_t)bytelizer_base64_decoded_length(value, length);
+  if(!bytelizer_ensure_available(ctx, _length)) {
+    __bytelizer_log("put unbase64 failed, is it out of memory?");
+    return false;
+  }
+
+  // the cursor only moves if the string is valid
+  if(!bytelizer_base64_decode(ctx->cursor, value, length, alphabet, validate))
+    return false;
+
+  bytelizer_update_cursor(ctx, _length);
+  return true;
+}
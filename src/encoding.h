@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#ifndef _BYTELIZER_ENCODING_H
+#define _BYTELIZER_ENCODING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <bytelizer/common.h>
+#include "codec.h"
+
+typedef enum {
+  hexcase_upper = 0,
+  hexcase_lower,
+} bytelizer_hexcase_t;
+
+typedef enum {
+  base64_standard = 0,
+  base64_urlsafe,
+} bytelizer_base64_t;
+
+/**
+ * @brief get the maximal encoded length of base64
+ * @param length the length of the binary
+ */
+#define bytelizer_base64_length(length) ((((size_t)(length) + 2) / 3) << 2)
+
+/**
+ * @brief encode binary into hex string
+ * @param dst the output, length * 2 characters
+ * @param src the binary
+ * @param length the length of the binary
+ * @param hexcase the letter case, see @ref bytelizer_hexcase_t
+ */
+void bytelizer_hex_encode(char* dst, const uint8_t* src,
+size_t length, bytelizer_hexcase_t hexcase);
+
+/**
+ * @brief decode hex string into binary, both letter cases are accepted
+ * @param dst the output, length / 2 bytes
+ * @param src the hex string
+ * @param length the length of the hex string
+ * @param validate reject the invalid characters,
+ * otherwise they are decoded as garbage for speed
+ * @return false if the string is invalid
+ */
+bool bytelizer_hex_decode(uint8_t* dst, const char* src,
+size_t length, bool validate);
+
+/**
+ * @brief encode binary into base64,
+ * the standard alphabet is padded while the url-safe one is not
+ * @param dst the output, see @ref bytelizer_base64_length
+ * @param src the binary
+ * @param length the length of the binary
+ * @param alphabet the alphabet, see @ref bytelizer_base64_t
+ * @return the encoded length
+ */
+size_t bytelizer_base64_encode(char* dst, const uint8_t* src,
+size_t length, bytelizer_base64_t alphabet);
+
+/**
+ * @brief get the decoded length of a base64 string
+ * @param src the base64 string
+ * @param length the length of the base64 string
+ */
+size_t bytelizer_base64_decoded_length(const char* src, size_t length);
+
+/**
+ * @brief decode base64 into binary, the padding is optional
+ * @param dst the output, see @ref bytelizer_base64_decoded_length
+ * @param src the base64 string
+ * @param length the length of the base64 string
+ * @param alphabet the alphabet, see @ref bytelizer_base64_t
+ * @param validate reject the invalid characters,
+ * otherwise they are decoded as garbage for speed
+ * @return false if the string is invalid
+ */
+bool bytelizer_base64_decode(uint8_t* dst, const char* src,
+size_t length, bytelizer_base64_t alphabet, bool validate);
+
+/**
+ * @brief put binary into buffer as hex string
+ * @param ctx the bytelizer context
+ * @param value the binary
+ * @param length the length of the binary
+ * @param hexcase the letter case, see @ref bytelizer_hexcase_t
+ */
+void bytelizer_put_hex(bytelizer_ctx_t* ctx, const uint8_t* value,
+uint32_t length, bytelizer_hexcase_t hexcase);
+
+/**
+ * @brief decode hex string into buffer
+ * @param ctx the bytelizer context
+ * @param value the hex string
+ * @param length the length of the hex string
+ * @param validate reject the invalid characters
+ * @return false if the string is invalid, nothing is put
+ */
+bool bytelizer_put_unhex(bytelizer_ctx_t* ctx, const char* value,
+uint32_t length, bool validate);
+
+/**
+ * @brief put binary into buffer as base64
+ * @param ctx the bytelizer context
+ * @param value the binary
+ * @param length the length of the binary
+ * @param alphabet the alphabet, see @ref bytelizer_base64_t
+ */
+void bytelizer_put_base64(bytelizer_ctx_t* ctx, const uint8_t* value,
+uint32_t length, bytelizer_base64_t alphabet);
+
+/**
+ * @brief decode base64 into buffer
+ * @param ctx the bytelizer context
+ * @param value the base64 string
+ * @param length the length of the base64 string
+ * @param alphabet the alphabet, see @ref bytelizer_base64_t
+ * @param validate reject the invalid characters
+ * @return false if the string is invalid, nothing is put
+ */
+bool bytelizer_put_unbase64(bytelizer_ctx_t* ctx, const char* value,
+uint32_t length, bytelizer_base64_t alphabet, bool validate);
+
+#endif /* _BYTELIZER_ENCODING_H */
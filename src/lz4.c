@@ -0,0 +1,429 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <bytelizer/common.h>
+#include "debug/log.h"
+#include "compiler.h"
+#include "codec.h"
+#include "advanced.h"
+#include "barrier.h"
+#include "lz4.h"
+
+#define LZ4_MINMATCH 4
+#define LZ4_LASTLITERALS 5
+#define LZ4_MFLIMIT 12
+#define LZ4_HASHLOG 12
+#define LZ4_MAX_DISTANCE 65535
+#define LZ4_SKIP_TRIGGER 6
+
+_inline static uint32_t __lz4_read32(const uint8_t* p) {
+  uint32_t _value; memcpy(&_value, p, 4);
+  return _value;
+}
+
+_inline static uint64_t __lz4_read64(const uint8_t* p) {
+  uint64_t _value; memcpy(&_value, p, 8);
+  return _value;
+}
+
+_inline static uint32_t __lz4_hash(uint32_t sequence) {
+  return (sequence * 2654435761u) >> (32 - LZ4_HASHLOG);
+}
+
+// count the common bytes, 8 bytes at a time
+_inline static size_t __lz4_count(const uint8_t* ip, const uint8_t* match, const uint8_t* limit) {
+
+  const uint8_t* _start = ip;
+
+  while(ip + 8 <= limit) {
+    uint64_t _diff = __lz4_read64(ip) ^ __lz4_read64(match);
+    if(_diff != 0) {
+    #if BYTELIZER_ENDIANNESS == BYTELIZER_BIG_ENDIAN
+      return (size_t)(ip - _start) + (__builtin_clzll(_diff) >> 3);
+    #else
+      return (size_t)(ip - _start) + (__builtin_ctzll(_diff) >> 3);
+    #endif
+    }
+    ip += 8; match += 8;
+  }
+
+  while(ip < limit && *ip == *match) {
+    ++ip; ++match;
+  }
+
+  return (size_t)(ip - _start);
+}
+
+// copy in 16 bytes steps, may write up to 15 bytes past dst + length
+_inline static void __lz4_wildcopy(uint8_t* dst, const uint8_t* src, size_t length) {
+  uint8_t* _end = dst + length;
+  do {
+    memcpy(dst, src, 16);
+    dst += 16; src += 16;
+  } while(dst < _end);
+}
+
+_inline static uint8_t* __lz4_put_length(uint8_t* op, size_t length) {
+  for(; length >= 255; length -= 255) *op++ = 255;
+  *op++ = (uint8_t)length;
+  return op;
+}
+
+size_t bytelizer_lz4_compress(uint8_t* dst, size_t capacity,
+const uint8_t* src, size_t length) {
+
+  const uint8_t* _ip = src;
+  const uint8_t* _anchor = src;
+  const uint8_t* const _iend = src + length;
+
+  uint8_t* _op = dst;
+  uint8_t* const _oend = dst + capacity;
+
+  // positions relative to src, a zero entry is just a bad guess
+  uint32_t _table[1 << LZ4_HASHLOG];
+
+  if(length > UINT32_MAX) {
+    __bytelizer_log("lz4 input is too large");
+    return 0;
+  }
+
+  if(length >= LZ4_MFLIMIT + 1) {
+
+    const uint8_t* const _mflimit = _iend - LZ4_MFLIMIT;
+    const uint8_t* const _matchlimit = _iend - LZ4_LASTLITERALS;
+
+    memset(_table, 0, sizeof(_table));
+    _table[__lz4_hash(__lz4_read32(_ip))] = 0;
+    ++_ip;
+
+    while(_ip < _mflimit) {
+
+      const uint8_t* _match;
+      uint32_t _attempts = 1 << LZ4_SKIP_TRIGGER;
+
+      // search a match, the step grows on incompressible data
+      for(;;) {
+
+        uint32_t _sequence = __lz4_read32(_ip);
+        uint32_t _hash = __lz4_hash(_sequence);
+
+        _match = src + _table[_hash];
+        _table[_hash] = (uint32_t)(_ip - src);
+
+        if(_match < _ip && _ip - _match <= LZ4_MAX_DISTANCE &&
+           __lz4_read32(_match) == _sequence)
+          break;
+
+        _ip += _attempts++ >> LZ4_SKIP_TRIGGER;
+        if(_ip >= _mflimit)
+          goto last_literals;
+      }
+
+      // extend the match backward
+      while(_ip > _anchor && _match > src && _ip[-1] == _match[-1]) {
+        --_ip; --_match;
+      }
+
+      size_t _literals = (size_t)(_ip - _anchor);
+      size_t _matched = __lz4_count(_ip + LZ4_MINMATCH, _match + LZ4_MINMATCH, _matchlimit);
+
+      // token + literals + offset + match length + the last literals token
+      if(_op + 1 + _literals + _literals / 255 + 2 + _matched / 255 + 2 > _oend)
+        return 0;
+
+      uint8_t* _token = _op++;
+      if(_literals >= 15) {
+        *_token = 15 << 4;
+        _op = __lz4_put_length(_op, _literals - 15);
+      }
+      else {
+        *_token = (uint8_t)(_literals << 4);
+      }
+
+      // the literals are short mostly, skip the memcpy call
+      if(_ip + 16 <= _iend && _op + _literals + 16 <= _oend) __lz4_wildcopy(_op, _anchor, _literals);
+      else memcpy(_op, _anchor, _literals);
+      _op += _literals;
+
+      uint16_t _offset = (uint16_t)(_ip - _match);
+      *_op++ = (uint8_t)_offset;
+      *_op++ = (uint8_t)(_offset >> 8);
+
+      if(_matched >= 15) {
+        *_token |= 15;
+        _op = __lz4_put_length(_op, _matched - 15);
+      }
+      else {
+        *_token |= (uint8_t)_matched;
+      }
+
+      _ip += _matched + LZ4_MINMATCH;
+      _anchor = _ip;
+
+      // index the tail of the match for the next search
+      if(_ip < _mflimit)
+        _table[__lz4_hash(__lz4_read32(_ip - 2))] = (uint32_t)(_ip - 2 - src);
+    }
+  }
+
+last_literals: {
+
+    size_t _literals = (size_t)(_iend - _anchor);
+    if(_op + 1 + _literals + _literals / 255 + 1 > _oend)
+      return 0;
+
+    if(_literals >= 15) {
+      *_op++ = 15 << 4;
+      _op = __lz4_put_length(_op, _literals - 15);
+    }
+    else {
+      *_op++ = (uint8_t)(_literals << 4);
+    }
+
+    memcpy(_op, _anchor, _literals);
+    _op += _literals;
+  }
+
+  return (size_t)(_op - dst);
+}
+
+_inline static bool __lz4_get_length(const uint8_t** ip, const uint8_t* iend, size_t* length) {
+
+  uint8_t _byte;
+  do {
+    if(*ip >= iend) return false;
+    _byte = *(*ip)++;
+    *length += _byte;
+  } while(_byte == 255);
+
+  return true;
+}
+
+bool bytelizer_lz4_decompress(uint8_t* dst, size_t capacity,
+const uint8_t* src, size_t length, size_t* decoded) {
+
+  const uint8_t* _ip = src;
+  const uint8_t* const _iend = src + length;
+
+  uint8_t* _op = dst;
+  uint8_t* const _oend = dst + capacity;
+
+  while(_ip < _iend) {
+
+    uint8_t _token = *_ip++;
+
+    // literals
+    size_t _literals = _token >> 4;
+    if(_literals == 15 && !__lz4_get_length(&_ip, _iend, &_literals))
+      goto malformed;
+
+    if(_literals > (size_t)(_iend - _ip) || _literals > (size_t)(_oend - _op))
+      goto malformed;
+
+    if((size_t)(_iend - _ip) >= _literals + 16 && (size_t)(_oend - _op) >= _literals + 16)
+      __lz4_wildcopy(_op, _ip, _literals);
+    else
+      memcpy(_op, _ip, _literals);
+
+    _op += _literals;
+    _ip += _literals;
+
+    // the last sequence has no match
+    if(_ip == _iend)
+      break;
+
+    // match
+    if(_iend - _ip < 2)
+      goto malformed;
+
+    size_t _offset = (size_t)_ip[0] | ((size_t)_ip[1] << 8);
+    _ip += 2;
+
+    if(_offset == 0 || _offset > (size_t)(_op - dst))
+      goto malformed;
+
+    size_t _matched = _token & 15;
+    if(_matched == 15 && !__lz4_get_length(&_ip, _iend, &_matched))
+      goto malformed;
+    _matched += LZ4_MINMATCH;
+
+    if(_matched > (size_t)(_oend - _op))
+      goto malformed;
+
+    const uint8_t* _match = _op - _offset;
+
+    // non-overlapping words can be copied 8 bytes at a time,
+    // the copy may run 7 bytes past the match but never past the output
+    if(_offset >= 8 && _matched + 8 <= (size_t)(_oend - _op)) {
+      uint8_t* _end = _op + _matched;
+      do {
+        memcpy(_op, _match, 8);
+        _op += 8; _match += 8;
+      } while(_op < _end);
+      _op = _end;
+    }
+    else {
+      for(size_t i = 0; i < _matched; ++i)
+        _op[i] = _match[i];
+      _op += _matched;
+    }
+  }
+
+  if(decoded) *decoded = (size_t)(_op - dst);
+  return true;
+
+malformed:
+  __bytelizer_log("malformed lz4 block at %zu", (size_t)(_ip - src));
+  return false;
+}
+
+bool bytelizer_put_lz4(bytelizer_ctx_t* ctx, const uint8_t* value,
+uint32_t length, bytelizer_prefix_t prefix) {
+
+  bytelizer_prefix_t _basetype, _lentype;
+  __parse_prefix(prefix, length, &_basetype, &_lentype);
+
+  // reserve both sizes and the worst block before writing anything,
+  // a failure leaves the context untouched
+  size_t _bound = bytelizer_lz4_bound(length);
+  size_t _width = __get_prefix_length_by_type(_lentype);
+  if(_bound > UINT32_MAX || !bytelizer_ensure_available(ctx, _width * 2 + _bound)) {
+    __bytelizer_log("put lz4 failed, is it out of memory?");
+    return false;
+  }
+
+  // the raw size is always plain
+  __put_prefix(ctx, prefix_length_only, _lentype, length);
+
+  // the compressed size is known after compressing
+  bytelizer_barrier_t _barrier;
+  if(!__barrier_enter(&_barrier, ctx, prefix))
+    return false;
+
+  // compress straight into the buffer
+
+  size_t _compressed = bytelizer_lz4_compress(ctx->cursor, _bound, value, length);
+  bytelizer_update_cursor(ctx, (uint32_t)_compressed);
+
+  return __barrier_leave(&_barrier, 0);
+}
+
+static void __copy_linear(void* userdata, uint8_t* buffer, size_t length) {
+  uint8_t** _cursor = (uint8_t **)userdata;
+  memcpy(*_cursor, buffer, length);
+  *_cursor += length;
+}
+
+bool bytelizer_put_lz4_bytelizer(bytelizer_ctx_t* ctx,
+bytelizer_ctx_t* value, bytelizer_prefix_t prefix) {
+
+  // the stack is contiguous already
+  if(value->blocks == NULL)
+    return bytelizer_put_lz4(ctx, value->stack, value->stack_wrotes, prefix);
+
+  // matches can cross the blocks, so linearize them first
+  uint8_t* _linear = (uint8_t *)malloc(value->total_length);
+  if(_linear == NULL) {
+    __bytelizer_log("put lz4 failed, is it out of memory?");
+    return false;
+  }
+
+  uint8_t* _cursor = _linear;
+  bytelizer_copy_to(&_cursor, value, __copy_linear);
+  bool _result = bytelizer_put_lz4(ctx, _linear, value->total_length, prefix);
+
+  free(_linear);
+  return _result;
+}
+
+// give the prefixes back to an attached buffer
+static void __rewind_cursor(bytelizer_ctx_t* ctx, uint8_t* cursor) {
+  uint32_t _read = (uint32_t)(ctx->cursor - cursor);
+  ctx->cursor = cursor;
+  ctx->total_length -= _read;
+  *ctx->counter -= _read;
+}
+
+static bool __get_lz4_header(bytelizer_ctx_t* ctx, bytelizer_prefix_t prefix,
+uint32_t* raw, uint32_t* compressed) {
+
+  bytelizer_prefix_t _basetype, _lentype;
+  __parse_prefix(prefix, 0, &_basetype, &_lentype);
+
+  uint8_t* _cursor = ctx->cursor;
+
+  if(!bytelizer_get_prefix(ctx, prefix_length_only | _lentype, raw) ||
+     !bytelizer_get_prefix(ctx, prefix, compressed) ||
+     *compressed > bytelizer_remain(ctx)) {
+    __bytelizer_log("truncated lz4 region");
+
+    __rewind_cursor(ctx, _cursor);
+    return false;
+  }
+
+  return true;
+}
+
+bool bytelizer_get_lz4(bytelizer_ctx_t* ctx, uint8_t* buffer,
+uint32_t capacity, bytelizer_prefix_t prefix, uint32_t* length) {
+
+  uint8_t* _cursor = ctx->cursor;
+  uint32_t _raw, _compressed;
+
+  if(!__get_lz4_header(ctx, prefix, &_raw, &_compressed))
+    return false;
+
+  size_t _decoded = 0;
+  if(_raw > capacity ||
+     !bytelizer_lz4_decompress(buffer, _raw, ctx->cursor, _compressed, &_decoded) ||
+     _decoded != _raw) {
+
+    __bytelizer_log("get lz4 failed, %u bytes expected", _raw);
+
+    __rewind_cursor(ctx, _cursor);
+    return false;
+  }
+
+  bytelizer_update_cursor(ctx, _compressed);
+  if(length) *length = _raw;
+
+  return true;
+}
+
+bool bytelizer_get_lz4_bytelizer(bytelizer_ctx_t* ctx,
+bytelizer_ctx_t* value, bytelizer_prefix_t prefix) {
+
+  uint8_t* _cursor = ctx->cursor;
+  uint32_t _raw, _compressed;
+
+  if(!__get_lz4_header(ctx, prefix, &_raw, &_compressed))
+    return false;
+
+  // decompress straight into the buffer
+  size_t _decoded = 0;
+  if(!bytelizer_ensure_available(value, _raw) ||
+     !bytelizer_lz4_decompress(value->cursor, _raw, ctx->cursor, _compressed, &_decoded) ||
+     _decoded != _raw) {
+
+    __bytelizer_log("get lz4 failed, %u bytes expected", _raw);
+
+    __rewind_cursor(ctx, _cursor);
+    return false;
+  }
+
+  bytelizer_update_cursor(value, _raw);
+  bytelizer_update_cursor(ctx, _compressed);
+
+  return true;
+}
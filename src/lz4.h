@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#ifndef _BYTELIZER_LZ4_H
+#define _BYTELIZER_LZ4_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <bytelizer/common.h>
+#include "codec.h"
+#include "advanced.h"
+
+/*
+  A compressed region is written as
+
+    [raw size][compressed size][lz4 block]
+
+  both sizes use the length type of the given prefix, the raw size
+  is always plain while the compressed size follows the base type.
+  The block is the plain lz4 block format, without the frame header.
+*/
+
+/**
+ * @brief get the worst compressed length of a lz4 block
+ * @param length the raw length
+ */
+#define bytelizer_lz4_bound(length) ((size_t)(length) + (size_t)(length) / 255 + 16)
+
+/**
+ * @brief compress into a lz4 block
+ * @param dst the output
+ * @param capacity the output capacity, see @ref bytelizer_lz4_bound
+ * @param src the raw data
+ * @param length the raw length
+ * @return the compressed length, 0 if the output is too small
+ */
+size_t bytelizer_lz4_compress(uint8_t* dst, size_t capacity,
+const uint8_t* src, size_t length);
+
+/**
+ * @brief decompress a lz4 block, every read and write is bounds-checked
+ * @param dst the output
+ * @param capacity the output capacity
+ * @param src the lz4 block
+ * @param length the block length
+ * @param decoded the decompressed length
+ * @return false if the block is malformed or the output is too small
+ */
+bool bytelizer_lz4_decompress(uint8_t* dst, size_t capacity,
+const uint8_t* src, size_t length, size_t* decoded);
+
+/**
+ * @brief compress bytes directly into buffer with size prefixes
+ * @param ctx the bytelizer context
+ * @param value the raw data
+ * @param length the raw length
+ * @param prefix the prefix, e.g. prefix_length_only | prefix_varint
+ */
+bool bytelizer_put_lz4(bytelizer_ctx_t* ctx, const uint8_t* value,
+uint32_t length, bytelizer_prefix_t prefix);
+
+/**
+ * @brief compress another bytelizer directly into buffer with size prefixes
+ * @param ctx the bytelizer context
+ * @param value the bytelizer context to be compressed
+ * @param prefix the prefix, e.g. prefix_length_only | prefix_varint
+ */
+bool bytelizer_put_lz4_bytelizer(bytelizer_ctx_t* ctx,
+bytelizer_ctx_t* value, bytelizer_prefix_t prefix);
+
+/**
+ * @brief get a compressed region from an attached buffer
+ * @param ctx the bytelizer context
+ * @param buffer the output
+ * @param capacity the output capacity
+ * @param prefix the prefix, the same as putting
+ * @param length the decompressed length
+ * @return false if the region is truncated, malformed or too large,
+ * the cursor is not moved in this case
+ */
+bool bytelizer_get_lz4(bytelizer_ctx_t* ctx, uint8_t* buffer,
+uint32_t capacity, bytelizer_prefix_t prefix, uint32_t* length);
+
+/**
+ * @brief get a compressed region from an attached buffer into another bytelizer
+ * @param ctx the bytelizer context
+ * @param value the bytelizer context to put the decompressed data into
+ * @param prefix the prefix, the same as putting
+ */
+bool bytelizer_get_lz4_bytelizer(bytelizer_ctx_t* ctx,
+bytelizer_ctx_t* value, bytelizer_prefix_t prefix);
+
+/**
+ * @brief begin a region that is compressed into the parent on leave
+ * @param region the region context name
+ * @param size the stack buffer size of the region
+*/
+#define bytelizer_compress_enter(region, size) \
+  bytelizer_alloc(region, size)
+
+/**
+ * @brief compress the region into the parent and release it
+ * @param region the region context name
+ * @param ref the parent bytelizer context
+ * @param prefix the prefix, e.g. prefix_length_only | prefix_varint
+*/
+#define bytelizer_compress_leave(region, ref, prefix) \
+  bytelizer_put_lz4_bytelizer(ref, region, prefix); \
+  bytelizer_destroy(region)
+
+/**
+ * @brief decompress a region and attach it for reading,
+ * the region is readable with the regular get functions in the scope
+ * @param region the region context name
+ * @param ref the attached bytelizer context
+ * @param buffer the decompress buffer
+ * @param capacity the decompress buffer capacity
+ * @param prefix the prefix, the same as putting
+ * @note region##_ok is false in the scope if the region is truncated,
+ * malformed or too large, the region is empty in this case
+*/
+#define bytelizer_decompress_enter(region, ref, buffer, capacity, prefix) { \
+  uint32_t region##_length = 0; \
+  bool region##_ok = bytelizer_get_lz4(ref, buffer, capacity, prefix, &region##_length); \
+  (void)region##_ok; \
+  bytelizer_attach(region, buffer, region##_length)
+
+#define bytelizer_decompress_leave(region) \
+  bytelizer_detach(region) }
+
+#endif /* _BYTELIZER_LZ4_H */
@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "debug/log.h"
+#include "codec.h"
+#include "protobuf.h"
+#include "pbconst.h"
+
+const __pbconst_blob_t* __pbconst_compile(bytelizer_pbconst_t* constant) {
+
+  __pbconst_blob_t* _blob = atomic_load_explicit(&constant->blob, memory_order_acquire);
+  if(_blob != NULL) return _blob;
+
+  uint32_t _length = bytelizer_pbstruct_size(constant->pbroot);
+
+  _blob = malloc(sizeof(__pbconst_blob_t) + _length);
+  if(_blob == NULL || !__pbstruct_encode(constant->pbroot, _blob->data, _length)) {
+    __bytelizer_log("encoding a constant protobuf struct failed, is it out of memory?");
+    free(_blob);
+    return NULL;
+  }
+  _blob->length = _length;
+
+  // the first one to finish is kept, the others use it
+  __pbconst_blob_t* _expected = NULL;
+  if(!atomic_compare_exchange_strong_explicit(&constant->blob, &_expected, _blob,
+      memory_order_acq_rel, memory_order_acquire)) {
+    free(_blob);
+    return _expected;
+  }
+
+  return _blob;
+}
+
+bool bytelizer_put_pbconst(bytelizer_ctx_t* ctx, bytelizer_pbconst_t* constant) {
+
+  const __pbconst_blob_t* _blob = __pbconst_get(constant);
+  if(_blob == NULL) return false;
+
+  bytelizer_put_bytes(ctx, _blob->data, _blob->length);
+  return true;
+}
+
+void bytelizer_pbconst_release(bytelizer_pbconst_t* constant) {
+  free(atomic_exchange_explicit(&constant->blob, NULL, memory_order_acq_rel));
+}
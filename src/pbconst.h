@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#ifndef _BYTELIZER_PBCONST_H
+#define _BYTELIZER_PBCONST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <bytelizer/common.h>
+
+#include "compiler.h"
+#include "codec.h"
+#include "protobuf.h"
+
+/*
+  A constant protobuf struct is encoded once, at the first use or by
+  bytelizer_pbconst_compile, then its bytes are put as they are:
+
+    PBSTRUCT_CONST(capabilities, (PBSTRUCT {
+      PB_VARINT(1, version, 3),
+      PB_CSTRING(2, vendor, "bytelizer"),
+    PB_MESSAGE_END }));
+    ...
+    bytelizer_put_pbconst(ctx, &_pb_const_capabilities);
+
+  A dynamic struct reuses the bytes for a constant sub message, only
+  the rest of it is encoded:
+
+    bytelizer_put_pbstruct(ctx, PBSTRUCT {
+      PB_VARINT(1, sequence, sequence),
+      PB_CONST_MESSAGE(2, capabilities, &_pb_const_capabilities),
+    PB_MESSAGE_END });
+
+  The struct must not change after the first use. Threads may race on
+  the first use, every one encodes it and a single copy is kept.
+*/
+
+typedef struct {
+  uint32_t length;
+  uint8_t data[];
+} __pbconst_blob_t;
+
+typedef struct _bytelizer_pbconst_t {
+  const bytelizer_pbfield_t* pbroot;
+  _Atomic(__pbconst_blob_t*) blob;
+} bytelizer_pbconst_t;
+
+/**
+ * @brief declare a constant protobuf struct
+ * @param _name the name, the struct is _pb_const_##_name
+ * @param _fields the protobuf struct
+*/
+#define PBSTRUCT_CONST(_name, _fields) \
+  static bytelizer_pbconst_t _pb_const_##_name = { .pbroot = _fields }
+
+// encode a constant struct if it is not yet, NULL if it is out of memory
+const __pbconst_blob_t* __pbconst_compile(bytelizer_pbconst_t* constant);
+
+_inline static const __pbconst_blob_t* __pbconst_get(bytelizer_pbconst_t* constant) {
+  const __pbconst_blob_t* _blob = atomic_load_explicit(&constant->blob, memory_order_acquire);
+  return _blob != NULL ? _blob : __pbconst_compile(constant);
+}
+
+/**
+ * @brief encode a constant struct ahead of the first use
+ * @param constant the constant struct
+ * @return false if it is out of memory
+ */
+_inline static bool bytelizer_pbconst_compile(bytelizer_pbconst_t* constant) {
+  return __pbconst_get(constant) != NULL;
+}
+
+/**
+ * @brief get the encoded length of a constant struct
+ * @param constant the constant struct
+ */
+_inline static uint32_t bytelizer_pbconst_length(bytelizer_pbconst_t* constant) {
+  const __pbconst_blob_t* _blob = __pbconst_get(constant);
+  return _blob != NULL ? _blob->length : 0;
+}
+
+/**
+ * @brief get the encoded bytes of a constant struct
+ * @param constant the constant struct
+ * @return the bytes, NULL if it is out of memory
+ */
+_inline static const uint8_t* bytelizer_pbconst_data(bytelizer_pbconst_t* constant) {
+  const __pbconst_blob_t* _blob = __pbconst_get(constant);
+  return _blob != NULL ? _blob->data : NULL;
+}
+
+/**
+ * @brief put a constant struct, a single copy of its bytes
+ * @param ctx the bytelizer context
+ * @param constant the constant struct
+ * @return false if it is out of memory
+ */
+bool bytelizer_put_pbconst(bytelizer_ctx_t* ctx, bytelizer_pbconst_t* constant);
+
+/**
+ * @brief release the bytes of a constant struct, no thread may use it
+ * @param constant the constant struct
+ */
+void bytelizer_pbconst_release(bytelizer_pbconst_t* constant);
+
+/**
+ * @brief define a constant message field in a dynamic struct, its bytes
+ * are put as a bytes field, an empty message if it is out of memory
+ * @param _tag the field index
+ * @param _name the name of the field
+ * @param _const the constant struct, bytelizer_pbconst_t*
+*/
+#define PB_CONST_MESSAGE(_tag, _name, _const) \
+  PB_BYTES(_tag, _name, bytelizer_pbconst_data(_const), bytelizer_pbconst_length(_const))
+
+#endif /* _BYTELIZER_PBCONST_H */
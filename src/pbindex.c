@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "debug/log.h"
+#include "varint.h"
+#include "protobuf.h"
+#include "pbindex.h"
+
+static bool __pbindex_grow(bytelizer_pbindex_t* index) {
+
+  uint32_t _capacity = index->capacity ? index->capacity * 2 : 16;
+  bytelizer_pbentry_t* _entries = index->entries == index->stack
+    ? malloc(_capacity * sizeof(bytelizer_pbentry_t))
+    : realloc(index->entries, _capacity * sizeof(bytelizer_pbentry_t));
+
+  if(_entries == NULL) {
+    __bytelizer_log("growing the protobuf index failed");
+    return false;
+  }
+
+  if(index->entries == index->stack)
+    memcpy(_entries, index->stack, index->count * sizeof(bytelizer_pbentry_t));
+
+  index->entries = _entries;
+  index->capacity = _capacity;
+  return true;
+}
+
+bool bytelizer_pbindex_build(bytelizer_pbindex_t* index, const uint8_t* data, uint32_t length) {
+
+  const uint8_t* _cursor = data;
+  const uint8_t* _end = data + length;
+  uint64_t _varint;
+  uint32_t _length;
+
+  index->data = data;
+  index->length = length;
+  index->count = 0;
+
+  while(_cursor < _end) {
+
+    const uint8_t* _begin = _cursor;
+
+    // get the tag
+    if((_length = __varint_decode(_cursor, _end, &_varint)) == 0 ||
+       (_varint >> 3) == 0 || (_varint >> 3) > BYTELIZER_PBTAG_MAX) {
+      __bytelizer_log("invalid protobuf tag at %u", (uint32_t)(_begin - data));
+      return false;
+    }
+    _cursor += _length;
+
+    // only skip the value
+    uint64_t _value = 0;
+    switch((bytelizer_pbtype_t)(_varint & 0b111)) {
+
+      case bytelizer_pbtype_varint:
+        if((_length = __varint_decode(_cursor, _end, &_value)) == 0) {
+          __bytelizer_log("truncated protobuf varint at %u", (uint32_t)(_cursor - data));
+          return false;
+        }
+        break;
+
+      case bytelizer_pbtype_32bit:
+        _length = sizeof(uint32_t);
+        break;
+
+      case bytelizer_pbtype_64bit:
+        _length = sizeof(uint64_t);
+        break;
+
+      case bytelizer_pbtype_length_delimited: {
+        uint32_t _prefix = __varint_decode(_cursor, _end, &_value);
+        if(_prefix == 0) {
+          __bytelizer_log("truncated protobuf length at %u", (uint32_t)(_cursor - data));
+          return false;
+        }
+        _cursor += _prefix;
+        if(_value > (uint64_t)(_end - _cursor)) {
+          __bytelizer_log("protobuf length %llu at %u is out of bounds",
+            (unsigned long long)_value, (uint32_t)(_cursor - data));
+          return false;
+        }
+        _length = (uint32_t)_value;
+        break;
+      }
+
+      default:
+        __bytelizer_log("unsupported protobuf wire type at %u", (uint32_t)(_begin - data));
+        return false;
+    }
+
+    if(_length > (uint64_t)(_end - _cursor)) {
+      __bytelizer_log("truncated protobuf field at %u", (uint32_t)(_begin - data));
+      return false;
+    }
+
+    if(index->count == index->capacity && !__pbindex_grow(index))
+      return false;
+
+    index->entries[index->count++] = (bytelizer_pbentry_t) {
+      .key = (uint32_t)_varint,
+      .begin = (uint32_t)(_begin - data),
+      .offset = (uint32_t)(_cursor - data),
+      .length = _length,
+    };
+
+    _cursor += _length;
+  }
+
+  return true;
+}
+
+void bytelizer_pbindex_destroy_unsafe(bytelizer_pbindex_t* index) {
+
+  if(index->entries != index->stack)
+    free(index->entries);
+}
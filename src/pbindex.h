@@ -0,0 +1,305 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#ifndef _BYTELIZER_PBINDEX_H
+#define _BYTELIZER_PBINDEX_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <bytelizer/common.h>
+
+#include "compiler.h"
+#include "codec.h"
+#include "bitwise.h"
+#include "varint.h"
+#include "protobuf.h"
+
+/*
+  A protobuf index is a single pass over the wire bytes, every field
+  is recorded by its tag and position, nothing is decoded yet:
+
+    bytelizer_pbindex_alloc(msg, 32);
+      bytelizer_pbindex_build(msg, data, length);
+      bytelizer_pbindex_get_varint(msg, 1, &id);
+
+      // a nested message is indexed when it is opened
+      bytelizer_pbindex_alloc(header, 16);
+        bytelizer_pbindex_get_message(msg, 2, header);
+        bytelizer_pbindex_get_bytes(header, 1, &name, &name_length);
+      bytelizer_pbindex_destroy(header);
+    bytelizer_pbindex_destroy(msg);
+
+  The data must stay alive while the index is used.
+*/
+
+typedef struct {
+  // the raw tag, field number << 3 | wire type
+  uint32_t key;
+  // the beginning of the field, the tag included
+  uint32_t begin;
+  // the value, after the length of a length-delimited one
+  uint32_t offset;
+  uint32_t length;
+} bytelizer_pbentry_t;
+
+typedef struct {
+  const uint8_t* data;
+  uint32_t length;
+  bytelizer_pbentry_t* entries;
+  uint32_t count;
+  uint32_t capacity;
+  bytelizer_pbentry_t* stack;
+} bytelizer_pbindex_t;
+
+/**
+ * @brief protobuf index initialize
+ * @param index the index
+ * @param size the entries kept on the stack before spilling into the heap
+ */
+#define bytelizer_pbindex_alloc(index, size) { \
+  bytelizer_pbentry_t index##_entries[size]; \
+  bytelizer_pbindex_t* index = &(bytelizer_pbindex_t) { \
+    .data = NULL, \
+    .length = 0, \
+    .entries = index##_entries, \
+    .count = 0, \
+    .capacity = size, \
+    .stack = index##_entries, \
+  };
+
+/**
+ * @brief release the heap entries of a protobuf index
+ * @param index the index
+ */
+void bytelizer_pbindex_destroy_unsafe(bytelizer_pbindex_t* index);
+
+#define bytelizer_pbindex_destroy(index) bytelizer_pbindex_destroy_unsafe(index); }
+
+/**
+ * @brief index a protobuf message in a single pass
+ * @param index the index, the old entries are dropped
+ * @param data the wire bytes
+ * @param length the length of the message
+ * @return false if the message is malformed
+ */
+bool bytelizer_pbindex_build(bytelizer_pbindex_t* index, const uint8_t* data, uint32_t length);
+
+/**
+ * @brief index the rest of an attached buffer, the cursor is moved
+ * to the end if the message is good
+ * @param ctx the bytelizer context
+ * @param index the index
+ */
+_inline static bool bytelizer_get_pbindex(bytelizer_ctx_t* ctx, bytelizer_pbindex_t* index) {
+
+  uint32_t _length = bytelizer_remain(ctx);
+  if(!bytelizer_pbindex_build(index, ctx->cursor, _length))
+    return false;
+
+  bytelizer_update_cursor(ctx, _length);
+  return true;
+}
+
+/**
+ * @brief get the field number of an entry
+ * @param entry the entry
+ */
+#define bytelizer_pbentry_tag(entry) ((entry)->key >> 3)
+
+/**
+ * @brief get the wire type of an entry
+ * @param entry the entry
+ */
+#define bytelizer_pbentry_type(entry) ((bytelizer_pbtype_t)((entry)->key & 0b111))
+
+/**
+ * @brief get the value bytes of an entry
+ * @param index the index
+ * @param entry the entry
+ */
+#define bytelizer_pbentry_value(index, entry) ((index)->data + (entry)->offset)
+
+/**
+ * @brief find the next occurrence of a field
+ * @param index the index
+ * @param tag the field number
+ * @param entry the previous occurrence, NULL to start from the first
+ * @return the entry, NULL if there is no more
+ */
+_inline static const bytelizer_pbentry_t* bytelizer_pbindex_next(
+const bytelizer_pbindex_t* index, uint32_t tag, const bytelizer_pbentry_t* entry) {
+
+  const bytelizer_pbentry_t* _end = index->entries + index->count;
+  entry = entry ? entry + 1 : index->entries;
+
+  for(; entry < _end; ++entry)
+    if(bytelizer_pbentry_tag(entry) == tag) return entry;
+
+  return NULL;
+}
+
+/**
+ * @brief find a field, the last occurrence wins as in protobuf
+ * @param index the index
+ * @param tag the field number
+ * @return the entry, NULL if the field is absent
+ */
+_inline static const bytelizer_pbentry_t* bytelizer_pbindex_find(
+const bytelizer_pbindex_t* index, uint32_t tag) {
+
+  for(uint32_t i = index->count; i-- > 0;)
+    if(bytelizer_pbentry_tag(&index->entries[i]) == tag) return &index->entries[i];
+
+  return NULL;
+}
+
+/**
+ * @brief count the occurrences of a field
+ * @param index the index
+ * @param tag the field number
+ */
+_inline static uint32_t bytelizer_pbindex_count(const bytelizer_pbindex_t* index, uint32_t tag) {
+
+  uint32_t _count = 0;
+  for(uint32_t i = 0; i < index->count; ++i)
+    _count += bytelizer_pbentry_tag(&index->entries[i]) == tag;
+
+  return _count;
+}
+
+// find a field of the wire type
+_inline static const bytelizer_pbentry_t* __pbindex_find_typed(
+const bytelizer_pbindex_t* index, uint32_t tag, bytelizer_pbtype_t type) {
+
+  const bytelizer_pbentry_t* _entry = bytelizer_pbindex_find(index, tag);
+  if(_entry == NULL || bytelizer_pbentry_type(_entry) != type)
+    return NULL;
+
+  return _entry;
+}
+
+/**
+ * @brief get a varint field
+ * @param index the index
+ * @param tag the field number
+ * @param value the value
+ * @return false if the field is absent or of another wire type
+ */
+_inline static bool bytelizer_pbindex_get_varint(const bytelizer_pbindex_t* index,
+uint32_t tag, uint64_t* value) {
+
+  const bytelizer_pbentry_t* _entry = __pbindex_find_typed(index, tag, bytelizer_pbtype_varint);
+  if(_entry == NULL) return false;
+
+  const uint8_t* _value = bytelizer_pbentry_value(index, _entry);
+  return __varint_decode(_value, _value + _entry->length, value) != 0;
+}
+
+/**
+ * @brief get a zigzag encoded sint field
+ * @param index the index
+ * @param tag the field number
+ * @param value the value
+ */
+_inline static bool bytelizer_pbindex_get_svarint(const bytelizer_pbindex_t* index,
+uint32_t tag, int64_t* value) {
+
+  uint64_t _value;
+  if(!bytelizer_pbindex_get_varint(index, tag, &_value))
+    return false;
+
+  *value = __zigzag_decode64(_value);
+  return true;
+}
+
+/**
+ * @brief get a fixed32 field
+ * @param index the index
+ * @param tag the field number
+ * @param value the value
+ */
+_inline static bool bytelizer_pbindex_get_fixed32(const bytelizer_pbindex_t* index,
+uint32_t tag, uint32_t* value) {
+
+  const bytelizer_pbentry_t* _entry = __pbindex_find_typed(index, tag, bytelizer_pbtype_32bit);
+  if(_entry == NULL) return false;
+
+  uint32_t _value;
+  memcpy(&_value, bytelizer_pbentry_value(index, _entry), sizeof(uint32_t));
+  *value = bitwise_le32(_value);
+  return true;
+}
+
+/**
+ * @brief get a fixed64 field
+ * @param index the index
+ * @param tag the field number
+ * @param value the value
+ */
+_inline static bool bytelizer_pbindex_get_fixed64(const bytelizer_pbindex_t* index,
+uint32_t tag, uint64_t* value) {
+
+  const bytelizer_pbentry_t* _entry = __pbindex_find_typed(index, tag, bytelizer_pbtype_64bit);
+  if(_entry == NULL) return false;
+
+  uint64_t _value;
+  memcpy(&_value, bytelizer_pbentry_value(index, _entry), sizeof(uint64_t));
+  *value = bitwise_le64(_value);
+  return true;
+}
+
+/**
+ * @brief get a length-delimited field without copying
+ * @param index the index
+ * @param tag the field number
+ * @param data the bytes in the message
+ * @param length the length of the bytes
+ */
+_inline static bool bytelizer_pbindex_get_bytes(const bytelizer_pbindex_t* index,
+uint32_t tag, const uint8_t** data, uint32_t* length) {
+
+  const bytelizer_pbentry_t* _entry = __pbindex_find_typed(index, tag, bytelizer_pbtype_length_delimited);
+  if(_entry == NULL) return false;
+
+  *data = bytelizer_pbentry_value(index, _entry);
+  *length = _entry->length;
+  return true;
+}
+
+/**
+ * @brief index a nested message on access
+ * @param index the index
+ * @param tag the field number
+ * @param message the index of the nested message
+ * @return false if the field is absent or the message is malformed
+ */
+_inline static bool bytelizer_pbindex_get_message(const bytelizer_pbindex_t* index,
+uint32_t tag, bytelizer_pbindex_t* message) {
+
+  const uint8_t* _data;
+  uint32_t _length;
+
+  if(!bytelizer_pbindex_get_bytes(index, tag, &_data, &_length))
+    return false;
+
+  return bytelizer_pbindex_build(message, _data, _length);
+}
+
+/**
+ * @brief put a field as it is, e.g. forwarding selected fields
+ * @param ctx the bytelizer context
+ * @param index the index
+ * @param entry the entry
+ */
+#define bytelizer_put_pbentry(ctx, index, entry) \
+  bytelizer_put_bytes(ctx, (index)->data + (entry)->begin, \
+    (entry)->offset + (entry)->length - (entry)->begin)
+
+#endif /* _BYTELIZER_PBINDEX_H */
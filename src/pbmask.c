@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "debug/log.h"
+#include "codec.h"
+#include "protobuf.h"
+#include "pbmask.h"
+
+// find or add the entry of a tag
+static __pbmask_entry_t* __pbmask_put(bytelizer_pbmask_t* mask, uint32_t tag) {
+
+  for(uint32_t i = 0; i < mask->count; ++i)
+    if(mask->entries[i].tag == tag) return &mask->entries[i];
+
+  if(mask->count == mask->capacity) {
+    uint32_t _capacity = mask->capacity ? mask->capacity * 2 : 4;
+    __pbmask_entry_t* _entries = realloc(mask->entries, _capacity * sizeof(__pbmask_entry_t));
+    if(_entries == NULL) return NULL;
+    mask->entries = _entries;
+    mask->capacity = _capacity;
+  }
+
+  if(tag < 64) mask->small |= 1ull << tag;
+
+  __pbmask_entry_t* _entry = &mask->entries[mask->count++];
+  _entry->tag = tag;
+  _entry->child = NULL;
+  return _entry;
+}
+
+// add a path, a field wanted whole takes no child mask
+static bool __pbmask_add(bytelizer_pbmask_t* mask, const uint32_t* tags, uint32_t count) {
+
+  for(uint32_t i = 0; i < count; ++i) {
+
+    uint32_t _count = mask->count;
+    __pbmask_entry_t* _entry = __pbmask_put(mask, tags[i]);
+    if(_entry == NULL) return false;
+
+    // the whole field is wanted already
+    if(_count == mask->count && _entry->child == NULL) return true;
+
+    // the path ends here, the rest of the field is wanted too
+    if(i == count - 1) {
+      bytelizer_pbmask_destroy(_entry->child);
+      _entry->child = NULL;
+      return true;
+    }
+
+    if(_entry->child == NULL) {
+      _entry->child = calloc(1, sizeof(bytelizer_pbmask_t));
+      if(_entry->child == NULL) return false;
+    }
+
+    mask = _entry->child;
+  }
+
+  return true;
+}
+
+bytelizer_pbmask_t* bytelizer_pbmask_create(const char* paths) {
+
+  if(paths == NULL) return NULL;
+
+  bytelizer_pbmask_t* _mask = calloc(1, sizeof(bytelizer_pbmask_t));
+  if(_mask == NULL) return NULL;
+
+  uint32_t _tags[BYTELIZER_PBSTRUCT_DEPTH];
+  const char* _cursor = paths;
+
+  for(;;) {
+
+    while(*_cursor == ',' || *_cursor == ' ' || *_cursor == '\t') ++_cursor;
+    if(*_cursor == '\0') break;
+
+    // the tags of a path
+    uint32_t _count = 0;
+    for(;;) {
+
+      uint64_t _tag = 0;
+      const char* _digits = _cursor;
+      while(*_cursor >= '0' && *_cursor <= '9' && _tag <= BYTELIZER_PBTAG_MAX)
+        _tag = _tag * 10 + (uint64_t)(*_cursor++ - '0');
+
+      if(_cursor == _digits || _tag == 0 || _tag > BYTELIZER_PBTAG_MAX || _count == BYTELIZER_PBSTRUCT_DEPTH) {
+        __bytelizer_log("malformed protobuf field mask at %u", (uint32_t)(_cursor - paths));
+        goto failure;
+      }
+
+      _tags[_count++] = (uint32_t)_tag;
+      if(*_cursor != '.') break;
+      ++_cursor;
+    }
+
+    if(*_cursor != '\0' && *_cursor != ',' && *_cursor != ' ' && *_cursor != '\t') {
+      __bytelizer_log("malformed protobuf field mask at %u", (uint32_t)(_cursor - paths));
+      goto failure;
+    }
+
+    if(!__pbmask_add(_mask, _tags, _count)) {
+      __bytelizer_log("protobuf field mask is out of memory");
+      goto failure;
+    }
+  }
+
+  return _mask;
+
+failure:
+  bytelizer_pbmask_destroy(_mask);
+  return NULL;
+}
+
+void bytelizer_pbmask_destroy(bytelizer_pbmask_t* mask) {
+
+  if(mask == NULL) return;
+
+  for(uint32_t i = 0; i < mask->count; ++i)
+    bytelizer_pbmask_destroy(mask->entries[i].child);
+
+  free(mask->entries);
+  free(mask);
+}
+
+bool bytelizer_get_pbstruct_masked_ex(bytelizer_ctx_t* ctx, bytelizer_pbfield_t* pbroot,
+const bytelizer_pbmask_t* mask, uint32_t length) {
+
+  if(pbroot == NULL || mask == NULL) return false;
+
+  __pbstruct_target_t _target = { .pbroot = pbroot, .mask = mask };
+  return __pbstruct_get(ctx, length, __pbstruct_get_masked, &_target);
+}
@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#ifndef _BYTELIZER_PBMASK_H
+#define _BYTELIZER_PBMASK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <bytelizer/common.h>
+
+#include "compiler.h"
+#include "codec.h"
+#include "protobuf.h"
+
+/*
+  A field mask is a set of tag paths, a message is decoded into its
+  protobuf struct only along them. The fields out of the mask are
+  skipped by their wire type without looking into them:
+
+    bytelizer_pbmask_t* mask = bytelizer_pbmask_create("1, 3.2.1, 7.4");
+    ...
+    bytelizer_attach(ctx, data, length);
+      bytelizer_get_pbstruct_masked(ctx, report, mask);
+    bytelizer_detach(ctx);
+    ...
+    bytelizer_pbmask_destroy(mask);
+
+  A path ending at a message decodes the whole of it, a path going on
+  into a message decodes only the fields below it, for every element
+  of a repeated one. All the paths share a single pass over the wire.
+*/
+
+typedef struct {
+  uint32_t tag;
+  // the mask of the nested message, NULL if all of it is wanted
+  bytelizer_pbmask_t* child;
+} __pbmask_entry_t;
+
+struct _bytelizer_pbmask_t {
+  // the wanted tags below 64, the common ones are rejected by a bit
+  uint64_t small;
+  __pbmask_entry_t* entries;
+  uint32_t count;
+  uint32_t capacity;
+};
+
+/**
+ * @brief compile a field mask
+ * @param paths the tag paths separated by commas or spaces,
+ * the tags of a path are separated by dots
+ * @return the mask, NULL if a path is malformed or it is out of memory
+ */
+bytelizer_pbmask_t* bytelizer_pbmask_create(const char* paths);
+
+/**
+ * @brief release a field mask
+ * @param mask the mask
+ */
+void bytelizer_pbmask_destroy(bytelizer_pbmask_t* mask);
+
+/**
+ * @brief find a tag in a field mask
+ * @param mask the mask
+ * @param tag the field number
+ * @return the entry, NULL if the tag is not wanted
+ */
+_inline static const __pbmask_entry_t* __pbmask_find(const bytelizer_pbmask_t* mask, uint32_t tag) {
+
+  if(tag < 64 && (mask->small >> tag & 1) == 0)
+    return NULL;
+
+  for(uint32_t i = 0; i < mask->count; ++i)
+    if(mask->entries[i].tag == tag) return &mask->entries[i];
+
+  return NULL;
+}
+
+/**
+ * @brief get the fields of a protobuf struct in a field mask from a
+ * linear (attached) buffer, the rules are the same as
+ * bytelizer_get_pbstruct_ex, the fields out of the mask keep their values
+ * @param ctx the bytelizer context
+ * @param pbroot the protobuf struct to be filled
+ * @param mask the field mask
+ * @param length the encoded length of the struct
+ * @return false if the data is malformed, the cursor is not moved
+ */
+bool bytelizer_get_pbstruct_masked_ex(bytelizer_ctx_t* ctx, bytelizer_pbfield_t* pbroot,
+const bytelizer_pbmask_t* mask, uint32_t length);
+
+/**
+ * @brief get the fields in a field mask taking the rest of the buffer
+ * @param ctx the bytelizer context
+ * @param pbroot the protobuf struct to be filled
+ * @param mask the field mask
+ */
+#define bytelizer_get_pbstruct_masked(ctx, pbroot, mask) \
+  bytelizer_get_pbstruct_masked_ex(ctx, pbroot, mask, bytelizer_remain(ctx))
+
+#endif /* _BYTELIZER_PBMASK_H */
@@ -0,0 +1,554 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "debug/log.h"
+#include "codec.h"
+#include "varint.h"
+#include "bitwise.h"
+#include "protobuf.h"
+#include "pbnative.h"
+
+// the varint on the wire of a scalar member
+_inline static uint64_t __pbnative_varint(const bytelizer_pbdesc_field_t* field, const uint8_t* member) {
+
+  if(field->width == sizeof(uint64_t)) {
+    uint64_t _value; memcpy(&_value, member, sizeof(uint64_t));
+    return field->scalar == bytelizer_pbscalar_sint64 ? __zigzag_encode64((int64_t)_value) : _value;
+  }
+
+  uint32_t _value; memcpy(&_value, member, sizeof(uint32_t));
+  switch(field->scalar) {
+    case bytelizer_pbscalar_int32: return (uint64_t)(int64_t)(int32_t)_value;
+    case bytelizer_pbscalar_sint32: return __zigzag_encode32((int32_t)_value);
+    default: return _value;
+  }
+}
+
+_inline static uint8_t* __pbnative_fixed(uint8_t* cursor, uint32_t width, const uint8_t* member) {
+
+  if(width == sizeof(uint32_t)) {
+    uint32_t _value; memcpy(&_value, member, sizeof(uint32_t));
+    _value = bitwise_le32(_value);
+    memcpy(cursor, &_value, sizeof(uint32_t));
+    return cursor + sizeof(uint32_t);
+  }
+
+  uint64_t _value; memcpy(&_value, member, sizeof(uint64_t));
+  _value = bitwise_le64(_value);
+  memcpy(cursor, &_value, sizeof(uint64_t));
+  return cursor + sizeof(uint64_t);
+}
+
+// store a scalar member from the wire
+_inline static void __pbnative_store(const bytelizer_pbdesc_field_t* field, uint8_t* member, uint64_t wire) {
+
+  if(field->scalar == bytelizer_pbscalar_sint32) wire = (uint32_t)__zigzag_decode32((uint32_t)wire);
+  else if(field->scalar == bytelizer_pbscalar_sint64) wire = (uint64_t)__zigzag_decode64(wire);
+
+  if(field->width == sizeof(uint32_t)) {
+    uint32_t _value = (uint32_t)wire;
+    memcpy(member, &_value, sizeof(uint32_t));
+  }
+  else memcpy(member, &wire, sizeof(uint64_t));
+}
+
+_inline static uint8_t* __pbnative_key(uint8_t* cursor, const bytelizer_pbdesc_field_t* field) {
+  cursor[0] = field->key[0];
+  if(field->key_length > 1) memcpy(cursor + 1, field->key + 1, field->key_length - 1);
+  return cursor + field->key_length;
+}
+
+// a repeated member seen as a repeated field, to share the element loops
+_inline static bytelizer_pbfield_t __pbnative_array(const bytelizer_pbdesc_field_t* field,
+const bytelizer_pbarray_t* array) {
+  return (bytelizer_pbfield_t) {
+    .tag = field->tag,
+    .type = (bytelizer_pbtype_t)field->type,
+    .repeated = true,
+    .scalar = (bytelizer_pbscalar_t)field->scalar,
+    .value.array = { .data = array->data, .count = array->count, .capacity = array->capacity },
+  };
+}
+
+static uint32_t __pbnative_measure(const bytelizer_pbdesc_t* desc, const uint8_t* value, __pbsizes_t* sizes);
+static uint8_t* __pbnative_write(uint8_t* cursor, uint8_t* end,
+const bytelizer_pbdesc_t* desc, const uint8_t* value, __pbsizes_t* sizes);
+
+static uint32_t __pbnative_array_measure(const bytelizer_pbdesc_field_t* field,
+const bytelizer_pbarray_t* array, __pbsizes_t* sizes) {
+
+  uint32_t _count = array->count;
+  if(_count == 0) return 0;
+
+  uint32_t _body = 0;
+
+  if(field->scalar == bytelizer_pbscalar_bytes) {
+    const bytelizer_pbslice_t* _items = array->data;
+    for(uint32_t i = 0; i < _count; ++i)
+      _body += field->key_length + __varint_length(_items[i].length) + _items[i].length;
+    return _body;
+  }
+
+  if(field->scalar == bytelizer_pbscalar_message) {
+    const uint8_t* _items = array->data;
+    for(uint32_t i = 0; i < _count; ++i) {
+      uint32_t _slot = __pbsizes_reserve(sizes);
+      uint32_t _size = __pbnative_measure(field->message, _items + (size_t)i * field->message->size, sizes);
+      if(sizes->failed) return 0;
+      sizes->sizes[_slot] = _size;
+      _body += field->key_length + __varint_length(_size) + _size;
+    }
+    return _body;
+  }
+
+  if(__pbscalar_wiretype(field->scalar) == bytelizer_pbtype_varint) {
+    bytelizer_pbfield_t _field = __pbnative_array(field, array);
+    __pbarray_foreach(&_field, false, _body += __varint_length(_wire));
+  }
+  else _body = _count * field->width;
+
+  // packed, a single key and length
+  if(field->type == bytelizer_pbtype_length_delimited) {
+    uint32_t _slot = __pbsizes_reserve(sizes);
+    if(sizes->failed) return 0;
+    sizes->sizes[_slot] = _body;
+    return field->key_length + __varint_length(_body) + _body;
+  }
+
+  return _count * field->key_length + _body;
+}
+
+// 1st pass, the sizes from the bottom up
+static uint32_t __pbnative_measure(const bytelizer_pbdesc_t* desc, const uint8_t* value, __pbsizes_t* sizes) {
+
+  uint32_t _size = 0;
+  const bytelizer_pbdesc_field_t* _end = desc->fields + desc->count;
+
+  for(const bytelizer_pbdesc_field_t* _field = desc->fields; _field != _end; ++_field) {
+
+    const uint8_t* _member = value + _field->offset;
+
+    if(_field->repeated) {
+      _size += __pbnative_array_measure(_field, (const bytelizer_pbarray_t *)_member, sizes);
+      if(sizes->failed) return 0;
+      continue;
+    }
+
+    _size += _field->key_length;
+
+    switch(_field->scalar) {
+
+      case bytelizer_pbscalar_bytes: {
+        uint32_t _length = ((const bytelizer_pbslice_t *)_member)->length;
+        _size += __varint_length(_length) + _length;
+        break;
+      }
+
+      // the slot is taken before the children, so the order is the same as writing
+      case bytelizer_pbscalar_message: {
+        uint32_t _slot = __pbsizes_reserve(sizes);
+        uint32_t _body = __pbnative_measure(_field->message, _member, sizes);
+        if(sizes->failed) return 0;
+        sizes->sizes[_slot] = _body;
+        _size += __varint_length(_body) + _body;
+        break;
+      }
+
+      default:
+        if(_field->type == bytelizer_pbtype_varint)
+          _size += __varint_length(__pbnative_varint(_field, _member));
+        else
+          _size += _field->width;
+        break;
+    }
+  }
+
+  return _size;
+}
+
+static uint8_t* __pbnative_array_write(uint8_t* cursor, uint8_t* end,
+const bytelizer_pbdesc_field_t* field, const bytelizer_pbarray_t* array, __pbsizes_t* sizes) {
+
+  uint32_t _count = array->count;
+  if(_count == 0) return cursor;
+
+  if(field->scalar == bytelizer_pbscalar_bytes) {
+    const bytelizer_pbslice_t* _items = array->data;
+    for(uint32_t i = 0; i < _count; ++i) {
+      cursor = __pbnative_key(cursor, field);
+      cursor += __varint_encode(_items[i].length, cursor, end);
+      if(_items[i].length != 0) memcpy(cursor, _items[i].data, _items[i].length);
+      cursor += _items[i].length;
+    }
+    return cursor;
+  }
+
+  if(field->scalar == bytelizer_pbscalar_message) {
+    const uint8_t* _items = array->data;
+    for(uint32_t i = 0; i < _count; ++i) {
+      cursor = __pbnative_key(cursor, field);
+      cursor += __varint_encode(sizes->sizes[sizes->cursor++], cursor, end);
+      cursor = __pbnative_write(cursor, end, field->message, _items + (size_t)i * field->message->size, sizes);
+    }
+    return cursor;
+  }
+
+  bytelizer_pbfield_t _field = __pbnative_array(field, array);
+  bytelizer_pbtype_t _type = __pbscalar_wiretype(field->scalar);
+
+  // one key per element
+  if(field->type != bytelizer_pbtype_length_delimited) {
+
+    if(_type == bytelizer_pbtype_varint) {
+      __pbarray_foreach(&_field, false, {
+        cursor = __pbnative_key(cursor, field);
+        cursor += __varint_encode(_wire, cursor, end);
+      });
+    }
+
+    else {
+      uint32_t _width = field->width;
+      const uint8_t* _items = array->data;
+      for(uint32_t i = 0; i < _count; ++i) {
+        cursor = __pbnative_key(cursor, field);
+        cursor = __pbnative_fixed(cursor, _width, _items + (size_t)i * _width);
+      }
+    }
+
+    return cursor;
+  }
+
+  // packed, the body length is measured already
+  cursor = __pbnative_key(cursor, field);
+  cursor += __varint_encode(sizes->sizes[sizes->cursor++], cursor, end);
+
+  if(_type == bytelizer_pbtype_varint) {
+    __pbarray_foreach(&_field, false, cursor += __varint_encode(_wire, cursor, end));
+    return cursor;
+  }
+
+  uint32_t _width = field->width;
+
+#if BYTELIZER_ENDIANNESS == BYTELIZER_LITTLE_ENDIAN
+  // the fixed elements are the same as in memory
+  memcpy(cursor, array->data, (size_t)_count * _width);
+  return cursor + (size_t)_count * _width;
+#else
+  const uint8_t* _items = array->data;
+  for(uint32_t i = 0; i < _count; ++i)
+    cursor = __pbnative_fixed(cursor, _width, _items + (size_t)i * _width);
+  return cursor;
+#endif
+}
+
+// 2nd pass, straight into the reserved space
+static uint8_t* __pbnative_write(uint8_t* cursor, uint8_t* end,
+const bytelizer_pbdesc_t* desc, const uint8_t* value, __pbsizes_t* sizes) {
+
+  const bytelizer_pbdesc_field_t* _end = desc->fields + desc->count;
+
+  for(const bytelizer_pbdesc_field_t* _field = desc->fields; _field != _end; ++_field) {
+
+    const uint8_t* _member = value + _field->offset;
+
+    if(_field->repeated) {
+      cursor = __pbnative_array_write(cursor, end, _field, (const bytelizer_pbarray_t *)_member, sizes);
+      continue;
+    }
+
+    cursor = __pbnative_key(cursor, _field);
+
+    switch(_field->scalar) {
+
+      case bytelizer_pbscalar_bytes: {
+        const bytelizer_pbslice_t* _slice = (const bytelizer_pbslice_t *)_member;
+        cursor += __varint_encode(_slice->length, cursor, end);
+        if(_slice->length != 0) memcpy(cursor, _slice->data, _slice->length);
+        cursor += _slice->length;
+        break;
+      }
+
+      case bytelizer_pbscalar_message:
+        cursor += __varint_encode(sizes->sizes[sizes->cursor++], cursor, end);
+        cursor = __pbnative_write(cursor, end, _field->message, _member, sizes);
+        break;
+
+      default:
+        if(_field->type == bytelizer_pbtype_varint)
+          cursor += __varint_encode(__pbnative_varint(_field, _member), cursor, end);
+        else
+          cursor = __pbnative_fixed(cursor, _field->width, _member);
+        break;
+    }
+  }
+
+  return cursor;
+}
+
+uint32_t bytelizer_pbnative_size(const bytelizer_pbdesc_t* desc, const void* value) {
+
+  if(desc == NULL || value == NULL) return 0;
+
+  __pbsizes_init(_sizes);
+  uint32_t _size = __pbnative_measure(desc, value, &_sizes);
+  __pbsizes_release(_sizes);
+
+  return _size;
+}
+
+bool bytelizer_put_pbnative(bytelizer_ctx_t* ctx, const bytelizer_pbdesc_t* desc, const void* value) {
+
+  if(desc == NULL || value == NULL) return false;
+
+  bool _result = false;
+  __pbsizes_init(_sizes);
+
+  // measure every message once
+  uint32_t _size = __pbnative_measure(desc, value, &_sizes);
+  if(_sizes.failed) goto release;
+
+  // then the whole struct goes into one linear space
+  if(_size != 0) {
+
+    if(!bytelizer_ensure_available(ctx, _size)) {
+      __bytelizer_log("put protobuf native struct failed, is it out of memory?");
+      goto release;
+    }
+
+    __pbnative_write(ctx->cursor, ctx->cursor + _size, desc, value, &_sizes);
+    bytelizer_update_cursor(ctx, _size);
+  }
+
+  _result = true;
+
+release:
+  __pbsizes_release(_sizes);
+  return _result;
+}
+
+// find the descriptor of a wire tag, the next field is tried first
+_inline static const bytelizer_pbdesc_field_t* __pbnative_find(const bytelizer_pbdesc_t* desc,
+const bytelizer_pbdesc_field_t* hint, uint32_t tag) {
+
+  const bytelizer_pbdesc_field_t* _end = desc->fields + desc->count;
+  if(hint != _end && hint->tag == tag) return hint;
+
+  for(const bytelizer_pbdesc_field_t* _field = desc->fields; _field != _end; ++_field)
+    if(_field->tag == tag) return _field;
+
+  return NULL;
+}
+
+// append an element to a repeated member
+_inline static bool __pbnative_push(const bytelizer_pbdesc_field_t* field, bytelizer_pbarray_t* array, uint64_t wire) {
+
+  if(array->count >= array->capacity) {
+    __bytelizer_log("protobuf repeated tag %u is over the capacity %u", field->tag, array->capacity);
+    return false;
+  }
+
+  __pbnative_store(field, (uint8_t *)array->data + (size_t)array->count++ * field->width, wire);
+  return true;
+}
+
+// empty the repeated members of a struct and its nested structs
+static void __pbnative_reset(const bytelizer_pbdesc_t* desc, uint8_t* value, uint32_t depth) {
+
+  if(depth > BYTELIZER_PBSTRUCT_DEPTH) return;
+
+  const bytelizer_pbdesc_field_t* _end = desc->fields + desc->count;
+
+  for(const bytelizer_pbdesc_field_t* _field = desc->fields; _field != _end; ++_field) {
+    if(_field->repeated) ((bytelizer_pbarray_t *)(value + _field->offset))->count = 0;
+    else if(_field->scalar == bytelizer_pbscalar_message)
+      __pbnative_reset(_field->message, value + _field->offset, depth + 1);
+  }
+}
+
+static bool __pbnative_decode(const uint8_t* cursor, const uint8_t* end,
+const bytelizer_pbdesc_t* desc, uint8_t* value, uint32_t depth) {
+
+  if(depth > BYTELIZER_PBSTRUCT_DEPTH) {
+    __bytelizer_log("protobuf struct is nested too deep");
+    return false;
+  }
+
+  const bytelizer_pbdesc_field_t* _hint = desc->fields;
+  uint64_t _varint;
+  uint32_t _length;
+
+  while(cursor < end) {
+
+    if((_length = __varint_decode(cursor, end, &_varint)) == 0) {
+      __bytelizer_log("truncated protobuf tag");
+      return false;
+    }
+    cursor += _length;
+
+    uint64_t _tag = _varint >> 3;
+    bytelizer_pbtype_t _type = (bytelizer_pbtype_t)(_varint & 0b111);
+
+    if(_tag == 0 || _tag > BYTELIZER_PBTAG_MAX) {
+      __bytelizer_log("invalid protobuf tag %llu", (unsigned long long)_tag);
+      return false;
+    }
+
+    // unknown fields and the ones of another wire type are skipped
+    const bytelizer_pbdesc_field_t* _field = __pbnative_find(desc, _hint, (uint32_t)_tag);
+    if(_field != NULL) {
+
+      // a repeated field may come packed or not
+      if(_type != _field->type && (!_field->repeated || (_type != bytelizer_pbtype_length_delimited &&
+         _type != __pbscalar_wiretype((bytelizer_pbscalar_t)_field->scalar)))) {
+        __bytelizer_log("protobuf tag %u has wire type %d, expected %d",
+          (uint32_t)_tag, _type, _field->type);
+        _field = NULL;
+      }
+      else _hint = _field + 1;
+    }
+
+    if(_field == NULL) {
+      if((cursor = __pbfield_skip(cursor, end, _type)) == NULL) {
+        __bytelizer_log("truncated protobuf field, tag %u", (uint32_t)_tag);
+        return false;
+      }
+      continue;
+    }
+
+    uint8_t* _member = value + _field->offset;
+    bytelizer_pbscalar_t _scalar = (bytelizer_pbscalar_t)_field->scalar;
+
+    // set the value, the last occurrence wins
+    switch(_type) {
+
+      case bytelizer_pbtype_varint:
+        if((_length = __varint_decode(cursor, end, &_varint)) == 0) {
+          __bytelizer_log("truncated protobuf varint, tag %u", (uint32_t)_tag);
+          return false;
+        }
+        cursor += _length;
+        break;
+
+      case bytelizer_pbtype_32bit: {
+        if(end - cursor < (ptrdiff_t)sizeof(uint32_t)) {
+          __bytelizer_log("truncated protobuf fixed32, tag %u", (uint32_t)_tag);
+          return false;
+        }
+        uint32_t _value; memcpy(&_value, cursor, sizeof(uint32_t));
+        _varint = bitwise_le32(_value);
+        cursor += sizeof(uint32_t);
+        break;
+      }
+
+      case bytelizer_pbtype_64bit:
+        if(end - cursor < (ptrdiff_t)sizeof(uint64_t)) {
+          __bytelizer_log("truncated protobuf fixed64, tag %u", (uint32_t)_tag);
+          return false;
+        }
+        memcpy(&_varint, cursor, sizeof(uint64_t));
+        _varint = bitwise_le64(_varint);
+        cursor += sizeof(uint64_t);
+        break;
+
+      case bytelizer_pbtype_length_delimited: {
+
+        if((_length = __varint_decode(cursor, end, &_varint)) == 0) {
+          __bytelizer_log("truncated protobuf length, tag %u", (uint32_t)_tag);
+          return false;
+        }
+        cursor += _length;
+
+        // the body must be inside the parent
+        if(_varint > (uint64_t)(end - cursor)) {
+          __bytelizer_log("protobuf length %llu of tag %u is out of bounds",
+            (unsigned long long)_varint, (uint32_t)_tag);
+          return false;
+        }
+
+        const uint8_t* _body = cursor;
+        cursor += _varint;
+
+        if(!_field->repeated) {
+          // the nested struct is decoded in place, repeated ones are merged
+          if(_scalar == bytelizer_pbscalar_message) {
+            if(!__pbnative_decode(_body, cursor, _field->message, _member, depth + 1)) return false;
+          }
+          // bytes point into the buffer
+          else *(bytelizer_pbslice_t *)_member = (bytelizer_pbslice_t) { .data = _body, .length = (uint32_t)_varint };
+          continue;
+        }
+
+        bytelizer_pbarray_t* _array = (bytelizer_pbarray_t *)_member;
+
+        if(_scalar != bytelizer_pbscalar_bytes && _scalar != bytelizer_pbscalar_message) {
+          bytelizer_pbfield_t _packed = __pbnative_array(_field, _array);
+          if(!__pbarray_decode(_body, cursor, &_packed)) return false;
+          _array->count = _packed.value.array.count;
+          continue;
+        }
+
+        if(_array->count >= _array->capacity) {
+          __bytelizer_log("protobuf repeated tag %u is over the capacity %u", (uint32_t)_tag, _array->capacity);
+          return false;
+        }
+
+        uint32_t _index = _array->count++;
+
+        if(_scalar == bytelizer_pbscalar_bytes) {
+          ((bytelizer_pbslice_t *)_array->data)[_index] = (bytelizer_pbslice_t) { .data = _body, .length = (uint32_t)_varint };
+          continue;
+        }
+
+        // every element is a struct of its own
+        uint8_t* _item = (uint8_t *)_array->data + (size_t)_index * _field->message->size;
+        __pbnative_reset(_field->message, _item, depth + 1);
+        if(!__pbnative_decode(_body, cursor, _field->message, _item, depth + 1)) return false;
+        continue;
+      }
+
+      default:
+        __bytelizer_log("unsupported protobuf wire type %d, tag %u", _type, (uint32_t)_tag);
+        return false;
+    }
+
+    // a scalar from the wire
+    if(!_field->repeated) __pbnative_store(_field, _member, _varint);
+    else if(!__pbnative_push(_field, (bytelizer_pbarray_t *)_member, _varint)) return false;
+  }
+
+  return true;
+}
+
+typedef struct {
+  const bytelizer_pbdesc_t* desc;
+  uint8_t* value;
+} __pbnative_target_t;
+
+static bool __pbnative_get(const uint8_t* data, uint32_t length, void* userdata) {
+
+  __pbnative_target_t* _target = userdata;
+
+  // the repeated members are filled from the beginning, a nested
+  // struct seen again on the wire is merged and keeps appending
+  __pbnative_reset(_target->desc, _target->value, 0);
+  return __pbnative_decode(data, data + length, _target->desc, _target->value, 0);
+}
+
+bool bytelizer_get_pbnative_ex(bytelizer_ctx_t* ctx, const bytelizer_pbdesc_t* desc, void* value, uint32_t length) {
+
+  if(desc == NULL || value == NULL) return false;
+
+  __pbnative_target_t _target = { .desc = desc, .value = value };
+  return __pbstruct_get(ctx, length, __pbnative_get, &_target);
+}
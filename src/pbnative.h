@@ -0,0 +1,232 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#ifndef _BYTELIZER_PBNATIVE_H
+#define _BYTELIZER_PBNATIVE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <bytelizer/common.h>
+
+#include "compiler.h"
+#include "codec.h"
+#include "varint.h"
+#include "protobuf.h"
+
+/*
+  A descriptor is the schema of a plain C struct, built at compile
+  time into static storage. The values are read from and written into
+  the struct itself, the tag bytes are encoded ahead:
+
+    typedef struct {
+      uint32_t weight;
+      float price;
+      bytelizer_pbslice_t name;
+    } apple_t;
+
+    PBDESC(apple, apple_t,
+      PBD_UINT32(1, apple_t, weight),
+      PBD_FLOAT(2, apple_t, price),
+      PBD_STRING(3, apple_t, name),
+    );
+
+    apple_t _apple = { .weight = 30, .price = 0.5f };
+    bytelizer_put_pbnative(ctx, &_pb_desc_apple, &_apple);
+
+  A message member is a struct embedded by value, a repeated member is
+  a bytelizer_pbarray_t over a caller array of the element type, the
+  native structs for repeated messages. The rules of decoding are the
+  same as bytelizer_get_pbstruct_ex.
+*/
+
+// a repeated member of a native struct
+typedef struct {
+  void* data;
+  uint32_t count;
+  uint32_t capacity;
+} bytelizer_pbarray_t;
+
+typedef struct _bytelizer_pbdesc_t bytelizer_pbdesc_t;
+
+typedef struct {
+  // the key on the wire
+  uint8_t key[BYTELIZER_VARINT32_MAX];
+  uint8_t key_length;
+  uint8_t type;
+  uint8_t scalar;
+  // the width of a scalar member
+  uint8_t width;
+  bool repeated;
+  uint32_t tag;
+  // the member in the native struct
+  uint32_t offset;
+  const bytelizer_pbdesc_t* message;
+} bytelizer_pbdesc_field_t;
+
+struct _bytelizer_pbdesc_t {
+  const bytelizer_pbdesc_field_t* fields;
+  uint32_t count;
+  // the native struct size, the stride of a repeated message
+  uint32_t size;
+};
+
+#define __PBKEY_LENGTH(_key) \
+  ((_key) < 1u << 7 ? 1 : (_key) < 1u << 14 ? 2 : (_key) < 1u << 21 ? 3 : (_key) < 1u << 28 ? 4 : 5)
+
+#define __PBKEY_BYTE(_key, _i) \
+  (uint8_t)(((_key) >> (7 * (_i)) & 0x7f) | ((_i) + 1 < __PBKEY_LENGTH(_key) ? 0x80 : 0))
+
+#define __PBKEY(_key) \
+  .key = { __PBKEY_BYTE(_key, 0), __PBKEY_BYTE(_key, 1), __PBKEY_BYTE(_key, 2), \
+           __PBKEY_BYTE(_key, 3), __PBKEY_BYTE(_key, 4) }, \
+  .key_length = __PBKEY_LENGTH(_key)
+
+#define __PBSCALAR_WIDTH(_scalar) \
+  ((_scalar) == bytelizer_pbscalar_uint32 || (_scalar) == bytelizer_pbscalar_int32 || \
+   (_scalar) == bytelizer_pbscalar_sint32 || (_scalar) == bytelizer_pbscalar_fixed32 || \
+   (_scalar) == bytelizer_pbscalar_float ? sizeof(uint32_t) : sizeof(uint64_t))
+
+#define __PBD_FIELD(_tag, _wire, _scalar, _repeated, _type, _member, _desc) \
+  { __PBKEY((uint32_t)(_tag) << 3 | (_wire)), .type = _wire, .scalar = _scalar, .width = __PBSCALAR_WIDTH(_scalar), \
+    .repeated = _repeated, .tag = _tag, .offset = offsetof(_type, _member), .message = _desc }
+
+/**
+ * @brief declare a descriptor
+ * @param _name the name, the descriptor is _pb_desc_##_name
+ * @param _type the native struct
+ * @param ... the fields
+*/
+#define PBDESC(_name, _type, ...) \
+  static const bytelizer_pbdesc_field_t _pb_desc_fields_##_name[] = { __VA_ARGS__ }; \
+  static const bytelizer_pbdesc_t _pb_desc_##_name = { \
+    .fields = _pb_desc_fields_##_name, \
+    .count = sizeof(_pb_desc_fields_##_name) / sizeof(bytelizer_pbdesc_field_t), \
+    .size = sizeof(_type), \
+  }
+
+/**
+ * @brief define a scalar member
+ * @param _tag the field index
+ * @param _type the native struct
+ * @param _member the member, of the C type in the name
+*/
+#define PBD_UINT32(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_varint, bytelizer_pbscalar_uint32, false, _type, _member, NULL)
+#define PBD_UINT64(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_varint, bytelizer_pbscalar_uint64, false, _type, _member, NULL)
+#define PBD_INT32(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_varint, bytelizer_pbscalar_int32, false, _type, _member, NULL)
+#define PBD_INT64(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_varint, bytelizer_pbscalar_int64, false, _type, _member, NULL)
+#define PBD_SINT32(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_varint, bytelizer_pbscalar_sint32, false, _type, _member, NULL)
+#define PBD_SINT64(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_varint, bytelizer_pbscalar_sint64, false, _type, _member, NULL)
+#define PBD_FIXED32(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_32bit, bytelizer_pbscalar_fixed32, false, _type, _member, NULL)
+#define PBD_FIXED64(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_64bit, bytelizer_pbscalar_fixed64, false, _type, _member, NULL)
+#define PBD_FLOAT(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_32bit, bytelizer_pbscalar_float, false, _type, _member, NULL)
+#define PBD_DOUBLE(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_64bit, bytelizer_pbscalar_double, false, _type, _member, NULL)
+
+/**
+ * @brief define a bytes or string member
+ * @param _tag the field index
+ * @param _type the native struct
+ * @param _member the member, bytelizer_pbslice_t
+*/
+#define PBD_BYTES(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_bytes, false, _type, _member, NULL)
+#define PBD_STRING(_tag, _type, _member) PBD_BYTES(_tag, _type, _member)
+
+/**
+ * @brief define a nested message member
+ * @param _tag the field index
+ * @param _type the native struct
+ * @param _member the member, the nested native struct
+ * @param _desc the descriptor of the nested struct
+*/
+#define PBD_MESSAGE(_tag, _type, _member, _desc) \
+  __PBD_FIELD(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_message, false, _type, _member, _desc)
+
+/**
+ * @brief define a repeated member, one tag per element
+ * @param _tag the field index
+ * @param _type the native struct
+ * @param _member the member, bytelizer_pbarray_t
+*/
+#define PBD_REPEATED_UINT32(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_varint, bytelizer_pbscalar_uint32, true, _type, _member, NULL)
+#define PBD_REPEATED_UINT64(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_varint, bytelizer_pbscalar_uint64, true, _type, _member, NULL)
+#define PBD_REPEATED_INT32(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_varint, bytelizer_pbscalar_int32, true, _type, _member, NULL)
+#define PBD_REPEATED_INT64(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_varint, bytelizer_pbscalar_int64, true, _type, _member, NULL)
+#define PBD_REPEATED_SINT32(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_varint, bytelizer_pbscalar_sint32, true, _type, _member, NULL)
+#define PBD_REPEATED_SINT64(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_varint, bytelizer_pbscalar_sint64, true, _type, _member, NULL)
+#define PBD_REPEATED_FIXED32(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_32bit, bytelizer_pbscalar_fixed32, true, _type, _member, NULL)
+#define PBD_REPEATED_FIXED64(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_64bit, bytelizer_pbscalar_fixed64, true, _type, _member, NULL)
+#define PBD_REPEATED_FLOAT(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_32bit, bytelizer_pbscalar_float, true, _type, _member, NULL)
+#define PBD_REPEATED_DOUBLE(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_64bit, bytelizer_pbscalar_double, true, _type, _member, NULL)
+#define PBD_REPEATED_BYTES(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_bytes, true, _type, _member, NULL)
+#define PBD_REPEATED_STRING(_tag, _type, _member) PBD_REPEATED_BYTES(_tag, _type, _member)
+
+/**
+ * @brief define a packed repeated member, all elements in one length-delimited record
+ * @param _tag the field index
+ * @param _type the native struct
+ * @param _member the member, bytelizer_pbarray_t
+*/
+#define PBD_PACKED_UINT32(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_uint32, true, _type, _member, NULL)
+#define PBD_PACKED_UINT64(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_uint64, true, _type, _member, NULL)
+#define PBD_PACKED_INT32(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_int32, true, _type, _member, NULL)
+#define PBD_PACKED_INT64(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_int64, true, _type, _member, NULL)
+#define PBD_PACKED_SINT32(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_sint32, true, _type, _member, NULL)
+#define PBD_PACKED_SINT64(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_sint64, true, _type, _member, NULL)
+#define PBD_PACKED_FIXED32(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_fixed32, true, _type, _member, NULL)
+#define PBD_PACKED_FIXED64(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_fixed64, true, _type, _member, NULL)
+#define PBD_PACKED_FLOAT(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_float, true, _type, _member, NULL)
+#define PBD_PACKED_DOUBLE(_tag, _type, _member) __PBD_FIELD(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_double, true, _type, _member, NULL)
+
+/**
+ * @brief define a repeated message member
+ * @param _tag the field index
+ * @param _type the native struct
+ * @param _member the member, bytelizer_pbarray_t over the nested native structs
+ * @param _desc the descriptor of the nested struct
+*/
+#define PBD_REPEATED_MESSAGE(_tag, _type, _member, _desc) \
+  __PBD_FIELD(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_message, true, _type, _member, _desc)
+
+/**
+ * @brief get the encoded size of a native struct
+ * @param desc the descriptor
+ * @param value the native struct
+ */
+uint32_t bytelizer_pbnative_size(const bytelizer_pbdesc_t* desc, const void* value);
+
+/**
+ * @brief put a native struct, measured first then written in a single pass
+ * @param ctx the bytelizer context
+ * @param desc the descriptor
+ * @param value the native struct
+ * @return false if it is out of memory
+ */
+bool bytelizer_put_pbnative(bytelizer_ctx_t* ctx, const bytelizer_pbdesc_t* desc, const void* value);
+
+/**
+ * @brief get a native struct of the given length from a linear (attached)
+ * buffer, the rules are the same as bytelizer_get_pbstruct_ex
+ * @param ctx the bytelizer context
+ * @param desc the descriptor
+ * @param value the native struct to be filled
+ * @param length the encoded length of the struct
+ * @return false if the data is malformed, the cursor is not moved
+ */
+bool bytelizer_get_pbnative_ex(bytelizer_ctx_t* ctx, const bytelizer_pbdesc_t* desc, void* value, uint32_t length);
+
+/**
+ * @brief get a native struct taking the rest of the buffer
+ * @param ctx the bytelizer context
+ * @param desc the descriptor
+ * @param value the native struct to be filled
+ */
+#define bytelizer_get_pbnative(ctx, desc, value) \
+  bytelizer_get_pbnative_ex(ctx, desc, value, bytelizer_remain(ctx))
+
+#endif /* _BYTELIZER_PBNATIVE_H */
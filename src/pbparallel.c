@@ -0,0 +1,384 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "debug/log.h"
+#include "codec.h"
+#include "varint.h"
+#include "protobuf.h"
+#include "pbparallel.h"
+
+typedef struct {
+  // the slice of the repeated field, as a struct of one field
+  bytelizer_pbfield_t chunk[2];
+  // the nested sizes from measuring, for writing
+  __pbsizes_t sizes;
+  uint32_t size;
+  uint8_t* output;
+} __pbparallel_job_t;
+
+typedef bool (*__pbparallel_run_t)(__pbparallel_job_t* job);
+
+struct _bytelizer_pbpool_t {
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_cond_t done;
+  // a single batch at a time
+  pthread_mutex_t batch;
+  pthread_t* threads;
+  uint32_t count;
+
+  // the batch, a thread takes it while it is active
+  __pbparallel_job_t* jobs;
+  uint32_t total;
+  __pbparallel_run_t run;
+  atomic_uint next;
+  uint32_t finished;
+  uint32_t active;
+  uint64_t generation;
+  bool failed;
+  bool stopping;
+};
+
+// run the jobs left, then leave the batch
+static void __pbpool_drain(bytelizer_pbpool_t* pool, __pbparallel_job_t* jobs,
+uint32_t total, __pbparallel_run_t run) {
+
+  uint32_t _finished = 0;
+  bool _failed = false;
+
+  for(;;) {
+    uint32_t _index = atomic_fetch_add_explicit(&pool->next, 1, memory_order_relaxed);
+    if(_index >= total) break;
+    if(!run(&jobs[_index])) _failed = true;
+    ++_finished;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->finished += _finished;
+  pool->failed |= _failed;
+  if(--pool->active == 0) pthread_cond_broadcast(&pool->done);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+static void* __pbpool_worker(void* userdata) {
+
+  bytelizer_pbpool_t* _pool = userdata;
+  uint64_t _seen = 0;
+
+  pthread_mutex_lock(&_pool->lock);
+
+  for(;;) {
+
+    while(!_pool->stopping && _pool->generation == _seen)
+      pthread_cond_wait(&_pool->wake, &_pool->lock);
+
+    if(_pool->stopping) break;
+
+    // the batch is taken under the lock, it is not replaced while we are active
+    _seen = _pool->generation;
+    ++_pool->active;
+    __pbparallel_job_t* _jobs = _pool->jobs;
+    uint32_t _total = _pool->total;
+    __pbparallel_run_t _run = _pool->run;
+
+    pthread_mutex_unlock(&_pool->lock);
+    __pbpool_drain(_pool, _jobs, _total, _run);
+    pthread_mutex_lock(&_pool->lock);
+  }
+
+  pthread_mutex_unlock(&_pool->lock);
+  return NULL;
+}
+
+// run a batch on the threads and the caller, false if a job failed
+static bool __pbpool_run(bytelizer_pbpool_t* pool, __pbparallel_job_t* jobs,
+uint32_t total, __pbparallel_run_t run) {
+
+  pthread_mutex_lock(&pool->batch);
+  pthread_mutex_lock(&pool->lock);
+
+  // a late thread may still be leaving the last batch
+  while(pool->active != 0) pthread_cond_wait(&pool->done, &pool->lock);
+
+  pool->jobs = jobs;
+  pool->total = total;
+  pool->run = run;
+  atomic_store_explicit(&pool->next, 0, memory_order_relaxed);
+  pool->finished = 0;
+  pool->failed = false;
+  pool->active = 1;
+  ++pool->generation;
+
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+
+  __pbpool_drain(pool, jobs, total, run);
+
+  pthread_mutex_lock(&pool->lock);
+  while(pool->finished < total || pool->active != 0)
+    pthread_cond_wait(&pool->done, &pool->lock);
+  bool _result = !pool->failed;
+  pthread_mutex_unlock(&pool->lock);
+
+  pthread_mutex_unlock(&pool->batch);
+  return _result;
+}
+
+bytelizer_pbpool_t* bytelizer_pbpool_create(uint32_t threads) {
+
+  bytelizer_pbpool_t* _pool = calloc(1, sizeof(bytelizer_pbpool_t));
+  if(_pool == NULL) return NULL;
+
+  _pool->threads = calloc(threads ? threads : 1, sizeof(pthread_t));
+  if(_pool->threads == NULL) {
+    free(_pool);
+    return NULL;
+  }
+
+  pthread_mutex_init(&_pool->lock, NULL);
+  pthread_mutex_init(&_pool->batch, NULL);
+  pthread_cond_init(&_pool->wake, NULL);
+  pthread_cond_init(&_pool->done, NULL);
+  atomic_init(&_pool->next, 0);
+
+  for(; _pool->count < threads; ++_pool->count) {
+    if(pthread_create(&_pool->threads[_pool->count], NULL, __pbpool_worker, _pool) != 0) {
+      __bytelizer_log("creating the protobuf encoding thread %u failed", _pool->count);
+      bytelizer_pbpool_destroy(_pool);
+      return NULL;
+    }
+  }
+
+  return _pool;
+}
+
+void bytelizer_pbpool_destroy(bytelizer_pbpool_t* pool) {
+
+  if(pool == NULL) return;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = true;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+
+  for(uint32_t i = 0; i < pool->count; ++i)
+    pthread_join(pool->threads[i], NULL);
+
+  pthread_cond_destroy(&pool->done);
+  pthread_cond_destroy(&pool->wake);
+  pthread_mutex_destroy(&pool->batch);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->threads);
+  free(pool);
+}
+
+// the chunks of the split fields, in the order of writing
+typedef struct {
+  __pbparallel_job_t* jobs;
+  uint32_t count;
+  uint32_t capacity;
+  uint32_t cursor;
+  uint32_t threads;
+} __pbplan_t;
+
+// the chunks of a repeated message field, 0 if it is put serially
+_inline static uint32_t __pbparallel_chunks(const bytelizer_pbfield_t* field, uint32_t threads) {
+
+  if(!field->repeated || field->scalar != bytelizer_pbscalar_message) return 0;
+
+  uint32_t _chunks = field->value.array.count / BYTELIZER_PBPARALLEL_CHUNK;
+  uint32_t _limit = (threads + 1) * BYTELIZER_PBPARALLEL_SPLIT;
+
+  if(_chunks < 2) return 0;
+  return _chunks < _limit ? _chunks : _limit;
+}
+
+static bool __pbparallel_plan(const bytelizer_pbfield_t* field, __pbplan_t* plan, uint32_t depth) {
+
+  if(depth > BYTELIZER_PBSTRUCT_DEPTH) {
+    __bytelizer_log("protobuf struct is nested too deep");
+    return false;
+  }
+
+  for(; field->tag != 0; ++field) {
+
+    if(!field->repeated && field->subtags && field->value.message != NULL) {
+      if(!__pbparallel_plan(field->value.message, plan, depth + 1)) return false;
+      continue;
+    }
+
+    uint32_t _chunks = __pbparallel_chunks(field, plan->threads);
+    if(_chunks == 0) continue;
+
+    if(plan->count + _chunks > plan->capacity) {
+      uint32_t _capacity = plan->capacity ? plan->capacity * 2 : 64;
+      while(_capacity < plan->count + _chunks) _capacity *= 2;
+
+      __pbparallel_job_t* _jobs = realloc(plan->jobs, _capacity * sizeof(__pbparallel_job_t));
+      if(_jobs == NULL) {
+        __bytelizer_log("protobuf parallel plan is out of memory");
+        return false;
+      }
+      plan->jobs = _jobs;
+      plan->capacity = _capacity;
+    }
+
+    // the elements are spread evenly over the chunks
+    bytelizer_pbfield_t* const* _items = field->value.array.data;
+    uint32_t _count = field->value.array.count;
+
+    for(uint32_t i = 0; i < _chunks; ++i) {
+      uint32_t _begin = (uint32_t)((uint64_t)_count * i / _chunks);
+      uint32_t _end = (uint32_t)((uint64_t)_count * (i + 1) / _chunks);
+
+      __pbparallel_job_t* _job = &plan->jobs[plan->count++];
+      _job->chunk[0] = *field;
+      _job->chunk[0].value.array.data = (void *)(_items + _begin);
+      _job->chunk[0].value.array.count = _end - _begin;
+      _job->chunk[0].value.array.capacity = _end - _begin;
+      _job->chunk[1] = (bytelizer_pbfield_t) { .tag = 0 };
+      _job->sizes.sizes = NULL;
+      _job->size = 0;
+      _job->output = NULL;
+    }
+  }
+
+  return true;
+}
+
+// the sizes are kept with the job, it is not moved after planning
+static bool __pbparallel_measure(__pbparallel_job_t* job) {
+  job->sizes = (__pbsizes_t) { .sizes = job->sizes.stack, .capacity = BYTELIZER_PBSTRUCT_SIZES };
+  job->size = __pbstruct_measure_sizes(job->chunk, &job->sizes);
+  return !job->sizes.failed;
+}
+
+static bool __pbparallel_encode(__pbparallel_job_t* job) {
+  __pbstruct_write_sizes(job->output, job->output + job->size, job->chunk, &job->sizes);
+  return true;
+}
+
+// the size of a struct around its measured chunks, the other nested sizes
+// go into the shared table in the order of writing
+static uint32_t __pbparallel_size(const bytelizer_pbfield_t* field, __pbplan_t* plan, __pbsizes_t* sizes) {
+
+  uint32_t _size = 0;
+
+  for(; field->tag != 0; ++field) {
+
+    uint32_t _chunks = __pbparallel_chunks(field, plan->threads);
+    if(_chunks != 0) {
+      for(uint32_t i = 0; i < _chunks; ++i) _size += plan->jobs[plan->cursor++].size;
+      continue;
+    }
+
+    if(!field->repeated && field->subtags && field->value.message != NULL) {
+      uint32_t _slot = __pbsizes_reserve(sizes);
+      if(sizes->failed) return 0;
+
+      uint32_t _body = __pbparallel_size(field->value.message, plan, sizes);
+      if(sizes->failed) return 0;
+      sizes->sizes[_slot] = _body;
+      _size += __varint_length(field->tag << 3 | field->type) + __varint_length(_body) + _body;
+      continue;
+    }
+
+    // the rest is measured as a struct of one field
+    bytelizer_pbfield_t _field[2] = { *field, { .tag = 0 } };
+    _size += __pbstruct_measure_sizes(_field, sizes);
+    if(sizes->failed) return 0;
+  }
+
+  return _size;
+}
+
+// write a struct around its chunks, the chunks get their places
+static uint8_t* __pbparallel_write(uint8_t* cursor, uint8_t* end,
+const bytelizer_pbfield_t* field, __pbplan_t* plan, __pbsizes_t* sizes) {
+
+  for(; field->tag != 0; ++field) {
+
+    uint32_t _chunks = __pbparallel_chunks(field, plan->threads);
+    if(_chunks != 0) {
+      for(uint32_t i = 0; i < _chunks; ++i) {
+        __pbparallel_job_t* _job = &plan->jobs[plan->cursor++];
+        _job->output = cursor;
+        cursor += _job->size;
+      }
+      continue;
+    }
+
+    if(!field->repeated && field->subtags && field->value.message != NULL) {
+      cursor += __varint_encode(field->tag << 3 | field->type, cursor, end);
+      cursor += __varint_encode(sizes->sizes[sizes->cursor++], cursor, end);
+      cursor = __pbparallel_write(cursor, end, field->value.message, plan, sizes);
+      continue;
+    }
+
+    bytelizer_pbfield_t _field[2] = { *field, { .tag = 0 } };
+    cursor = __pbstruct_write_sizes(cursor, end, _field, sizes);
+  }
+
+  return cursor;
+}
+
+bool bytelizer_put_pbstruct_parallel(bytelizer_ctx_t* ctx, const bytelizer_pbfield_t* pbroot,
+bytelizer_pbpool_t* pool) {
+
+  if(pbroot == NULL) return false;
+
+  bool _result = false;
+  uint32_t _size;
+  __pbplan_t _plan = { .threads = pool != NULL ? pool->count : 0 };
+  __pbsizes_init(_sizes);
+
+  if(pool != NULL && !__pbparallel_plan(pbroot, &_plan, 0))
+    goto release;
+
+  // nothing is large enough, the threads are not woken
+  if(_plan.count == 0) {
+    _result = __pbstruct_put(ctx, pbroot, false);
+    goto release;
+  }
+
+  // the chunks are measured first, then the struct around them
+  if(!__pbpool_run(pool, _plan.jobs, _plan.count, __pbparallel_measure)) goto failure;
+
+  _size = __pbparallel_size(pbroot, &_plan, &_sizes);
+  if(_sizes.failed) goto failure;
+
+  // the whole struct goes into one linear space, every chunk writes its own part
+  if(!bytelizer_ensure_available(ctx, _size)) goto failure;
+
+  _plan.cursor = 0;
+  __pbparallel_write(ctx->cursor, ctx->cursor + _size, pbroot, &_plan, &_sizes);
+  if(!__pbpool_run(pool, _plan.jobs, _plan.count, __pbparallel_encode)) goto failure;
+
+  bytelizer_update_cursor(ctx, _size);
+  _result = true;
+  goto release;
+
+failure:
+  __bytelizer_log("put protobuf struct in parallel failed, is it out of memory?");
+
+release:
+  __pbsizes_release(_sizes);
+
+  for(uint32_t i = 0; i < _plan.count; ++i)
+    if(_plan.jobs[i].sizes.sizes != NULL) __pbsizes_release(_plan.jobs[i].sizes);
+  free(_plan.jobs);
+  return _result;
+}
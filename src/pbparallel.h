@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#ifndef _BYTELIZER_PBPARALLEL_H
+#define _BYTELIZER_PBPARALLEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <bytelizer/common.h>
+
+#include "compiler.h"
+#include "codec.h"
+#include "protobuf.h"
+
+/*
+  A large repeated message field is split into chunks encoded by the
+  threads of a pool, straight into their places in the output:
+
+    bytelizer_pbpool_t* pool = bytelizer_pbpool_create(4);
+    ...
+    bytelizer_put_pbstruct_parallel(ctx, export, pool);
+    ...
+    bytelizer_pbpool_destroy(pool);
+
+  The chunks are measured in parallel first, then the space of the
+  whole struct is reserved and the chunks are written at their offsets
+  while the rest of the struct is written around them. The repeated
+  message fields of the root and of its nested messages are split,
+  a struct without a field over the threshold is put serially.
+*/
+
+// the least elements of a chunk, a field of fewer than two chunks is put serially
+#ifndef BYTELIZER_PBPARALLEL_CHUNK
+  #define BYTELIZER_PBPARALLEL_CHUNK 512
+#endif
+
+// the chunks of a field for each thread, to balance uneven elements
+#define BYTELIZER_PBPARALLEL_SPLIT 4
+
+typedef struct _bytelizer_pbpool_t bytelizer_pbpool_t;
+
+/**
+ * @brief create a pool of encoding threads
+ * @param threads the count of threads, the caller thread works too
+ * @return the pool, NULL if the threads can not be created
+ */
+bytelizer_pbpool_t* bytelizer_pbpool_create(uint32_t threads);
+
+/**
+ * @brief stop the threads and release a pool
+ * @param pool the pool
+ */
+void bytelizer_pbpool_destroy(bytelizer_pbpool_t* pool);
+
+/**
+ * @brief put a protobuf struct, the large repeated message fields are
+ * encoded by the threads of a pool, the output is the same as
+ * bytelizer_put_pbstruct. The struct must not change while it is put.
+ * @param ctx the bytelizer context
+ * @param pbroot the protobuf struct
+ * @param pool the pool, NULL to put serially
+ * @return false if it is out of memory, nothing is put
+ */
+bool bytelizer_put_pbstruct_parallel(bytelizer_ctx_t* ctx, const bytelizer_pbfield_t* pbroot,
+bytelizer_pbpool_t* pool);
+
+#endif /* _BYTELIZER_PBPARALLEL_H */
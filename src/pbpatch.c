@@ -0,0 +1,357 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "debug/log.h"
+#include "codec.h"
+#include "advanced.h"
+#include "varint.h"
+#include "protobuf.h"
+#include "pbpatch.h"
+
+// an occurrence of a patched field, found by the scanning pass
+typedef struct {
+  const uint8_t* field;
+  // after the key
+  const uint8_t* value;
+  // the body of a nested message to be patched, NULL if it is replaced
+  const uint8_t* body;
+  const uint8_t* end;
+  uint32_t index;
+  // the patched length of the body
+  uint32_t size;
+  // the records inside the body
+  uint32_t records;
+  // the node of the body
+  uint32_t node;
+  // the field is put here, the later occurrences are dropped
+  bool put;
+} __pbpatch_record_t;
+
+// a patched message, its occurrences on the wire are merged into one
+typedef struct {
+  uint32_t parent;
+  uint32_t index;
+  // the fields put in any of the occurrences
+  uint64_t written;
+  // the record of the last occurrence, the missing fields go there
+  uint32_t last;
+} __pbpatch_node_t;
+
+typedef struct {
+  __pbpatch_record_t* records;
+  uint32_t count;
+  uint32_t capacity;
+  __pbpatch_node_t nodes[BYTELIZER_PBPATCH_NODES];
+  uint32_t node_count;
+  __pbpatch_record_t stack[BYTELIZER_PBPATCH_RECORDS];
+} __pbpatch_t;
+
+static bool __pbpatch_reserve(__pbpatch_t* patch, uint32_t* slot) {
+
+  if(patch->count == patch->capacity) {
+    uint32_t _capacity = patch->capacity * 2;
+    __pbpatch_record_t* _records = patch->records == patch->stack
+      ? malloc(_capacity * sizeof(__pbpatch_record_t))
+      : realloc(patch->records, _capacity * sizeof(__pbpatch_record_t));
+
+    if(_records == NULL) {
+      __bytelizer_log("protobuf patch is out of memory");
+      return false;
+    }
+
+    if(patch->records == patch->stack)
+      memcpy(_records, patch->stack, patch->count * sizeof(__pbpatch_record_t));
+
+    patch->records = _records;
+    patch->capacity = _capacity;
+  }
+
+  *slot = patch->count++;
+  return true;
+}
+
+// the node of a nested patch field, the same one for each occurrence
+static bool __pbpatch_node(__pbpatch_t* patch, uint32_t parent, uint32_t index, uint32_t* node) {
+
+  for(uint32_t i = 0; i < patch->node_count; ++i) {
+    if(patch->nodes[i].parent == parent && patch->nodes[i].index == index) {
+      *node = i;
+      return true;
+    }
+  }
+
+  if(patch->node_count == BYTELIZER_PBPATCH_NODES) {
+    __bytelizer_log("protobuf patch has over %u nested messages", BYTELIZER_PBPATCH_NODES);
+    return false;
+  }
+
+  *node = patch->node_count++;
+  patch->nodes[*node] = (__pbpatch_node_t) { .parent = parent, .index = index, .last = UINT32_MAX };
+  return true;
+}
+
+// the fields appended to a nested body, only the last occurrence takes them
+_inline static uint64_t __pbpatch_append(const __pbpatch_t* patch, uint32_t slot) {
+  const __pbpatch_node_t* _node = &patch->nodes[patch->records[slot].node];
+  return _node->last == slot ? ~_node->written : 0;
+}
+
+// a field of the patch by its own
+static uint32_t __pbpatch_put(bytelizer_ctx_t* ctx, const bytelizer_pbfield_t* field) {
+
+  // the scalars are written here, the rest as a struct of one field
+  if(field->repeated || field->subtags) {
+    bytelizer_pbfield_t _struct[2] = { *field, { 0 } };
+
+    if(ctx == NULL) return bytelizer_pbstruct_size(_struct);
+
+    bytelizer_put_pbstruct(ctx, _struct);
+    return 0;
+  }
+
+  uint64_t _key = (uint64_t)field->tag << 3 | field->type;
+  uint32_t _size = __varint_length(_key);
+
+  switch(field->type) {
+    case bytelizer_pbtype_varint: _size += __varint_length(__pbfield_varint(field)); break;
+    case bytelizer_pbtype_32bit: _size += sizeof(uint32_t); break;
+    case bytelizer_pbtype_64bit: _size += sizeof(uint64_t); break;
+    case bytelizer_pbtype_length_delimited:
+      _size += __varint_length(field->value.length_delimited.length) + field->value.length_delimited.length;
+      break;
+    default:
+      return 0;
+  }
+
+  if(ctx == NULL) return _size;
+
+  bytelizer_put_varint(ctx, _key);
+
+  switch(field->type) {
+    case bytelizer_pbtype_varint: bytelizer_put_varint(ctx, __pbfield_varint(field)); break;
+    case bytelizer_pbtype_32bit: bytelizer_put_uint32_le(ctx, field->value.fixed32); break;
+    case bytelizer_pbtype_64bit: bytelizer_put_uint64_le(ctx, field->value.fixed64); break;
+    default:
+      bytelizer_put_varint(ctx, field->value.length_delimited.length);
+      bytelizer_put_bytes(ctx, field->value.length_delimited.data, field->value.length_delimited.length);
+      break;
+  }
+
+  return _size;
+}
+
+_inline static void __pbpatch_copy(bytelizer_ctx_t* ctx, const uint8_t* begin, const uint8_t* end) {
+  if(ctx != NULL && end != begin) bytelizer_put_bytes(ctx, begin, (uint32_t)(end - begin));
+}
+
+// find the patched fields of a message, the nested ones of the same node share what is written
+static bool __pbpatch_scan(__pbpatch_t* state, const uint8_t* cursor, const uint8_t* end,
+const bytelizer_pbfield_t* patch, uint32_t node, uint32_t depth) {
+
+  if(depth > BYTELIZER_PBSTRUCT_DEPTH) {
+    __bytelizer_log("protobuf struct is nested too deep");
+    return false;
+  }
+
+  uint32_t _fields = 0;
+  while(patch[_fields].tag != 0) ++_fields;
+
+  if(_fields > BYTELIZER_PBPATCH_FIELDS) {
+    __bytelizer_log("protobuf patch has over %u fields", BYTELIZER_PBPATCH_FIELDS);
+    return false;
+  }
+
+  while(cursor < end) {
+
+    const uint8_t* _field = cursor;
+    uint64_t _key;
+    uint32_t _length;
+
+    if((_length = __varint_decode(cursor, end, &_key)) == 0 ||
+       (_key >> 3) == 0 || (_key >> 3) > BYTELIZER_PBTAG_MAX) {
+      __bytelizer_log("invalid protobuf tag");
+      return false;
+    }
+    cursor += _length;
+
+    const uint8_t* _value = cursor;
+    bytelizer_pbtype_t _type = (bytelizer_pbtype_t)(_key & 0b111);
+
+    if((cursor = __pbfield_skip(cursor, end, _type)) == NULL) {
+      __bytelizer_log("truncated protobuf field, tag %u", (uint32_t)(_key >> 3));
+      return false;
+    }
+
+    // the unknown fields are copied with the untouched bytes
+    uint32_t _index = 0;
+    while(_index < _fields && patch[_index].tag != (_key >> 3)) ++_index;
+    if(_index == _fields) continue;
+
+    const bytelizer_pbfield_t* _patch = &patch[_index];
+    uint32_t _slot;
+
+    if(!__pbpatch_reserve(state, &_slot)) return false;
+    state->records[_slot] = (__pbpatch_record_t) {
+      .field = _field, .value = _value, .body = NULL, .end = cursor, .index = _index,
+    };
+
+    // the nested message is patched in place, with its length rewritten
+    if(!_patch->repeated && _patch->subtags && _patch->value.message != NULL &&
+       _type == bytelizer_pbtype_length_delimited) {
+
+      uint64_t _original;
+      const uint8_t* _body = _value + __varint_decode(_value, cursor, &_original);
+      uint32_t _node;
+
+      if(!__pbpatch_node(state, node, _index, &_node)) return false;
+      state->nodes[_node].last = _slot;
+
+      if(!__pbpatch_scan(state, _body, cursor, _patch->value.message, _node, depth + 1))
+        return false;
+
+      state->records[_slot].body = _body;
+      state->records[_slot].node = _node;
+      state->records[_slot].records = state->count - _slot - 1;
+      state->nodes[node].written |= 1ull << _index;
+      continue;
+    }
+
+    // the first occurrence is replaced, the later ones are dropped
+    if(state->nodes[node].written & (1ull << _index)) continue;
+    state->nodes[node].written |= 1ull << _index;
+    state->records[_slot].put = true;
+  }
+
+  return true;
+}
+
+// measure a patched message by its records, the nested lengths are kept
+static uint32_t __pbpatch_measure(__pbpatch_t* state, uint32_t first, uint32_t last,
+uint32_t length, const bytelizer_pbfield_t* patch, uint64_t append) {
+
+  uint32_t _size = length;
+
+  for(uint32_t i = first; i < last;) {
+
+    __pbpatch_record_t* _record = &state->records[i];
+    const bytelizer_pbfield_t* _patch = &patch[_record->index];
+
+    // the occurrence is not copied
+    _size -= (uint32_t)(_record->end - _record->field);
+
+    if(_record->body != NULL) {
+      _record->size = __pbpatch_measure(state, i + 1, i + 1 + _record->records,
+        (uint32_t)(_record->end - _record->body), _patch->value.message, __pbpatch_append(state, i));
+
+      _size += (uint32_t)(_record->value - _record->field) + __varint_length(_record->size) + _record->size;
+      i += 1 + _record->records;
+      continue;
+    }
+
+    if(_record->put) _size += __pbpatch_put(NULL, _patch);
+    ++i;
+  }
+
+  // the fields not found are appended
+  for(uint32_t i = 0; patch[i].tag != 0; ++i)
+    if(append & (1ull << i)) _size += __pbpatch_put(NULL, &patch[i]);
+
+  return _size;
+}
+
+// put a patched message by its records, the bytes between them are copied
+static void __pbpatch_write(bytelizer_ctx_t* ctx, const __pbpatch_t* state, uint32_t first, uint32_t last,
+const uint8_t* cursor, const uint8_t* end, const bytelizer_pbfield_t* patch, uint64_t append) {
+
+  for(uint32_t i = first; i < last;) {
+
+    const __pbpatch_record_t* _record = &state->records[i];
+    const bytelizer_pbfield_t* _patch = &patch[_record->index];
+
+    __pbpatch_copy(ctx, cursor, _record->field);
+    cursor = _record->end;
+
+    if(_record->body != NULL) {
+      bytelizer_put_bytes(ctx, _record->field, (uint32_t)(_record->value - _record->field));
+      bytelizer_put_varint(ctx, _record->size);
+      __pbpatch_write(ctx, state, i + 1, i + 1 + _record->records,
+        _record->body, _record->end, _patch->value.message, __pbpatch_append(state, i));
+
+      i += 1 + _record->records;
+      continue;
+    }
+
+    if(_record->put) __pbpatch_put(ctx, _patch);
+    ++i;
+  }
+
+  __pbpatch_copy(ctx, cursor, end);
+
+  for(uint32_t i = 0; patch[i].tag != 0; ++i)
+    if(append & (1ull << i)) __pbpatch_put(ctx, &patch[i]);
+}
+
+// the root message is the first node
+#define __pbpatch_init(name) \
+  __pbpatch_t name; \
+  name.records = name.stack; \
+  name.count = 0; \
+  name.capacity = BYTELIZER_PBPATCH_RECORDS; \
+  name.nodes[0] = (__pbpatch_node_t) { .parent = UINT32_MAX, .last = UINT32_MAX }; \
+  name.node_count = 1
+
+#define __pbpatch_release(name) \
+  if(name.records != name.stack) free(name.records)
+
+bool bytelizer_pbpatch_size(const uint8_t* data, uint32_t length,
+const bytelizer_pbfield_t* patch, uint32_t* size) {
+
+  if(patch == NULL) return false;
+
+  __pbpatch_init(_state);
+  bool _result = __pbpatch_scan(&_state, data, data + length, patch, 0, 0);
+  if(_result) *size = __pbpatch_measure(&_state, 0, _state.count, length, patch, ~_state.nodes[0].written);
+  __pbpatch_release(_state);
+
+  return _result;
+}
+
+bool bytelizer_put_pbpatch(bytelizer_ctx_t* ctx, const uint8_t* data, uint32_t length,
+const bytelizer_pbfield_t* patch) {
+
+  if(patch == NULL) return false;
+
+  bool _result = false;
+  uint32_t _size;
+  __pbpatch_init(_state);
+
+  // the occurrences are found and every nested message is measured first
+  if(!__pbpatch_scan(&_state, data, data + length, patch, 0, 0))
+    goto release;
+
+  _size = __pbpatch_measure(&_state, 0, _state.count, length, patch, ~_state.nodes[0].written);
+
+  // then the message goes into one linear space, no field is scanned again
+  if(!bytelizer_ensure_available(ctx, _size)) {
+    __bytelizer_log("put protobuf patch failed, is it out of memory?");
+    goto release;
+  }
+
+  __pbpatch_write(ctx, &_state, 0, _state.count, data, data + length, patch, ~_state.nodes[0].written);
+  _result = true;
+
+release:
+  __pbpatch_release(_state);
+  return _result;
+}
@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#ifndef _BYTELIZER_PBPATCH_H
+#define _BYTELIZER_PBPATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <bytelizer/common.h>
+
+#include "compiler.h"
+#include "codec.h"
+#include "protobuf.h"
+
+/*
+  A patch rewrites some fields of an encoded message, the rest of it
+  is copied byte for byte, unknown fields included:
+
+    bytelizer_pbfield_t patch[] = {
+      PB_VARINT(4, ttl, ttl - 1),
+      PB_MESSAGE(2, route, (PBSTRUCT {
+        PB_VARINT(1, id, next_hop),
+        PB_MESSAGE_END,
+      })),
+      PB_MESSAGE_END,
+    };
+
+    bytelizer_put_pbpatch(ctx, data, length, patch);
+
+  A field of the patch replaces the first occurrence of its tag, the
+  later ones are dropped and a field not found is appended. A repeated
+  field replaces all of its elements, an empty one deletes them.
+  A PB_MESSAGE goes into the nested message and patches it in place,
+  the length prefixes around it are rewritten. The occurrences of a
+  message are patched as the merged one, its fields not found are
+  appended to the last occurrence only. A whole message is replaced
+  by PB_BYTES of its encoding.
+*/
+
+// the fields of a patch at each level
+#define BYTELIZER_PBPATCH_FIELDS 64
+
+// the nested messages of a patch found on the wire
+#define BYTELIZER_PBPATCH_NODES 64
+
+// the patched occurrences kept on the stack before spilling into the heap
+#ifndef BYTELIZER_PBPATCH_RECORDS
+  #define BYTELIZER_PBPATCH_RECORDS 16
+#endif
+
+/**
+ * @brief get the length of a patched message
+ * @param data the encoded message
+ * @param length the length of the message
+ * @param patch the fields to be rewritten
+ * @param size the length of the patched message
+ * @return false if the message is malformed
+ */
+bool bytelizer_pbpatch_size(const uint8_t* data, uint32_t length,
+const bytelizer_pbfield_t* patch, uint32_t* size);
+
+/**
+ * @brief put a patched message, the untouched bytes are copied verbatim
+ * @param ctx the bytelizer context
+ * @param data the encoded message
+ * @param length the length of the message
+ * @param patch the fields to be rewritten
+ * @return false if the message is malformed, nothing is put
+ */
+bool bytelizer_put_pbpatch(bytelizer_ctx_t* ctx, const uint8_t* data, uint32_t length,
+const bytelizer_pbfield_t* patch);
+
+#endif /* _BYTELIZER_PBPATCH_H */
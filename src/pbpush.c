@@ -0,0 +1,417 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "debug/log.h"
+#include "codec.h"
+#include "varint.h"
+#include "bitwise.h"
+#include "protobuf.h"
+#include "pbpush.h"
+
+typedef enum {
+  __pbpush_key = 0,
+  __pbpush_varint,
+  __pbpush_fixed,
+  __pbpush_length,
+  __pbpush_body,
+  __pbpush_skip,
+} __pbpush_state_t;
+
+// read a varint which may be split between the chunks, 0 if it needs more, -1 if it is malformed
+static int __pbpush_read_varint(bytelizer_pbpush_t* push, const uint8_t** cursor,
+const uint8_t* end, uint64_t* value) {
+
+  // most of them are in a single chunk
+  if(push->partial_length == 0) {
+    uint32_t _length = __varint_decode(*cursor, end, value);
+    if(_length != 0) {
+      *cursor += _length;
+      push->consumed += _length;
+      return 1;
+    }
+    if(end - *cursor >= BYTELIZER_VARINT64_MAX) return -1;
+  }
+
+  while(*cursor < end) {
+    uint8_t _byte = *(*cursor)++;
+    ++push->consumed;
+    push->partial[push->partial_length++] = _byte;
+
+    if(_byte < 0x80) {
+      uint32_t _length = push->partial_length;
+      push->partial_length = 0;
+      return __varint_decode(push->partial, push->partial + _length, value) == _length ? 1 : -1;
+    }
+
+    if(push->partial_length == BYTELIZER_VARINT64_MAX) return -1;
+  }
+
+  return 0;
+}
+
+// hand a scalar or an element to the callback
+static bool __pbpush_emit(bytelizer_pbpush_t* push, bytelizer_pbtype_t type, uint64_t wire) {
+
+  const bytelizer_pbfield_t* _schema = push->field;
+  bytelizer_pbfield_t _value = { .tag = _schema->tag, .type = type, .scalar = _schema->scalar };
+
+  switch(type) {
+    case bytelizer_pbtype_varint: __pbfield_set_varint(&_value, wire); break;
+    case bytelizer_pbtype_32bit: _value.value.fixed32 = (uint32_t)wire; break;
+    default: _value.value.fixed64 = wire; break;
+  }
+
+  return push->callback(push->userdata, bytelizer_pbpush_field, _schema, &_value);
+}
+
+// hand a whole body to the callback, a packed field element by element
+static bool __pbpush_emit_body(bytelizer_pbpush_t* push, const uint8_t* body, uint32_t length) {
+
+  const bytelizer_pbfield_t* _schema = push->field;
+
+  if(!_schema->repeated || _schema->scalar == bytelizer_pbscalar_bytes) {
+    bytelizer_pbfield_t _value = {
+      .tag = _schema->tag,
+      .type = bytelizer_pbtype_length_delimited,
+      .scalar = _schema->scalar,
+      .value.length_delimited = { .length = length, .data = (uint8_t *)body },
+    };
+    return push->callback(push->userdata, bytelizer_pbpush_field, _schema, &_value);
+  }
+
+  bytelizer_pbtype_t _type = __pbscalar_wiretype(_schema->scalar);
+  const uint8_t* _end = body + length;
+
+  while(body < _end) {
+
+    uint64_t _wire;
+
+    if(_type == bytelizer_pbtype_varint) {
+      uint32_t _length = __varint_decode(body, _end, &_wire);
+      if(_length == 0) {
+        __bytelizer_log("truncated packed varint, tag %u", _schema->tag);
+        return false;
+      }
+      body += _length;
+    }
+
+    else if(_type == bytelizer_pbtype_32bit && _end - body >= (ptrdiff_t)sizeof(uint32_t)) {
+      uint32_t _value; memcpy(&_value, body, sizeof(uint32_t));
+      _wire = bitwise_le32(_value);
+      body += sizeof(uint32_t);
+    }
+
+    else if(_type == bytelizer_pbtype_64bit && _end - body >= (ptrdiff_t)sizeof(uint64_t)) {
+      memcpy(&_wire, body, sizeof(uint64_t));
+      _wire = bitwise_le64(_wire);
+      body += sizeof(uint64_t);
+    }
+
+    else {
+      __bytelizer_log("packed fixed field %u is not aligned", _schema->tag);
+      return false;
+    }
+
+    if(!__pbpush_emit(push, _type, _wire)) return false;
+  }
+
+  return true;
+}
+
+// find the schema of a wire key, NULL if the field is skipped
+static const bytelizer_pbfield_t* __pbpush_find(__pbpush_frame_t* frame, uint32_t tag, bytelizer_pbtype_t type) {
+
+  if(frame->schema == NULL) return NULL;
+
+  const bytelizer_pbfield_t* _field = NULL;
+
+  if(frame->hint->tag == tag) _field = frame->hint;
+  else {
+    for(const bytelizer_pbfield_t* _item = frame->schema; _item->tag != 0; ++_item)
+      if(_item->tag == tag) { _field = _item; break; }
+  }
+
+  if(_field == NULL) return NULL;
+
+  // a repeated field may come packed or not
+  if(_field->repeated ? type != __pbscalar_wiretype(_field->scalar) && type != bytelizer_pbtype_length_delimited
+                      : type != _field->type) {
+    __bytelizer_log("protobuf tag %u has wire type %d, expected %d", tag, type, _field->type);
+    return NULL;
+  }
+
+  frame->hint = _field[1].tag != 0 ? _field + 1 : frame->schema;
+  return _field;
+}
+
+// the schema of a nested message, the first element of a repeated one
+_inline static const bytelizer_pbfield_t* __pbpush_schema(const bytelizer_pbfield_t* field) {
+
+  if(!field->repeated) return field->value.message;
+
+  bytelizer_pbfield_t* const* _items = field->value.array.data;
+  return _items != NULL && field->value.array.capacity != 0 ? _items[0] : NULL;
+}
+
+// the nested messages ending here are closed
+static bool __pbpush_close(bytelizer_pbpush_t* push) {
+
+  while(push->depth != 0) {
+
+    __pbpush_frame_t* _frame = &push->frames[push->depth];
+
+    if(push->consumed < _frame->end) return true;
+    if(push->consumed > _frame->end) {
+      __bytelizer_log("protobuf field crosses the end of its message, tag %u", _frame->field->tag);
+      return false;
+    }
+
+    --push->depth;
+    if(!push->callback(push->userdata, bytelizer_pbpush_end, _frame->field, NULL)) return false;
+  }
+
+  return true;
+}
+
+static bool __pbpush_key_read(bytelizer_pbpush_t* push, uint64_t key) {
+
+  uint64_t _tag = key >> 3;
+  bytelizer_pbtype_t _type = (bytelizer_pbtype_t)(key & 0b111);
+
+  if(_tag == 0 || _tag > BYTELIZER_PBTAG_MAX) {
+    __bytelizer_log("invalid protobuf tag %llu", (unsigned long long)_tag);
+    return false;
+  }
+
+  push->type = _type;
+  push->field = __pbpush_find(&push->frames[push->depth], (uint32_t)_tag, _type);
+
+  switch(_type) {
+    case bytelizer_pbtype_varint: push->state = __pbpush_varint; return true;
+    case bytelizer_pbtype_32bit: push->state = __pbpush_fixed; push->pending = sizeof(uint32_t); return true;
+    case bytelizer_pbtype_64bit: push->state = __pbpush_fixed; push->pending = sizeof(uint64_t); return true;
+    case bytelizer_pbtype_length_delimited: push->state = __pbpush_length; return true;
+    default:
+      __bytelizer_log("unsupported protobuf wire type %d, tag %u", _type, (uint32_t)_tag);
+      return false;
+  }
+}
+
+// a length read, the body is entered, handed, copied or skipped
+static bool __pbpush_length_read(bytelizer_pbpush_t* push, const uint8_t** cursor,
+const uint8_t* end, uint64_t length) {
+
+  const bytelizer_pbfield_t* _field = push->field;
+
+  // the body must be inside the parent
+  if(length > push->frames[push->depth].end - push->consumed) {
+    __bytelizer_log("protobuf length %llu is out of bounds", (unsigned long long)length);
+    return false;
+  }
+
+  push->state = __pbpush_key;
+
+  if(_field == NULL) {
+    push->state = __pbpush_skip;
+    push->pending = length;
+    return true;
+  }
+
+  // a nested message is read in place
+  if(_field->subtags) {
+
+    if(push->depth == BYTELIZER_PBSTRUCT_DEPTH) {
+      __bytelizer_log("protobuf struct is nested too deep");
+      return false;
+    }
+
+    const bytelizer_pbfield_t* _schema = __pbpush_schema(_field);
+    push->frames[++push->depth] = (__pbpush_frame_t) {
+      .schema = _schema,
+      .hint = _schema,
+      .field = _field,
+      .end = push->consumed + length,
+    };
+
+    return push->callback(push->userdata, bytelizer_pbpush_begin, _field, NULL);
+  }
+
+  // the whole body is in the chunk, it is not copied
+  if(length <= (uint64_t)(end - *cursor)) {
+    const uint8_t* _body = *cursor;
+    *cursor += length;
+    push->consumed += length;
+    return __pbpush_emit_body(push, _body, (uint32_t)length);
+  }
+
+  if(length > push->limit) {
+    __bytelizer_log("protobuf body of %llu bytes is over the limit %u", (unsigned long long)length, push->limit);
+    return false;
+  }
+
+  if(length > push->capacity) {
+    uint8_t* _buffer = realloc(push->buffer, (size_t)length);
+    if(_buffer == NULL) {
+      __bytelizer_log("protobuf push buffer is out of memory");
+      return false;
+    }
+    push->buffer = _buffer;
+    push->capacity = (uint32_t)length;
+  }
+
+  push->state = __pbpush_body;
+  push->buffered = 0;
+  push->pending = length;
+  return true;
+}
+
+bool bytelizer_pbpush_feed(bytelizer_pbpush_t* push, const uint8_t* data, uint32_t length) {
+
+  if(push->failed) return false;
+
+  const uint8_t* _cursor = data;
+  const uint8_t* _end = data + length;
+
+  for(;;) {
+
+    if(push->state == __pbpush_key && !__pbpush_close(push)) goto failure;
+    if(_cursor == _end) return true;
+
+    switch((__pbpush_state_t)push->state) {
+
+      case __pbpush_key:
+      case __pbpush_varint:
+      case __pbpush_length: {
+
+        uint64_t _value = 0;
+        int _result = __pbpush_read_varint(push, &_cursor, _end, &_value);
+
+        if(_result == 0) return true;
+        if(_result < 0) {
+          __bytelizer_log("malformed protobuf varint");
+          goto failure;
+        }
+
+        if(push->state == __pbpush_key) {
+          if(!__pbpush_key_read(push, _value)) goto failure;
+        }
+
+        else if(push->state == __pbpush_varint) {
+          push->state = __pbpush_key;
+          if(push->field != NULL && !__pbpush_emit(push, bytelizer_pbtype_varint, _value)) goto failure;
+        }
+
+        else if(!__pbpush_length_read(push, &_cursor, _end, _value)) goto failure;
+        break;
+      }
+
+      case __pbpush_fixed: {
+
+        uint64_t _wire;
+        uint32_t _width = push->type == bytelizer_pbtype_32bit ? sizeof(uint32_t) : sizeof(uint64_t);
+
+        // the value is in the chunk, or gathered from them
+        if(push->partial_length == 0 && _end - _cursor >= (ptrdiff_t)_width) {
+          memcpy(push->partial, _cursor, _width);
+          _cursor += _width;
+          push->consumed += _width;
+        }
+
+        else {
+          uint32_t _take = (uint32_t)push->pending;
+          if(_take > (uint32_t)(_end - _cursor)) _take = (uint32_t)(_end - _cursor);
+
+          memcpy(push->partial + push->partial_length, _cursor, _take);
+          push->partial_length += _take;
+          push->pending -= _take;
+          push->consumed += _take;
+          _cursor += _take;
+
+          if(push->pending != 0) return true;
+          push->partial_length = 0;
+        }
+
+        if(_width == sizeof(uint32_t)) {
+          uint32_t _value; memcpy(&_value, push->partial, sizeof(uint32_t));
+          _wire = bitwise_le32(_value);
+        }
+        else {
+          memcpy(&_wire, push->partial, sizeof(uint64_t));
+          _wire = bitwise_le64(_wire);
+        }
+
+        push->state = __pbpush_key;
+        if(push->field != NULL && !__pbpush_emit(push, push->type, _wire)) goto failure;
+        break;
+      }
+
+      // only a body split between the chunks is copied
+      case __pbpush_body: {
+
+        uint32_t _take = (uint32_t)push->pending;
+        if(_take > (uint32_t)(_end - _cursor)) _take = (uint32_t)(_end - _cursor);
+
+        memcpy(push->buffer + push->buffered, _cursor, _take);
+        push->buffered += _take;
+        push->pending -= _take;
+        push->consumed += _take;
+        _cursor += _take;
+
+        if(push->pending != 0) return true;
+
+        push->state = __pbpush_key;
+        if(!__pbpush_emit_body(push, push->buffer, push->buffered)) goto failure;
+        break;
+      }
+
+      case __pbpush_skip: {
+
+        uint64_t _take = push->pending;
+        if(_take > (uint64_t)(_end - _cursor)) _take = (uint64_t)(_end - _cursor);
+
+        push->pending -= _take;
+        push->consumed += _take;
+        _cursor += _take;
+
+        if(push->pending == 0) push->state = __pbpush_key;
+        break;
+      }
+    }
+  }
+
+failure:
+  push->failed = true;
+  return false;
+}
+
+bool bytelizer_pbpush_finish(bytelizer_pbpush_t* push) {
+
+  bool _result = !push->failed;
+
+  if(_result && (push->state != __pbpush_key || push->partial_length != 0 || push->depth != 0)) {
+    __bytelizer_log("truncated protobuf message, %u nested messages are open", push->depth);
+    _result = false;
+  }
+
+  // ready for the next message
+  push->depth = 0;
+  push->state = __pbpush_key;
+  push->partial_length = 0;
+  push->pending = 0;
+  push->consumed = 0;
+  push->failed = false;
+  push->frames[0].hint = push->frames[0].schema;
+
+  return _result;
+}
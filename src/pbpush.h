@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#ifndef _BYTELIZER_PBPUSH_H
+#define _BYTELIZER_PBPUSH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <bytelizer/common.h>
+
+#include "compiler.h"
+#include "codec.h"
+#include "varint.h"
+#include "protobuf.h"
+
+/*
+  A push decoder takes a message in chunks of any size, as they come
+  from a socket. It stops in the middle of a varint or a field when a
+  chunk runs out and goes on with the next one, no byte is read twice:
+
+    bytelizer_pbpush_alloc(push, schema, state, on_field);
+      while((got = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+        if(!bytelizer_pbpush_feed(push, buffer, got)) break;
+      bytelizer_pbpush_finish(push);
+    bytelizer_pbpush_destroy(push);
+
+  The fields of the schema (a protobuf struct) are handed to the
+  callback as they are read, the unknown ones are skipped. A nested
+  message is not gathered, it is read in place between a begin and an
+  end event, the schema of a repeated message is its first element.
+  A bytes field is handed whole: it points into the chunk if it is in
+  a single one, only a body split between chunks is copied. The
+  elements of a packed field are handed one by one.
+*/
+
+// the largest body copied from the chunks
+#ifndef BYTELIZER_PBPUSH_LIMIT
+  #define BYTELIZER_PBPUSH_LIMIT (64u << 20)
+#endif
+
+typedef enum {
+  // a scalar, a bytes field or an element of a repeated field
+  bytelizer_pbpush_field = 0,
+  bytelizer_pbpush_begin,
+  bytelizer_pbpush_end,
+} bytelizer_pbpush_event_t;
+
+/**
+ * @brief the callback of a push decoder
+ * @param userdata the userdata
+ * @param event the event
+ * @param schema the field of the schema
+ * @param value the value read, with the tag, the wire type and the
+ * element type of the schema, zigzag applied. The bytes live until the
+ * callback returns. NULL for the begin and end of a message
+ * @return false to stop decoding
+ */
+typedef bool (* bytelizer_pbpush_callback_t)(void* userdata, bytelizer_pbpush_event_t event,
+  const bytelizer_pbfield_t* schema, const bytelizer_pbfield_t* value);
+
+typedef struct {
+  const bytelizer_pbfield_t* schema;
+  // the next field is tried first
+  const bytelizer_pbfield_t* hint;
+  // the message field in the parent, NULL at the root
+  const bytelizer_pbfield_t* field;
+  // the offset of the end of the message
+  uint64_t end;
+} __pbpush_frame_t;
+
+typedef struct {
+  void* userdata;
+  bytelizer_pbpush_callback_t callback;
+  __pbpush_frame_t* frames;
+  uint32_t depth;
+  uint32_t state;
+
+  // the field being read, NULL if it is skipped
+  const bytelizer_pbfield_t* field;
+  bytelizer_pbtype_t type;
+
+  // a varint or a fixed value split between the chunks
+  uint8_t partial[BYTELIZER_VARINT64_MAX];
+  uint32_t partial_length;
+
+  // the bytes left of a fixed value, a body or a skipped field
+  uint64_t pending;
+
+  // a body split between the chunks
+  uint8_t* buffer;
+  uint32_t buffered;
+  uint32_t capacity;
+  uint32_t limit;
+
+  // the bytes read of the message
+  uint64_t consumed;
+  bool failed;
+} bytelizer_pbpush_t;
+
+/**
+ * @brief push decoder initialize
+ * @param push the push decoder
+ * @param _schema the protobuf struct of the message
+ * @param _userdata the userdata of the callback
+ * @param _callback the callback receiving the fields
+ */
+#define bytelizer_pbpush_alloc(push, _schema, _userdata, _callback) { \
+  __pbpush_frame_t push##_frames[BYTELIZER_PBSTRUCT_DEPTH + 1]; \
+  push##_frames[0] = (__pbpush_frame_t) { .schema = _schema, .hint = _schema, .end = UINT64_MAX }; \
+  bytelizer_pbpush_t* push = &(bytelizer_pbpush_t) { \
+    .userdata = _userdata, \
+    .callback = _callback, \
+    .frames = push##_frames, \
+    .limit = BYTELIZER_PBPUSH_LIMIT, \
+  };
+
+/**
+ * @brief release a push decoder
+ * @param push the push decoder
+ */
+#define bytelizer_pbpush_destroy(push) \
+  free(push->buffer); }
+
+/**
+ * @brief read a chunk of the message
+ * @param push the push decoder
+ * @param data the chunk
+ * @param length the length of the chunk
+ * @return false if the message is malformed or the callback stopped,
+ * the decoder takes nothing more until it is finished
+ */
+bool bytelizer_pbpush_feed(bytelizer_pbpush_t* push, const uint8_t* data, uint32_t length);
+
+/**
+ * @brief end the message, the decoder is ready for the next one
+ * @param push the push decoder
+ * @return false if the message is truncated or it has failed
+ */
+bool bytelizer_pbpush_finish(bytelizer_pbpush_t* push);
+
+#endif /* _BYTELIZER_PBPUSH_H */
@@ -0,0 +1,200 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "debug/log.h"
+#include "codec.h"
+#include "varint.h"
+#include "protobuf.h"
+#include "pbstream.h"
+
+bool bytelizer_pbwriter_put(bytelizer_pbwriter_t* writer, const bytelizer_pbfield_t* pbroot) {
+
+  if(!bytelizer_put_pbdelimited(writer->ctx, pbroot))
+    return false;
+
+  ++writer->messages;
+  if(bytelizer_length(writer->ctx) >= writer->watermark)
+    bytelizer_pbwriter_flush(writer);
+
+  return true;
+}
+
+void bytelizer_pbwriter_put_bytes(bytelizer_pbwriter_t* writer, const uint8_t* data, uint32_t length) {
+
+  bytelizer_put_varint(writer->ctx, length);
+  bytelizer_put_bytes(writer->ctx, data, length);
+
+  ++writer->messages;
+  if(bytelizer_length(writer->ctx) >= writer->watermark)
+    bytelizer_pbwriter_flush(writer);
+}
+
+uint32_t bytelizer_pbwriter_flush(bytelizer_pbwriter_t* writer) {
+
+  bytelizer_ctx_t* _ctx = writer->ctx;
+  if(bytelizer_length(_ctx) == 0) return 0;
+
+  uint32_t _length = bytelizer_copy_to(writer->userdata, _ctx, writer->callback);
+  writer->flushed += _length;
+
+  // the stack is overwritten by the next batch, it is not cleared
+  bytelizer_reset_unsafe(_ctx);
+
+  return _length;
+}
+
+void bytelizer_pbreader_feed(bytelizer_pbreader_t* reader, const uint8_t* data, uint32_t length) {
+  reader->data = data;
+  reader->length = length;
+  reader->cursor = 0;
+  reader->consumed = 0;
+  reader->count = 0;
+  reader->next = 0;
+  reader->final = false;
+}
+
+// the message is a sequence of well formed fields
+static bool __pbreader_valid(const uint8_t* cursor, const uint8_t* end) {
+
+  uint64_t _varint;
+  uint32_t _length;
+
+  while(cursor < end) {
+
+    if((_length = __varint_decode(cursor, end, &_varint)) == 0 ||
+       (_varint >> 3) == 0 || (_varint >> 3) > BYTELIZER_PBTAG_MAX)
+      return false;
+    cursor += _length;
+
+    switch((bytelizer_pbtype_t)(_varint & 0b111)) {
+
+      case bytelizer_pbtype_varint:
+        if((_length = __varint_decode(cursor, end, &_varint)) == 0) return false;
+        cursor += _length;
+        break;
+
+      case bytelizer_pbtype_32bit:
+        if(end - cursor < (ptrdiff_t)sizeof(uint32_t)) return false;
+        cursor += sizeof(uint32_t);
+        break;
+
+      case bytelizer_pbtype_64bit:
+        if(end - cursor < (ptrdiff_t)sizeof(uint64_t)) return false;
+        cursor += sizeof(uint64_t);
+        break;
+
+      case bytelizer_pbtype_length_delimited:
+        if((_length = __varint_decode(cursor, end, &_varint)) == 0) return false;
+        cursor += _length;
+        if(_varint > (uint64_t)(end - cursor)) return false;
+        cursor += _varint;
+        break;
+
+      default:
+        return false;
+    }
+  }
+
+  return true;
+}
+
+typedef enum {
+  __pbrecord_ok,
+  __pbrecord_garbage,
+  __pbrecord_pending,
+} __pbrecord_t;
+
+// check the record at the cursor, the rest of it may not be here yet
+static __pbrecord_t __pbreader_record(const bytelizer_pbreader_t* reader, uint32_t cursor,
+uint32_t* prefix, uint64_t* size) {
+
+  const uint8_t* _data = reader->data;
+  uint32_t _length = reader->length;
+
+  // most of the records are short
+  if(_data[cursor] < 0x80) {
+    *size = _data[cursor];
+    *prefix = 1;
+  }
+
+  else if((*prefix = __varint_decode(_data + cursor, _data + _length, size)) == 0) {
+    // an overlong prefix is garbage, a short one waits for more data
+    return _length - cursor >= BYTELIZER_VARINT64_MAX ? __pbrecord_garbage : __pbrecord_pending;
+  }
+
+  if(*size > reader->limit) return __pbrecord_garbage;
+  if(*size > _length - cursor - *prefix) return __pbrecord_pending;
+
+  const uint8_t* _body = _data + cursor + *prefix;
+  if(reader->validate && !__pbreader_valid(_body, _body + *size)) return __pbrecord_garbage;
+
+  return __pbrecord_ok;
+}
+
+void __pbreader_scan(bytelizer_pbreader_t* reader) {
+
+  uint32_t _cursor = reader->cursor;
+  uint32_t _length = reader->length;
+
+  reader->count = 0;
+  reader->next = 0;
+
+  while(reader->count < reader->capacity && _cursor < _length) {
+
+    uint32_t _prefix;
+    uint64_t _size;
+
+    __pbrecord_t _record = __pbreader_record(reader, _cursor, &_prefix, &_size);
+
+    // after garbage a record must be followed by another one to be trusted
+    if(_record == __pbrecord_ok && reader->resyncing) {
+      uint32_t _next = _cursor + _prefix + (uint32_t)_size;
+      uint32_t _next_prefix;
+      uint64_t _next_size;
+
+      if(_next == _length) _record = reader->final ? __pbrecord_ok : __pbrecord_pending;
+      else _record = __pbreader_record(reader, _next, &_next_prefix, &_next_size);
+
+      if(_record == __pbrecord_pending && reader->final) _record = __pbrecord_garbage;
+      if(_record == __pbrecord_pending) break;
+    }
+
+    // the rest of the stream is a truncated record
+    if(_record == __pbrecord_pending) {
+      if(!reader->final) break;
+      if(reader->validate) _record = __pbrecord_garbage;
+      else {
+        __bytelizer_log("dropped a truncated tail of %u bytes", _length - _cursor);
+        reader->dropped += _length - _cursor;
+        _cursor = _length;
+        break;
+      }
+    }
+
+    if(_record == __pbrecord_garbage) {
+      reader->resyncing = true;
+      ++reader->dropped;
+      ++_cursor;
+      continue;
+    }
+
+    reader->resyncing = false;
+    reader->spans[reader->count++] = (bytelizer_pbslice_t) {
+      .data = reader->data + _cursor + _prefix,
+      .length = (uint32_t)_size,
+    };
+    _cursor += _prefix + (uint32_t)_size;
+  }
+
+  reader->cursor = _cursor;
+}
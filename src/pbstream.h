@@ -0,0 +1,216 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#ifndef _BYTELIZER_PBSTREAM_H
+#define _BYTELIZER_PBSTREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <bytelizer/common.h>
+
+#include "compiler.h"
+#include "codec.h"
+#include "protobuf.h"
+
+/*
+  A delimited stream is a sequence of protobuf messages, each of them
+  prefixed by its varint length. The writer batches the messages in
+  one context and hands the batch to the callback once it reaches the
+  watermark:
+
+    bytelizer_pbwriter_alloc(writer, 64 * 1024, 60 * 1024, file, write_file);
+      bytelizer_pbwriter_put(writer, record);
+      ...
+    bytelizer_pbwriter_destroy(writer);
+
+  The reader finds the message boundaries of a whole buffer ahead of
+  the caller, the messages are spans of the buffer. The unfinished
+  tail is kept by the caller and read again with more data behind it:
+
+    bytelizer_pbreader_alloc(reader, 256);
+      while((got = read(fd, buffer + length, sizeof(buffer) - length)) > 0) {
+        bytelizer_pbreader_feed(reader, buffer, length += got);
+        while(bytelizer_pbreader_next(reader, &message))
+          bytelizer_pbtable_decode(table, message.data, message.length, record);
+
+        length -= bytelizer_pbreader_consumed(reader);
+        memmove(buffer, buffer + bytelizer_pbreader_consumed(reader), length);
+      }
+
+      bytelizer_pbreader_feed(reader, buffer, length);
+      bytelizer_pbreader_finish(reader);
+      while(bytelizer_pbreader_next(reader, &message))
+        ...
+    bytelizer_pbreader_destroy(reader);
+
+  A prefix over the limit is garbage, the reader drops one byte and
+  looks for the next boundary. With validate set, the message bodies
+  are checked to be well formed protobuf too. This lets the reader
+  resync after a record truncated by a crash and followed by new
+  ones, a message found after garbage is taken once the next one is
+  good as well. Once the input is finished, the truncated tail is
+  resynced with validate, or dropped without it.
+*/
+
+// the default largest message of a reader
+#ifndef BYTELIZER_PBSTREAM_LIMIT
+  #define BYTELIZER_PBSTREAM_LIMIT (64u << 20)
+#endif
+
+typedef struct {
+  bytelizer_ctx_t* ctx;
+  // the batch is flushed once it is this long
+  uint32_t watermark;
+  void* userdata;
+  bytelizer_callback_copy_t callback;
+  uint64_t messages;
+  uint64_t flushed;
+} bytelizer_pbwriter_t;
+
+typedef struct {
+  const uint8_t* data;
+  uint32_t length;
+  // the bytes scanned, the spans found are in front of it
+  uint32_t cursor;
+  // the end of the last message taken
+  uint32_t consumed;
+  bytelizer_pbslice_t* spans;
+  uint32_t count;
+  uint32_t next;
+  uint32_t capacity;
+  // the largest message
+  uint32_t limit;
+  // check every message to be well formed
+  bool validate;
+  // no more data comes after the buffer
+  bool final;
+  // looking for a boundary after garbage
+  bool resyncing;
+  // the bytes skipped while resyncing
+  uint64_t dropped;
+} bytelizer_pbreader_t;
+
+/**
+ * @brief delimited stream writer initialize
+ * @param writer the writer
+ * @param size the batch size kept on the stack, above the watermark
+ * so a batch does not spill into the heap
+ * @param _watermark the batch length to be flushed at
+ * @param _userdata the userdata of the callback
+ * @param _callback the callback receiving the batches
+ */
+#define bytelizer_pbwriter_alloc(writer, size, _watermark, _userdata, _callback) { \
+  bytelizer_alloc_unsafe(writer##_batch, size) \
+  bytelizer_pbwriter_t* writer = &(bytelizer_pbwriter_t) { \
+    .ctx = writer##_batch, \
+    .watermark = _watermark, \
+    .userdata = _userdata, \
+    .callback = _callback, \
+  };
+
+/**
+ * @brief flush a delimited stream writer and release it
+ * @param writer the writer
+ */
+#define bytelizer_pbwriter_destroy(writer) \
+  bytelizer_pbwriter_flush(writer); \
+  bytelizer_destroy_unsafe(writer->ctx); }
+
+/**
+ * @brief put a protobuf struct into the stream
+ * @param writer the writer
+ * @param pbroot the protobuf struct
+ * @return false if the struct can not be written
+ */
+bool bytelizer_pbwriter_put(bytelizer_pbwriter_t* writer, const bytelizer_pbfield_t* pbroot);
+
+/**
+ * @brief put an encoded message into the stream, a span of a reader
+ * is forwarded without decoding
+ * @param writer the writer
+ * @param data the message
+ * @param length the length of the message
+ */
+void bytelizer_pbwriter_put_bytes(bytelizer_pbwriter_t* writer, const uint8_t* data, uint32_t length);
+
+/**
+ * @brief hand the batch to the callback
+ * @param writer the writer
+ * @return the bytes flushed
+ */
+uint32_t bytelizer_pbwriter_flush(bytelizer_pbwriter_t* writer);
+
+/**
+ * @brief delimited stream reader initialize
+ * @param reader the reader
+ * @param size the message spans found in a single scan
+ */
+#define bytelizer_pbreader_alloc(reader, size) { \
+  bytelizer_pbslice_t reader##_spans[size]; \
+  bytelizer_pbreader_t* reader = &(bytelizer_pbreader_t) { \
+    .spans = reader##_spans, \
+    .capacity = size, \
+    .limit = BYTELIZER_PBSTREAM_LIMIT, \
+  };
+
+/**
+ * @brief release a delimited stream reader
+ * @param reader the reader
+ */
+#define bytelizer_pbreader_destroy(reader) (void)(reader); }
+
+/**
+ * @brief read a buffer, the messages of the last one must be done with
+ * @param reader the reader
+ * @param data the buffer, beginning at a message boundary
+ * @param length the length of the buffer
+ */
+void bytelizer_pbreader_feed(bytelizer_pbreader_t* reader, const uint8_t* data, uint32_t length);
+
+/**
+ * @brief no more data comes after the buffer being read, the rest
+ * of it is resynced or dropped
+ * @param reader the reader
+ */
+_inline static void bytelizer_pbreader_finish(bytelizer_pbreader_t* reader) {
+  reader->final = true;
+}
+
+// find the message boundaries ahead of the reader
+void __pbreader_scan(bytelizer_pbreader_t* reader);
+
+/**
+ * @brief take the next message
+ * @param reader the reader
+ * @param message the span of the message in the buffer
+ * @return false if there is no complete message left in the buffer
+ */
+_inline static bool bytelizer_pbreader_next(bytelizer_pbreader_t* reader, bytelizer_pbslice_t* message) {
+
+  if(reader->next == reader->count) {
+    __pbreader_scan(reader);
+    if(reader->count == 0) {
+      reader->consumed = reader->cursor;
+      return false;
+    }
+  }
+
+  *message = reader->spans[reader->next++];
+  reader->consumed = (uint32_t)(message->data + message->length - reader->data);
+  return true;
+}
+
+/**
+ * @brief get the bytes of the buffer done with, the rest is an
+ * unfinished message to be fed again with more data
+ * @param reader the reader
+ */
+#define bytelizer_pbreader_consumed(reader) ((reader)->consumed)
+
+#endif /* _BYTELIZER_PBSTREAM_H */
@@ -0,0 +1,490 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "debug/log.h"
+#include "codec.h"
+#include "bitwise.h"
+#include "varint.h"
+#include "protobuf.h"
+#include "pbtable.h"
+
+// a message without a table
+#define __PBTABLE_NONE UINT32_MAX
+
+typedef bool (*__pbhandler_t)(const uint8_t** cursor, const uint8_t* end,
+  bytelizer_pbfield_t* field, const bytelizer_pbtable_t* table, uint32_t message, uint32_t depth);
+
+typedef struct {
+  __pbhandler_t handler;
+  // the index of the field in its struct
+  uint32_t field;
+  // the table of a nested message
+  uint32_t message;
+} __pbdispatch_t;
+
+// the keys beyond the dense table, sorted
+typedef struct {
+  uint64_t key;
+  __pbdispatch_t dispatch;
+} __pbsparse_t;
+
+typedef struct {
+  __pbdispatch_t* dense;
+  uint32_t limit;
+  __pbsparse_t* sparse;
+  uint32_t sparse_count;
+} __pbmessage_t;
+
+struct _bytelizer_pbtable_t {
+  __pbmessage_t* messages;
+  uint32_t count;
+  uint32_t capacity;
+};
+
+static bool __pbtable_decode(const uint8_t* cursor, const uint8_t* end, bytelizer_pbfield_t* pbroot,
+const bytelizer_pbtable_t* table, uint32_t message, uint32_t depth);
+
+_inline static bool __pbtable_varint(const uint8_t** cursor, const uint8_t* end, uint64_t* value) {
+
+  uint32_t _length = __varint_decode(*cursor, end, value);
+  if(_length == 0) {
+    __bytelizer_log("truncated protobuf varint");
+    return false;
+  }
+
+  *cursor += _length;
+  return true;
+}
+
+_inline static bool __pbtable_fixed(const uint8_t** cursor, const uint8_t* end, uint32_t width, uint64_t* value) {
+
+  if((size_t)(end - *cursor) < width) {
+    __bytelizer_log("truncated protobuf fixed%u", width * 8);
+    return false;
+  }
+
+  if(width == sizeof(uint32_t)) {
+    uint32_t _value; memcpy(&_value, *cursor, sizeof(uint32_t));
+    *value = bitwise_le32(_value);
+  }
+  else {
+    memcpy(value, *cursor, sizeof(uint64_t));
+    *value = bitwise_le64(*value);
+  }
+
+  *cursor += width;
+  return true;
+}
+
+_inline static bool __pbtable_delimited(const uint8_t** cursor, const uint8_t* end,
+const uint8_t** data, uint32_t* length) {
+
+  uint64_t _length;
+  if(!__pbtable_varint(cursor, end, &_length)) return false;
+
+  // the body must be inside the parent
+  if(_length > (uint64_t)(end - *cursor)) {
+    __bytelizer_log("protobuf length %llu is out of bounds", (unsigned long long)_length);
+    return false;
+  }
+
+  *data = *cursor;
+  *length = (uint32_t)_length;
+  *cursor += _length;
+  return true;
+}
+
+// unknown fields and the ones of another wire type
+static bool __pbtable_skip(const uint8_t** cursor, const uint8_t* end, uint64_t key) {
+
+  const uint8_t* _data;
+  uint32_t _length;
+  uint64_t _value;
+
+  if((key >> 3) == 0 || (key >> 3) > BYTELIZER_PBTAG_MAX) {
+    __bytelizer_log("invalid protobuf tag %llu", (unsigned long long)(key >> 3));
+    return false;
+  }
+
+  switch((bytelizer_pbtype_t)(key & 0b111)) {
+    case bytelizer_pbtype_varint: return __pbtable_varint(cursor, end, &_value);
+    case bytelizer_pbtype_32bit: return __pbtable_fixed(cursor, end, sizeof(uint32_t), &_value);
+    case bytelizer_pbtype_64bit: return __pbtable_fixed(cursor, end, sizeof(uint64_t), &_value);
+    case bytelizer_pbtype_length_delimited: return __pbtable_delimited(cursor, end, &_data, &_length);
+    default:
+      __bytelizer_log("unsupported protobuf wire type %d", (int)(key & 0b111));
+      return false;
+  }
+}
+
+// only the message handlers go on with the table
+#define __PBHANDLER(name) \
+  static bool name(const uint8_t** cursor, const uint8_t* end, bytelizer_pbfield_t* field, \
+    const bytelizer_pbtable_t* table _maybe_unused, uint32_t message _maybe_unused, uint32_t depth _maybe_unused)
+
+__PBHANDLER(__pbhandle_varint) {
+  return __pbtable_varint(cursor, end, &field->value.varint);
+}
+
+__PBHANDLER(__pbhandle_sint32) {
+  uint64_t _value;
+  if(!__pbtable_varint(cursor, end, &_value)) return false;
+  field->value.svarint = __zigzag_decode32((uint32_t)_value);
+  return true;
+}
+
+__PBHANDLER(__pbhandle_sint64) {
+  uint64_t _value;
+  if(!__pbtable_varint(cursor, end, &_value)) return false;
+  field->value.svarint = __zigzag_decode64(_value);
+  return true;
+}
+
+__PBHANDLER(__pbhandle_fixed32) {
+  uint64_t _value;
+  if(!__pbtable_fixed(cursor, end, sizeof(uint32_t), &_value)) return false;
+  field->value.fixed32 = (uint32_t)_value;
+  return true;
+}
+
+__PBHANDLER(__pbhandle_fixed64) {
+  return __pbtable_fixed(cursor, end, sizeof(uint64_t), &field->value.fixed64);
+}
+
+__PBHANDLER(__pbhandle_bytes) {
+  const uint8_t* _data;
+  uint32_t _length;
+  if(!__pbtable_delimited(cursor, end, &_data, &_length)) return false;
+  field->value.length_delimited.data = (uint8_t *)_data;
+  field->value.length_delimited.length = _length;
+  return true;
+}
+
+// the sub struct is decoded in place, repeated ones are merged
+__PBHANDLER(__pbhandle_message) {
+  const uint8_t* _data;
+  uint32_t _length;
+  if(!__pbtable_delimited(cursor, end, &_data, &_length)) return false;
+  return field->value.message == NULL ||
+    __pbtable_decode(_data, _data + _length, field->value.message, table, message, depth + 1);
+}
+
+__PBHANDLER(__pbhandle_push_varint) {
+  uint64_t _value;
+  return __pbtable_varint(cursor, end, &_value) && __pbarray_push(field, _value);
+}
+
+__PBHANDLER(__pbhandle_push_fixed32) {
+  uint64_t _value;
+  return __pbtable_fixed(cursor, end, sizeof(uint32_t), &_value) && __pbarray_push(field, _value);
+}
+
+__PBHANDLER(__pbhandle_push_fixed64) {
+  uint64_t _value;
+  return __pbtable_fixed(cursor, end, sizeof(uint64_t), &_value) && __pbarray_push(field, _value);
+}
+
+__PBHANDLER(__pbhandle_packed) {
+  const uint8_t* _data;
+  uint32_t _length;
+  return __pbtable_delimited(cursor, end, &_data, &_length) &&
+    __pbarray_decode(_data, _data + _length, field);
+}
+
+__PBHANDLER(__pbhandle_push_bytes) {
+
+  const uint8_t* _data;
+  uint32_t _length;
+  if(!__pbtable_delimited(cursor, end, &_data, &_length)) return false;
+
+  if(field->value.array.count >= field->value.array.capacity) {
+    __bytelizer_log("protobuf repeated tag %u is over the capacity %u",
+      field->tag, field->value.array.capacity);
+    return false;
+  }
+
+  bytelizer_pbslice_t* _items = field->value.array.data;
+  _items[field->value.array.count++] = (bytelizer_pbslice_t) { .data = _data, .length = _length };
+  return true;
+}
+
+__PBHANDLER(__pbhandle_push_message) {
+
+  const uint8_t* _data;
+  uint32_t _length;
+  if(!__pbtable_delimited(cursor, end, &_data, &_length)) return false;
+
+  if(field->value.array.count >= field->value.array.capacity) {
+    __bytelizer_log("protobuf repeated tag %u is over the capacity %u",
+      field->tag, field->value.array.capacity);
+    return false;
+  }
+
+  bytelizer_pbfield_t** _items = field->value.array.data;
+  bytelizer_pbfield_t* _item = _items[field->value.array.count++];
+  if(_item == NULL || message == __PBTABLE_NONE) return true;
+
+  // every element is a message of its own
+  __pbstruct_reset(_item, NULL, depth + 1);
+  return __pbtable_decode(_data, _data + _length, _item, table, message, depth + 1);
+}
+
+#undef __PBHANDLER
+
+/*
+  TABLE COMPILATION
+*/
+
+// the handler of a field on its own wire type
+static __pbhandler_t __pbtable_handler(const bytelizer_pbfield_t* field, uint32_t message) {
+
+  if(field->repeated) {
+    switch(field->scalar) {
+      case bytelizer_pbscalar_bytes: return __pbhandle_push_bytes;
+      case bytelizer_pbscalar_message: return __pbhandle_push_message;
+      default: break;
+    }
+
+    switch(__pbscalar_wiretype(field->scalar)) {
+      case bytelizer_pbtype_32bit: return __pbhandle_push_fixed32;
+      case bytelizer_pbtype_64bit: return __pbhandle_push_fixed64;
+      default: return __pbhandle_push_varint;
+    }
+  }
+
+  switch(field->type) {
+    case bytelizer_pbtype_varint:
+      if(field->scalar == bytelizer_pbscalar_sint32) return __pbhandle_sint32;
+      if(field->scalar == bytelizer_pbscalar_sint64) return __pbhandle_sint64;
+      return __pbhandle_varint;
+
+    case bytelizer_pbtype_32bit: return __pbhandle_fixed32;
+    case bytelizer_pbtype_64bit: return __pbhandle_fixed64;
+
+    case bytelizer_pbtype_length_delimited:
+      if(!field->subtags) return __pbhandle_bytes;
+      return message != __PBTABLE_NONE ? __pbhandle_message : NULL;
+
+    default:
+      return NULL;
+  }
+}
+
+// the first field of a tag wins, like the linear decoder
+static void __pbtable_set(bytelizer_pbtable_t* table, uint32_t index, uint64_t key, __pbdispatch_t dispatch) {
+
+  __pbmessage_t* _message = &table->messages[index];
+
+  if(key < _message->limit) {
+    if(_message->dense[key].handler == NULL) _message->dense[key] = dispatch;
+    return;
+  }
+
+  for(uint32_t i = 0; i < _message->sparse_count; ++i)
+    if(_message->sparse[i].key == key) return;
+
+  _message->sparse[_message->sparse_count++] = (__pbsparse_t) { .key = key, .dispatch = dispatch };
+}
+
+static int __pbsparse_compare(const void* a, const void* b) {
+  uint64_t _a = ((const __pbsparse_t *)a)->key, _b = ((const __pbsparse_t *)b)->key;
+  return (_a > _b) - (_a < _b);
+}
+
+static bool __pbtable_compile(bytelizer_pbtable_t* table, const bytelizer_pbfield_t* pbroot,
+uint32_t depth, uint32_t* index) {
+
+  if(depth > BYTELIZER_PBSTRUCT_DEPTH) {
+    __bytelizer_log("protobuf struct is nested too deep");
+    return false;
+  }
+
+  if(table->count == table->capacity) {
+    uint32_t _capacity = table->capacity ? table->capacity * 2 : 4;
+    __pbmessage_t* _messages = realloc(table->messages, _capacity * sizeof(__pbmessage_t));
+    if(_messages == NULL) return false;
+    table->messages = _messages;
+    table->capacity = _capacity;
+  }
+
+  uint32_t _index = table->count++;
+  __pbmessage_t* _message = &table->messages[_index];
+  memset(_message, 0, sizeof(__pbmessage_t));
+
+  // size the tables first
+  uint32_t _tag = 0, _fields = 0;
+  for(const bytelizer_pbfield_t* _field = pbroot; _field->tag != 0; ++_field) {
+    if(_field->tag > BYTELIZER_PBTAG_MAX) continue;
+    if(_field->tag > _tag) _tag = _field->tag;
+    ++_fields;
+  }
+
+  // the dense keys follow the field count, a few far tags are searched
+  uint64_t _limit = ((uint64_t)_tag + 1) << 3;
+  uint64_t _spread = (uint64_t)(_fields > 16 ? _fields : 16) * BYTELIZER_PBTABLE_SPREAD << 3;
+  if(_limit > _spread) _limit = _spread;
+  _message->limit = _limit < BYTELIZER_PBTABLE_DENSE ? (uint32_t)_limit : BYTELIZER_PBTABLE_DENSE;
+
+  _message->dense = calloc(_message->limit, sizeof(__pbdispatch_t));
+  _message->sparse = _fields ? malloc(_fields * 2 * sizeof(__pbsparse_t)) : NULL;
+
+  if(_message->dense == NULL || (_fields && _message->sparse == NULL)) {
+    __bytelizer_log("protobuf table is out of memory");
+    return false;
+  }
+
+  for(uint32_t i = 0; pbroot[i].tag != 0; ++i) {
+
+    const bytelizer_pbfield_t* _field = &pbroot[i];
+    uint32_t _child = __PBTABLE_NONE;
+
+    if(_field->tag > BYTELIZER_PBTAG_MAX) continue;
+
+    // the nested message gets its own table
+    const bytelizer_pbfield_t* _nested = NULL;
+    if(_field->repeated && _field->scalar == bytelizer_pbscalar_message) {
+      if(_field->value.array.data != NULL && _field->value.array.capacity != 0)
+        _nested = ((const bytelizer_pbfield_t* const *)_field->value.array.data)[0];
+    }
+    else if(!_field->repeated && _field->subtags)
+      _nested = _field->value.message;
+
+    if(_nested != NULL && !__pbtable_compile(table, _nested, depth + 1, &_child))
+      return false;
+
+    bytelizer_pbtype_t _type = _field->repeated ? __pbscalar_wiretype(_field->scalar) : _field->type;
+    __pbdispatch_t _dispatch = { .handler = __pbtable_handler(_field, _child), .field = i, .message = _child };
+    __pbtable_set(table, _index, (uint64_t)_field->tag << 3 | _type, _dispatch);
+
+    // a repeated field may come packed or not
+    if(_field->repeated && _type != bytelizer_pbtype_length_delimited) {
+      _dispatch.handler = __pbhandle_packed;
+      __pbtable_set(table, _index, (uint64_t)_field->tag << 3 | bytelizer_pbtype_length_delimited, _dispatch);
+    }
+  }
+
+  _message = &table->messages[_index];
+  if(_message->sparse_count > 1)
+    qsort(_message->sparse, _message->sparse_count, sizeof(__pbsparse_t), __pbsparse_compare);
+
+  *index = _index;
+  return true;
+}
+
+bytelizer_pbtable_t* bytelizer_pbtable_create(const bytelizer_pbfield_t* pbroot) {
+
+  if(pbroot == NULL) return NULL;
+
+  bytelizer_pbtable_t* _table = calloc(1, sizeof(bytelizer_pbtable_t));
+  if(_table == NULL) return NULL;
+
+  uint32_t _index;
+  if(!__pbtable_compile(_table, pbroot, 0, &_index)) {
+    bytelizer_pbtable_destroy(_table);
+    return NULL;
+  }
+
+  return _table;
+}
+
+void bytelizer_pbtable_destroy(bytelizer_pbtable_t* table) {
+
+  if(table == NULL) return;
+
+  for(uint32_t i = 0; i < table->count; ++i) {
+    free(table->messages[i].dense);
+    free(table->messages[i].sparse);
+  }
+
+  free(table->messages);
+  free(table);
+}
+
+/*
+  DECODING
+*/
+
+_inline static const __pbdispatch_t* __pbtable_search(const __pbmessage_t* message, uint64_t key) {
+
+  uint32_t _low = 0, _high = message->sparse_count;
+
+  while(_low < _high) {
+    uint32_t _middle = (_low + _high) / 2;
+    if(message->sparse[_middle].key < key) _low = _middle + 1;
+    else _high = _middle;
+  }
+
+  return _low < message->sparse_count && message->sparse[_low].key == key
+    ? &message->sparse[_low].dispatch : NULL;
+}
+
+static bool __pbtable_decode(const uint8_t* cursor, const uint8_t* end, bytelizer_pbfield_t* pbroot,
+const bytelizer_pbtable_t* table, uint32_t message, uint32_t depth) {
+
+  if(depth > BYTELIZER_PBSTRUCT_DEPTH) {
+    __bytelizer_log("protobuf struct is nested too deep");
+    return false;
+  }
+
+  const __pbmessage_t* _message = &table->messages[message];
+
+  while(cursor < end) {
+
+    // the one byte keys are the common ones
+    uint64_t _key;
+    if(*cursor < 0x80) _key = *cursor++;
+    else if(!__pbtable_varint(&cursor, end, &_key)) return false;
+
+    const __pbdispatch_t* _dispatch = _key < _message->limit
+      ? &_message->dense[_key] : __pbtable_search(_message, _key);
+
+    if(_dispatch != NULL && _dispatch->handler != NULL) {
+      if(!_dispatch->handler(&cursor, end, &pbroot[_dispatch->field], table, _dispatch->message, depth))
+        return false;
+      continue;
+    }
+
+    if(!__pbtable_skip(&cursor, end, _key)) return false;
+  }
+
+  return true;
+}
+
+bool bytelizer_pbtable_decode(const bytelizer_pbtable_t* table,
+const uint8_t* data, uint32_t length, bytelizer_pbfield_t* pbroot) {
+
+  if(table == NULL || pbroot == NULL) return false;
+
+  // the repeated fields are filled from the beginning, a sub message
+  // seen again on the wire is merged and keeps appending
+  __pbstruct_reset(pbroot, NULL, 0);
+  return __pbtable_decode(data, data + length, pbroot, table, 0, 0);
+}
+
+typedef struct {
+  const bytelizer_pbtable_t* table;
+  bytelizer_pbfield_t* pbroot;
+} __pbtable_target_t;
+
+static bool __pbtable_get(const uint8_t* data, uint32_t length, void* userdata) {
+  __pbtable_target_t* _target = userdata;
+  return bytelizer_pbtable_decode(_target->table, data, length, _target->pbroot);
+}
+
+bool bytelizer_get_pbtable_ex(bytelizer_ctx_t* ctx, const bytelizer_pbtable_t* table,
+bytelizer_pbfield_t* pbroot, uint32_t length) {
+
+  __pbtable_target_t _target = { .table = table, .pbroot = pbroot };
+  return __pbstruct_get(ctx, length, __pbtable_get, &_target);
+}
@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#ifndef _BYTELIZER_PBTABLE_H
+#define _BYTELIZER_PBTABLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <bytelizer/common.h>
+
+#include "compiler.h"
+#include "codec.h"
+#include "protobuf.h"
+
+/*
+  A dispatch table is compiled once from a PBSTRUCT, every message of
+  it gets an array indexed by the wire key (tag << 3 | wire type) of
+  the one and two byte tags, so decoding a field is a key load, a table
+  load and a call to the handler of the field, no tag is searched:
+
+    bytelizer_pbtable_t* table = bytelizer_pbtable_create(_pb_struct_report);
+    ...
+    bytelizer_attach(ctx, data, length);
+      bytelizer_get_pbtable(ctx, table, report);
+    bytelizer_detach(ctx);
+    ...
+    bytelizer_pbtable_destroy(table);
+
+  Fields are addressed by their index, so the table decodes any struct
+  of the same shape as the one it is compiled from. The element shape
+  of a PB_REPEATED_MESSAGE is its first element. The decoding rules are
+  the same as bytelizer_get_pbstruct_ex.
+*/
+
+// the largest key found by indexing, larger tags are searched
+#ifndef BYTELIZER_PBTABLE_DENSE
+  #define BYTELIZER_PBTABLE_DENSE (1u << 14)
+#endif
+
+// the tags indexed per field of a message, the tags beyond are searched,
+// so a sparse struct does not take a dense table up to its largest tag
+#ifndef BYTELIZER_PBTABLE_SPREAD
+  #define BYTELIZER_PBTABLE_SPREAD 4
+#endif
+
+typedef struct _bytelizer_pbtable_t bytelizer_pbtable_t;
+
+/**
+ * @brief compile the dispatch table of a protobuf struct
+ * @param pbroot the protobuf struct
+ * @return the table, NULL if it is out of memory or nested too deep
+ */
+bytelizer_pbtable_t* bytelizer_pbtable_create(const bytelizer_pbfield_t* pbroot);
+
+/**
+ * @brief release a dispatch table
+ * @param table the table
+ */
+void bytelizer_pbtable_destroy(bytelizer_pbtable_t* table);
+
+/**
+ * @brief decode a message by a dispatch table
+ * @param table the table
+ * @param data the wire bytes
+ * @param length the length of the message
+ * @param pbroot the protobuf struct to be filled, the same shape as the table
+ * @return false if the data is malformed
+ */
+bool bytelizer_pbtable_decode(const bytelizer_pbtable_t* table,
+const uint8_t* data, uint32_t length, bytelizer_pbfield_t* pbroot);
+
+/**
+ * @brief get a protobuf struct of the given length by a dispatch table
+ * from a linear (attached) buffer, the cursor is moved if it is good
+ * @param ctx the bytelizer context
+ * @param table the table
+ * @param pbroot the protobuf struct to be filled
+ * @param length the encoded length of the struct
+ */
+bool bytelizer_get_pbtable_ex(bytelizer_ctx_t* ctx, const bytelizer_pbtable_t* table,
+bytelizer_pbfield_t* pbroot, uint32_t length);
+
+/**
+ * @brief get a protobuf struct taking the rest of the buffer
+ * @param ctx the bytelizer context
+ * @param table the table
+ * @param pbroot the protobuf struct to be filled
+ */
+#define bytelizer_get_pbtable(ctx, table, pbroot) \
+  bytelizer_get_pbtable_ex(ctx, table, pbroot, bytelizer_remain(ctx))
+
+#endif /* _BYTELIZER_PBTABLE_H */
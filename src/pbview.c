@@ -0,0 +1,380 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "debug/log.h"
+#include "codec.h"
+#include "bitwise.h"
+#include "varint.h"
+#include "arena.h"
+#include "protobuf.h"
+#include "pbview.h"
+
+// a field on the wire
+typedef struct {
+  uint32_t key;
+  const uint8_t* value;
+  uint32_t length;
+  uint64_t varint;
+} __pbwire_t;
+
+// 1 for a field, 0 at the end, -1 if it is malformed
+_inline static int __pbwire_next(const uint8_t** cursor, const uint8_t* end, __pbwire_t* field) {
+
+  const uint8_t* _cursor = *cursor;
+  uint64_t _key;
+  uint32_t _length;
+
+  if(_cursor >= end) return 0;
+
+  if((_length = __varint_decode(_cursor, end, &_key)) == 0 ||
+     (_key >> 3) == 0 || (_key >> 3) > BYTELIZER_PBTAG_MAX) {
+    __bytelizer_log("invalid protobuf tag");
+    return -1;
+  }
+  _cursor += _length;
+
+  field->key = (uint32_t)_key;
+  field->varint = 0;
+
+  switch((bytelizer_pbtype_t)(_key & 0b111)) {
+
+    case bytelizer_pbtype_varint:
+      _length = __varint_decode(_cursor, end, &field->varint);
+      if(_length == 0) {
+        __bytelizer_log("truncated protobuf varint, tag %u", field->key >> 3);
+        return -1;
+      }
+      break;
+
+    case bytelizer_pbtype_32bit:
+      _length = sizeof(uint32_t);
+      break;
+
+    case bytelizer_pbtype_64bit:
+      _length = sizeof(uint64_t);
+      break;
+
+    case bytelizer_pbtype_length_delimited: {
+      uint32_t _prefix = __varint_decode(_cursor, end, &field->varint);
+      if(_prefix == 0) {
+        __bytelizer_log("truncated protobuf length, tag %u", field->key >> 3);
+        return -1;
+      }
+      _cursor += _prefix;
+      if(field->varint > (uint64_t)(end - _cursor)) {
+        __bytelizer_log("protobuf length of tag %u is out of bounds", field->key >> 3);
+        return -1;
+      }
+      _length = (uint32_t)field->varint;
+      break;
+    }
+
+    default:
+      __bytelizer_log("unsupported protobuf wire type, tag %u", field->key >> 3);
+      return -1;
+  }
+
+  if(_length > (uint64_t)(end - _cursor)) {
+    __bytelizer_log("truncated protobuf field, tag %u", field->key >> 3);
+    return -1;
+  }
+
+  field->value = _cursor;
+  field->length = _length;
+  *cursor = _cursor + _length;
+  return 1;
+}
+
+// the schema field of a wire field, -1 for the unknown and mismatched ones
+_inline static int32_t __pbview_match(const bytelizer_pbfield_t* schema,
+uint32_t fields, uint32_t* hint, uint32_t key) {
+
+  uint32_t _tag = key >> 3;
+  bytelizer_pbtype_t _type = (bytelizer_pbtype_t)(key & 0b111);
+  uint32_t i = *hint;
+
+  // the next field is tried first
+  if(i >= fields || schema[i].tag != _tag) {
+    for(i = 0; i < fields && schema[i].tag != _tag; ++i);
+    if(i == fields) return -1;
+  }
+
+  const bytelizer_pbfield_t* _field = &schema[i];
+  if(_field->repeated) {
+    if(_type != __pbscalar_wiretype(_field->scalar) && _type != bytelizer_pbtype_length_delimited)
+      return -1;
+  }
+  else if(_type != _field->type) return -1;
+
+  *hint = i + 1;
+  return (int32_t)i;
+}
+
+// the elements of a repeated field in a wire field
+static int64_t __pbview_elements(const bytelizer_pbfield_t* field, const __pbwire_t* wire) {
+
+  bytelizer_pbtype_t _type = (bytelizer_pbtype_t)(wire->key & 0b111);
+  bytelizer_pbtype_t _element = __pbscalar_wiretype(field->scalar);
+
+  // not packed
+  if(_type == _element) return 1;
+
+  // every varint ends with a byte without the continuation bit
+  if(_element == bytelizer_pbtype_varint) {
+    int64_t _count = 0;
+    for(uint32_t i = 0; i < wire->length; ++i)
+      _count += wire->value[i] < 0x80;
+    return _count;
+  }
+
+  uint32_t _width = _element == bytelizer_pbtype_32bit ? sizeof(uint32_t) : sizeof(uint64_t);
+  if(wire->length % _width != 0) {
+    __bytelizer_log("packed fixed field %u is not aligned to %u bytes", field->tag, _width);
+    return -1;
+  }
+
+  return wire->length / _width;
+}
+
+static bytelizer_pbview_t* __pbview_decode(const uint8_t* data, const uint8_t* end,
+const bytelizer_pbfield_t* schema, bytelizer_arena_t* arena, uint32_t depth);
+
+// append the elements of a wire field to a repeated slot
+static bool __pbview_append(bytelizer_pbslot_t* slot, const bytelizer_pbfield_t* field,
+const __pbwire_t* wire, bytelizer_arena_t* arena, uint32_t depth) {
+
+  bytelizer_pbtype_t _type = (bytelizer_pbtype_t)(wire->key & 0b111);
+  uint32_t _width = __pbscalar_width(field->scalar);
+  uint8_t* _items = slot->value.array;
+
+  switch(field->scalar) {
+
+    case bytelizer_pbscalar_bytes:
+      ((bytelizer_pbslice_t *)_items)[slot->count++] =
+        (bytelizer_pbslice_t) { .data = wire->value, .length = wire->length };
+      return true;
+
+    case bytelizer_pbscalar_message: {
+      const bytelizer_pbfield_t* _schema = field->value.array.data
+        ? ((const bytelizer_pbfield_t* const *)field->value.array.data)[0] : NULL;
+      bytelizer_pbview_t* _view = NULL;
+      if(_schema != NULL) {
+        _view = __pbview_decode(wire->value, wire->value + wire->length, _schema, arena, depth + 1);
+        if(_view == NULL) return false;
+      }
+      ((bytelizer_pbview_t **)_items)[slot->count++] = _view;
+      return true;
+    }
+
+    default:
+      break;
+  }
+
+  // a single element
+  if(_type == bytelizer_pbtype_varint) {
+    __pbscalar_store(field->scalar, _items + (size_t)slot->count++ * _width, wire->varint);
+    return true;
+  }
+
+  if(_type == bytelizer_pbtype_32bit) {
+    uint32_t _value; memcpy(&_value, wire->value, sizeof(uint32_t));
+    __pbscalar_store(field->scalar, _items + (size_t)slot->count++ * _width, bitwise_le32(_value));
+    return true;
+  }
+
+  if(_type == bytelizer_pbtype_64bit) {
+    uint64_t _value; memcpy(&_value, wire->value, sizeof(uint64_t));
+    __pbscalar_store(field->scalar, _items + (size_t)slot->count++ * _width, bitwise_le64(_value));
+    return true;
+  }
+
+  // packed
+  if(wire->length == 0) return true;
+
+  const uint8_t* _cursor = wire->value;
+  const uint8_t* _end = wire->value + wire->length;
+  bytelizer_pbtype_t _element = __pbscalar_wiretype(field->scalar);
+
+  if(_element == bytelizer_pbtype_varint) {
+    while(_cursor < _end) {
+      uint64_t _value;
+      uint32_t _length = __varint_decode(_cursor, _end, &_value);
+      if(_length == 0) {
+        __bytelizer_log("truncated packed varint, tag %u", field->tag);
+        return false;
+      }
+      __pbscalar_store(field->scalar, _items + (size_t)slot->count++ * _width, _value);
+      _cursor += _length;
+    }
+    return true;
+  }
+
+#if BYTELIZER_ENDIANNESS == BYTELIZER_LITTLE_ENDIAN
+  memcpy(_items + (size_t)slot->count * _width, _cursor, wire->length);
+  slot->count += wire->length / _width;
+#else
+  for(; _cursor < _end; _cursor += _width) {
+    uint64_t _value;
+    if(_width == sizeof(uint32_t)) {
+      uint32_t _u32; memcpy(&_u32, _cursor, sizeof(uint32_t));
+      _value = bitwise_le32(_u32);
+    }
+    else {
+      memcpy(&_value, _cursor, sizeof(uint64_t));
+      _value = bitwise_le64(_value);
+    }
+    __pbscalar_store(field->scalar, _items + (size_t)slot->count++ * _width, _value);
+  }
+#endif
+
+  return true;
+}
+
+static bytelizer_pbview_t* __pbview_decode(const uint8_t* data, const uint8_t* end,
+const bytelizer_pbfield_t* schema, bytelizer_arena_t* arena, uint32_t depth) {
+
+  if(depth > BYTELIZER_PBSTRUCT_DEPTH) {
+    __bytelizer_log("protobuf struct is nested too deep");
+    return NULL;
+  }
+
+  uint32_t _fields = 0;
+  bool _repeated = false;
+  for(; schema[_fields].tag != 0; ++_fields)
+    _repeated |= schema[_fields].repeated;
+
+  bytelizer_pbview_t* _view = bytelizer_arena_push_zero(arena,
+    sizeof(bytelizer_pbview_t) + _fields * sizeof(bytelizer_pbslot_t));
+  if(_view == NULL) return NULL;
+
+  _view->schema = schema;
+  _view->fields = _fields;
+
+  const uint8_t* _cursor;
+  uint32_t _hint;
+  __pbwire_t _wire;
+  int _result;
+
+  // count the elements first, so the arrays are allocated once
+  if(_repeated) {
+
+    for(_cursor = data, _hint = 0; (_result = __pbwire_next(&_cursor, end, &_wire)) > 0;) {
+
+      int32_t _index = __pbview_match(schema, _fields, &_hint, _wire.key);
+      if(_index < 0 || !schema[_index].repeated) continue;
+
+      int64_t _count = __pbview_elements(&schema[_index], &_wire);
+      if(_count < 0) return NULL;
+      _view->slots[_index].count += (uint32_t)_count;
+    }
+
+    if(_result < 0) return NULL;
+
+    for(uint32_t i = 0; i < _fields; ++i) {
+
+      bytelizer_pbslot_t* _slot = &_view->slots[i];
+      if(!schema[i].repeated || _slot->count == 0) continue;
+
+      uint64_t _size = (uint64_t)_slot->count * __pbscalar_width(schema[i].scalar);
+      if(_size > UINT32_MAX) return NULL;
+
+      _slot->value.array = bytelizer_arena_push(arena, (uint32_t)_size);
+      if(_slot->value.array == NULL) return NULL;
+      _slot->count = 0;
+    }
+  }
+
+  for(_cursor = data, _hint = 0; (_result = __pbwire_next(&_cursor, end, &_wire)) > 0;) {
+
+    int32_t _index = __pbview_match(schema, _fields, &_hint, _wire.key);
+    if(_index < 0) continue;
+
+    const bytelizer_pbfield_t* _field = &schema[_index];
+    bytelizer_pbslot_t* _slot = &_view->slots[_index];
+
+    if(_field->repeated) {
+      if(!__pbview_append(_slot, _field, &_wire, arena, depth)) return NULL;
+      continue;
+    }
+
+    // the last occurrence wins
+    switch(_field->type) {
+
+      case bytelizer_pbtype_varint:
+        if(_field->scalar == bytelizer_pbscalar_sint32)
+          _slot->value.svarint = __zigzag_decode32((uint32_t)_wire.varint);
+        else if(_field->scalar == bytelizer_pbscalar_sint64)
+          _slot->value.svarint = __zigzag_decode64(_wire.varint);
+        else
+          _slot->value.varint = _wire.varint;
+        break;
+
+      case bytelizer_pbtype_32bit: {
+        uint32_t _value; memcpy(&_value, _wire.value, sizeof(uint32_t));
+        _slot->value.fixed32 = bitwise_le32(_value);
+        break;
+      }
+
+      case bytelizer_pbtype_64bit: {
+        uint64_t _value; memcpy(&_value, _wire.value, sizeof(uint64_t));
+        _slot->value.fixed64 = bitwise_le64(_value);
+        break;
+      }
+
+      case bytelizer_pbtype_length_delimited:
+        if(!_field->subtags) {
+          _slot->value.bytes = (bytelizer_pbslice_t) { .data = _wire.value, .length = _wire.length };
+          break;
+        }
+
+        if(_field->value.message != NULL) {
+          _slot->value.message = __pbview_decode(_wire.value, _wire.value + _wire.length,
+            _field->value.message, arena, depth + 1);
+          if(_slot->value.message == NULL) return NULL;
+        }
+        break;
+
+      default:
+        break;
+    }
+
+    ++_slot->count;
+  }
+
+  return _result < 0 ? NULL : _view;
+}
+
+bytelizer_pbview_t* bytelizer_pbview_decode(const uint8_t* data, uint32_t length,
+const bytelizer_pbfield_t* schema, bytelizer_arena_t* arena) {
+
+  if(schema == NULL) return NULL;
+  return __pbview_decode(data, data + length, schema, arena, 0);
+}
+
+bytelizer_pbview_t* bytelizer_get_pbview(bytelizer_ctx_t* ctx,
+const bytelizer_pbfield_t* schema, bytelizer_arena_t* arena) {
+
+  // the slices point into the buffer, it must be a single piece
+  if(ctx->blocks != NULL) {
+    __bytelizer_log("protobuf view can only be decoded from a linear buffer");
+    return NULL;
+  }
+
+  uint32_t _length = bytelizer_remain(ctx);
+  bytelizer_pbview_t* _view = bytelizer_pbview_decode(ctx->cursor, _length, schema, arena);
+
+  if(_view != NULL)
+    bytelizer_update_cursor(ctx, _length);
+
+  return _view;
+}
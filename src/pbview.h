@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#ifndef _BYTELIZER_PBVIEW_H
+#define _BYTELIZER_PBVIEW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <bytelizer/common.h>
+
+#include "compiler.h"
+#include "codec.h"
+#include "arena.h"
+#include "protobuf.h"
+
+/*
+  A view decodes a message by a PBSTRUCT schema without copying or
+  allocating, the values of the schema are not touched:
+
+    bytelizer_arena_alloc(arena, 4096);
+      bytelizer_pbview_t* view = bytelizer_pbview_decode(data, length, schema, arena);
+      bytelizer_pbview_get_bytes(view, 2, &name);      // a slice of the data
+    bytelizer_arena_destroy(arena);
+
+  Bytes are slices into the input, nested messages and repeated fields
+  are allocated from the arena, so the input must be a single piece and
+  stay alive with the view. The element schema of a PB_REPEATED_MESSAGE
+  is the first element of its array.
+*/
+
+typedef struct _bytelizer_pbview_t bytelizer_pbview_t;
+
+typedef struct {
+  // the occurrences, the element count of a repeated field
+  uint32_t count;
+  union {
+    uint64_t varint;
+    int64_t svarint;
+    uint32_t fixed32;
+    uint64_t fixed64;
+    bytelizer_pbslice_t bytes;
+    bytelizer_pbview_t* message;
+
+    // the elements of a repeated field, the same types as the caller
+    // arrays of the schema, bytelizer_pbslice_t for bytes and
+    // bytelizer_pbview_t* for messages
+    void* array;
+  } value;
+} bytelizer_pbslot_t;
+
+struct _bytelizer_pbview_t {
+  const bytelizer_pbfield_t* schema;
+  uint32_t fields;
+  // one slot for every field of the schema
+  bytelizer_pbslot_t slots[];
+};
+
+/**
+ * @brief decode a message into a view
+ * @param data the wire bytes
+ * @param length the length of the message
+ * @param schema the protobuf struct describing the message
+ * @param arena the arena holding the view
+ * @return the view, NULL if the message is malformed or the arena is full
+ */
+bytelizer_pbview_t* bytelizer_pbview_decode(const uint8_t* data, uint32_t length,
+const bytelizer_pbfield_t* schema, bytelizer_arena_t* arena);
+
+/**
+ * @brief decode the rest of an attached buffer into a view,
+ * the cursor is moved to the end if the message is good
+ * @param ctx the bytelizer context
+ * @param schema the protobuf struct describing the message
+ * @param arena the arena holding the view
+ */
+bytelizer_pbview_t* bytelizer_get_pbview(bytelizer_ctx_t* ctx,
+const bytelizer_pbfield_t* schema, bytelizer_arena_t* arena);
+
+/**
+ * @brief find the slot of a field
+ * @param view the view
+ * @param tag the field number
+ * @return the slot, NULL if the schema has no such field
+ */
+_inline static const bytelizer_pbslot_t* bytelizer_pbview_slot(const bytelizer_pbview_t* view, uint32_t tag) {
+
+  for(uint32_t i = 0; i < view->fields; ++i)
+    if(view->schema[i].tag == tag) return &view->slots[i];
+
+  return NULL;
+}
+
+/**
+ * @brief check whether a field is present
+ * @param view the view
+ * @param tag the field number
+ */
+_inline static bool bytelizer_pbview_has(const bytelizer_pbview_t* view, uint32_t tag) {
+  const bytelizer_pbslot_t* _slot = bytelizer_pbview_slot(view, tag);
+  return _slot != NULL && _slot->count != 0;
+}
+
+#define __DEFINE_PBVIEW_GET(name, type, member) \
+  _inline static bool bytelizer_pbview_get_##name(const bytelizer_pbview_t* view, uint32_t tag, type* value) { \
+    const bytelizer_pbslot_t* _slot = bytelizer_pbview_slot(view, tag); \
+    if(_slot == NULL || _slot->count == 0) return false; \
+    *value = _slot->value.member; \
+    return true; \
+  }
+
+/**
+ * @brief get a present field of the view, false if it is absent
+ * @param view the view
+ * @param tag the field number
+ * @param value the value
+ */
+__DEFINE_PBVIEW_GET(varint, uint64_t, varint)
+__DEFINE_PBVIEW_GET(svarint, int64_t, svarint)
+__DEFINE_PBVIEW_GET(fixed32, uint32_t, fixed32)
+__DEFINE_PBVIEW_GET(fixed64, uint64_t, fixed64)
+__DEFINE_PBVIEW_GET(bytes, bytelizer_pbslice_t, bytes)
+__DEFINE_PBVIEW_GET(message, bytelizer_pbview_t*, message)
+
+#undef __DEFINE_PBVIEW_GET
+
+/**
+ * @brief get the elements of a repeated field
+ * @param view the view
+ * @param tag the field number
+ * @param count the count of elements
+ * @return the elements, NULL if there is none
+ */
+_inline static const void* bytelizer_pbview_get_array(const bytelizer_pbview_t* view,
+uint32_t tag, uint32_t* count) {
+
+  const bytelizer_pbslot_t* _slot = bytelizer_pbview_slot(view, tag);
+  *count = _slot ? _slot->count : 0;
+
+  return *count ? _slot->value.array : NULL;
+}
+
+#endif /* _BYTELIZER_PBVIEW_H */
@@ -9,185 +9,682 @@
 
 #include <stdint.h>
 #include <string.h>
+#include <stdlib.h>
 
 #include "codec.h"
 #include "protobuf.h"
 #include "advanced.h"
+#include "varint.h"
+#include "bitwise.h"
 #include "debug/log.h"
+#include "pbmask.h"
 
-_inline static uint32_t __number_tovarint(uint64_t value, uint8_t* varint) {
+bool __pbsizes_grow(__pbsizes_t* sizes) {
 
-  uint32_t _len = 0;
+  uint32_t _capacity = sizes->capacity * 2;
+  uint32_t* _sizes = sizes->sizes == sizes->stack
+    ? malloc(_capacity * sizeof(uint32_t))
+    : realloc(sizes->sizes, _capacity * sizeof(uint32_t));
 
-  // encode every 8 bits
-  if(value >= 127) {
-    do{
-      varint[_len] = (uint8_t)((value & 0x7f) | 0x80);
-      value >>= 7;
-      ++_len;
-    } while(value > 127);
+  if(_sizes == NULL) {
+    __bytelizer_log("growing the protobuf size cache failed");
+    sizes->failed = true;
+    return false;
   }
 
-  varint[_len] = (uint8_t)value;
-  ++_len;
+  if(sizes->sizes == sizes->stack)
+    memcpy(_sizes, sizes->stack, sizes->count * sizeof(uint32_t));
 
-  return _len;
+  sizes->sizes = _sizes;
+  sizes->capacity = _capacity;
+  return true;
+}
+
+_inline static uint32_t __pbfixed_width(bytelizer_pbtype_t type) {
+  return type == bytelizer_pbtype_32bit ? sizeof(uint32_t) : sizeof(uint64_t);
 }
 
-_inline static uint64_t __varint_to_number(uint8_t* varint, uint8_t varint_len) {
-  uint64_t _result = 0;
+static uint32_t __pbstruct_measure(const bytelizer_pbfield_t* field, __pbsizes_t* sizes);
+static uint8_t* __pbstruct_write(uint8_t* cursor, uint8_t* end,
+const bytelizer_pbfield_t* field, __pbsizes_t* sizes);
+
+// the size of a repeated field, the body of a packed one is cached
+static uint32_t __pbarray_measure(const bytelizer_pbfield_t* field, __pbsizes_t* sizes) {
 
-  for(size_t i = varint_len - 1; i >= 0 ; --i) {
-    _result <<= 7;
-    _result |= varint[i] & 0x7f;
+  uint32_t _count = field->value.array.count;
+  if(_count == 0) return 0;
+
+  bytelizer_pbtype_t _type = __pbscalar_wiretype(field->scalar);
+  uint32_t _tag = __varint_length(field->tag << 3 | field->type);
+  uint32_t _body = 0;
+
+  if(field->scalar == bytelizer_pbscalar_bytes) {
+    const bytelizer_pbslice_t* _items = field->value.array.data;
+    for(uint32_t i = 0; i < _count; ++i)
+      _body += _tag + __varint_length(_items[i].length) + _items[i].length;
+    return _body;
   }
 
-  return _result;
+  if(field->scalar == bytelizer_pbscalar_message) {
+    const bytelizer_pbfield_t* const* _items = field->value.array.data;
+    for(uint32_t i = 0; i < _count; ++i) {
+      uint32_t _slot = __pbsizes_reserve(sizes);
+      uint32_t _size = _items[i] ? __pbstruct_measure(_items[i], sizes) : 0;
+      if(sizes->failed) return 0;
+      sizes->sizes[_slot] = _size;
+      _body += _tag + __varint_length(_size) + _size;
+    }
+    return _body;
+  }
+
+  // every varint element is measured once
+  if(_type == bytelizer_pbtype_varint) {
+    __pbarray_foreach(field, false, _body += __varint_length(_wire));
+  }
+  else _body = _count * __pbfixed_width(_type);
+
+  // packed, a single tag and length
+  if(__pbfield_packed(field)) {
+    uint32_t _slot = __pbsizes_reserve(sizes);
+    if(sizes->failed) return 0;
+    sizes->sizes[_slot] = _body;
+    return _tag + __varint_length(_body) + _body;
+  }
+
+  return _count * _tag + _body;
 }
 
-_inline static void bytelizer_put_varint(bytelizer_ctx_t* ctx, uint64_t value) {
-  uint8_t _buffer[10];
-  uint32_t _length = __number_tovarint(value, _buffer);
-  bytelizer_put_bytes(ctx, _buffer, _length);
+// 1st pass, the sizes from the bottom up
+static uint32_t __pbstruct_measure(const bytelizer_pbfield_t* field, __pbsizes_t* sizes) {
+
+  uint32_t _size = 0;
+
+  for(; field->tag != 0; ++field) {
+
+    if(field->repeated) {
+      _size += __pbarray_measure(field, sizes);
+      if(sizes->failed) return 0;
+      continue;
+    }
+
+    _size += __varint_length(field->tag << 3 | field->type);
+
+    switch(field->type) {
+
+      case bytelizer_pbtype_varint:
+        _size += __varint_length(__pbfield_varint(field));
+        break;
+
+      case bytelizer_pbtype_32bit:
+        _size += sizeof(uint32_t);
+        break;
+
+      case bytelizer_pbtype_64bit:
+        _size += sizeof(uint64_t);
+        break;
+
+      case bytelizer_pbtype_length_delimited: {
+
+        uint32_t _body = field->value.length_delimited.length;
+
+        // the slot is taken before the children, so the order is the same as writing
+        if(field->subtags) {
+          uint32_t _slot = __pbsizes_reserve(sizes);
+          _body = field->value.message ? __pbstruct_measure(field->value.message, sizes) : 0;
+          if(sizes->failed) return 0;
+          sizes->sizes[_slot] = _body;
+        }
+
+        _size += __varint_length(_body) + _body;
+        break;
+      }
+
+      default:
+        __bytelizer_log("uknown tag %d", field->tag);
+    }
+  }
+
+  return _size;
+}
+
+_inline static uint8_t* __pbfixed_write(uint8_t* cursor, bytelizer_pbtype_t type, uint64_t value) {
+
+  if(type == bytelizer_pbtype_32bit) {
+    uint32_t _value = bitwise_le32((uint32_t)value);
+    memcpy(cursor, &_value, sizeof(uint32_t));
+    return cursor + sizeof(uint32_t);
+  }
+
+  uint64_t _value = bitwise_le64(value);
+  memcpy(cursor, &_value, sizeof(uint64_t));
+  return cursor + sizeof(uint64_t);
 }
 
-_inline static void bytelizer_get_varint(bytelizer_ctx_t* ctx, uint64_t* value) {
-  
-  uint8_t _b = 0;
-  uint64_t _value = 0;
+static uint8_t* __pbarray_write(uint8_t* cursor, uint8_t* end,
+const bytelizer_pbfield_t* field, __pbsizes_t* sizes) {
+
+  uint32_t _count = field->value.array.count;
+  if(_count == 0) return cursor;
+
+  bytelizer_pbtype_t _type = __pbscalar_wiretype(field->scalar);
+  uint64_t _tag = field->tag << 3 | field->type;
+
+  if(field->scalar == bytelizer_pbscalar_bytes) {
+    const bytelizer_pbslice_t* _items = field->value.array.data;
+    for(uint32_t i = 0; i < _count; ++i) {
+      cursor += __varint_encode(_tag, cursor, end);
+      cursor += __varint_encode(_items[i].length, cursor, end);
+      if(_items[i].length != 0) memcpy(cursor, _items[i].data, _items[i].length);
+      cursor += _items[i].length;
+    }
+    return cursor;
+  }
+
+  if(field->scalar == bytelizer_pbscalar_message) {
+    const bytelizer_pbfield_t* const* _items = field->value.array.data;
+    for(uint32_t i = 0; i < _count; ++i) {
+      cursor += __varint_encode(_tag, cursor, end);
+      cursor += __varint_encode(sizes->sizes[sizes->cursor++], cursor, end);
+      if(_items[i] != NULL) cursor = __pbstruct_write(cursor, end, _items[i], sizes);
+    }
+    return cursor;
+  }
 
-  do {
+  // one tag per element
+  if(!__pbfield_packed(field)) {
 
-    // get one byte
-    bytelizer_get_uint8(ctx, &_b);
+    if(_type == bytelizer_pbtype_varint) {
+      __pbarray_foreach(field, false, {
+        cursor += __varint_encode(_tag, cursor, end);
+        cursor += __varint_encode(_wire, cursor, end);
+      });
+    }
 
-    // teardown varint bytes
-    _value <<= 7;
-    _value |= _b & 0x7f;
+    else {
+      __pbarray_foreach(field, false, {
+        cursor += __varint_encode(_tag, cursor, end);
+        cursor = __pbfixed_write(cursor, _type, _wire);
+      });
+    }
+
+    return cursor;
+  }
 
-  } while((_b & 0b10000000) > 0);
+  // packed, the body length is measured already
+  cursor += __varint_encode(_tag, cursor, end);
+  cursor += __varint_encode(sizes->sizes[sizes->cursor++], cursor, end);
 
-  if(value) *value = _value;
+  if(_type == bytelizer_pbtype_varint) {
+    __pbarray_foreach(field, false, cursor += __varint_encode(_wire, cursor, end));
+    return cursor;
+  }
+
+#if BYTELIZER_ENDIANNESS == BYTELIZER_LITTLE_ENDIAN
+  // the fixed elements are the same as in memory
+  uint32_t _length = _count * __pbfixed_width(_type);
+  memcpy(cursor, field->value.array.data, _length);
+  return cursor + _length;
+#else
+  __pbarray_foreach(field, false, cursor = __pbfixed_write(cursor, _type, _wire));
+  return cursor;
+#endif
 }
 
-void bytelizer_put_pbstruct(bytelizer_ctx_t* ctx, const bytelizer_pbfield_t* pbroot) {
+// 2nd pass, straight into the reserved space
+static uint8_t* __pbstruct_write(uint8_t* cursor, uint8_t* end,
+const bytelizer_pbfield_t* field, __pbsizes_t* sizes) {
 
-  if(pbroot == NULL) return;
+  for(; field->tag != 0; ++field) {
 
-  while(pbroot->tag != 0) {
+    if(field->repeated) {
+      cursor = __pbarray_write(cursor, end, field, sizes);
+      continue;
+    }
 
     // put the tag
-    bytelizer_put_varint(ctx, pbroot->tag << 3 | pbroot->type);
+    cursor += __varint_encode(field->tag << 3 | field->type, cursor, end);
 
     // put the value
-    switch(pbroot->type) {
+    switch(field->type) {
 
       case bytelizer_pbtype_varint:
-        bytelizer_put_varint(ctx, pbroot->value.varint);
+        cursor += __varint_encode(__pbfield_varint(field), cursor, end);
         break;
 
-      case bytelizer_pbtype_32bit:
-        bytelizer_put_uint32(ctx, pbroot->value.fixed32);
+      case bytelizer_pbtype_32bit: {
+        uint32_t _value = bitwise_le32(field->value.fixed32);
+        memcpy(cursor, &_value, sizeof(uint32_t));
+        cursor += sizeof(uint32_t);
         break;
-      
-      case bytelizer_pbtype_64bit:
-        bytelizer_put_uint64(ctx, pbroot->value.fixed64);
+      }
+
+      case bytelizer_pbtype_64bit: {
+        uint64_t _value = bitwise_le64(field->value.fixed64);
+        memcpy(cursor, &_value, sizeof(uint64_t));
+        cursor += sizeof(uint64_t);
         break;
+      }
 
       case bytelizer_pbtype_length_delimited: {
 
-        // allocate new buffer for sub struct encoding
-        bytelizer_alloc(_ctx, 512); {
-          if(pbroot->subtags)
-            bytelizer_put_pbstruct(_ctx, pbroot->value.message);
-          else
-            bytelizer_put_bytes(_ctx, pbroot->value.length_delimited.data,
-                                      pbroot->value.length_delimited.length);
+        if(field->subtags) {
+          cursor += __varint_encode(sizes->sizes[sizes->cursor++], cursor, end);
+          if(field->value.message != NULL)
+            cursor = __pbstruct_write(cursor, end, field->value.message, sizes);
+          break;
         }
 
-        // put the length in varint
-        bytelizer_put_varint(ctx, bytelizer_length(_ctx));
-
-        // copy data
-        bytelizer_put_bytelizer(ctx, _ctx);
-        bytelizer_destroy(_ctx);
+        uint32_t _length = field->value.length_delimited.length;
+        cursor += __varint_encode(_length, cursor, end);
+        if(_length != 0) memcpy(cursor, field->value.length_delimited.data, _length);
+        cursor += _length;
         break;
       }
 
       default:
-        __bytelizer_log("uknown tag %d", pbroot->tag);
+        break;
     }
+  }
+
+  return cursor;
+}
+
+uint32_t bytelizer_pbstruct_size(const bytelizer_pbfield_t* pbroot) {
+
+  if(pbroot == NULL) return 0;
 
-    ++pbroot;
+  __pbsizes_init(_sizes);
+  uint32_t _size = __pbstruct_measure(pbroot, &_sizes);
+  __pbsizes_release(_sizes);
+
+  return _size;
+}
+
+uint32_t __pbstruct_measure_sizes(const bytelizer_pbfield_t* pbroot, __pbsizes_t* sizes) {
+  return __pbstruct_measure(pbroot, sizes);
+}
+
+uint8_t* __pbstruct_write_sizes(uint8_t* cursor, uint8_t* end, const bytelizer_pbfield_t* pbroot, __pbsizes_t* sizes) {
+  return __pbstruct_write(cursor, end, pbroot, sizes);
+}
+
+bool __pbstruct_encode(const bytelizer_pbfield_t* pbroot, uint8_t* buffer, uint32_t size) {
+
+  __pbsizes_init(_sizes);
+
+  bool _result = __pbstruct_measure(pbroot, &_sizes) == size && !_sizes.failed;
+  if(_result) __pbstruct_write(buffer, buffer + size, pbroot, &_sizes);
+
+  __pbsizes_release(_sizes);
+  return _result;
+}
+
+bool __pbstruct_put(bytelizer_ctx_t* ctx, const bytelizer_pbfield_t* pbroot, bool delimited) {
+
+  bool _result = false;
+  __pbsizes_init(_sizes);
+
+  // measure every message once
+  uint32_t _size = __pbstruct_measure(pbroot, &_sizes);
+  if(_sizes.failed) goto release;
+
+  // then the whole struct goes into one linear space
+  uint32_t _prefix = delimited ? __varint_length(_size) : 0;
+  if(_prefix + _size != 0) {
+
+    if(!bytelizer_ensure_available(ctx, _prefix + _size)) {
+      __bytelizer_log("put protobuf struct failed, is it out of memory?");
+      goto release;
+    }
+
+    if(delimited)
+      __varint_encode(_size, ctx->cursor, ctx->cursor + _prefix + _size);
+
+    __pbstruct_write(ctx->cursor + _prefix, ctx->cursor + _prefix + _size, pbroot, &_sizes);
+    bytelizer_update_cursor(ctx, _prefix + _size);
   }
 
+  _result = true;
+
+release:
+  __pbsizes_release(_sizes);
+  return _result;
 }
 
-bool bytelizer_get_pbstruct(bytelizer_ctx_t* ctx, bytelizer_pbfield_t* pbroot) {
+void bytelizer_put_pbstruct(bytelizer_ctx_t* ctx, const bytelizer_pbfield_t* pbroot) {
+  if(pbroot != NULL) __pbstruct_put(ctx, pbroot, false);
+}
 
-  if(pbroot == NULL) return false;
-  
-  while(pbroot->tag != 0) {
+bool bytelizer_put_pbdelimited(bytelizer_ctx_t* ctx, const bytelizer_pbfield_t* pbroot) {
+  return pbroot != NULL && __pbstruct_put(ctx, pbroot, true);
+}
+
+// find the descriptor of a wire tag, the next field is tried first
+_inline static bytelizer_pbfield_t* __pbstruct_find(bytelizer_pbfield_t* pbroot,
+bytelizer_pbfield_t* hint, uint32_t tag) {
+
+  if(hint->tag == tag) return hint;
+
+  for(bytelizer_pbfield_t* _field = pbroot; _field->tag != 0; ++_field)
+    if(_field->tag == tag) return _field;
+
+  return NULL;
+}
+
+bool __pbarray_decode(const uint8_t* cursor, const uint8_t* end, bytelizer_pbfield_t* field) {
+
+  bytelizer_pbtype_t _type = __pbscalar_wiretype(field->scalar);
+
+  if(_type == bytelizer_pbtype_varint) {
+    while(cursor < end) {
+      uint64_t _wire;
+      uint32_t _length = __varint_decode(cursor, end, &_wire);
+      if(_length == 0) {
+        __bytelizer_log("truncated packed varint, tag %u", field->tag);
+        return false;
+      }
+      if(!__pbarray_push(field, _wire)) return false;
+      cursor += _length;
+    }
+    return true;
+  }
+
+  uint32_t _width = __pbfixed_width(_type);
+  uint32_t _count = (uint32_t)(end - cursor) / _width;
+
+  if((uint32_t)(end - cursor) % _width != 0) {
+    __bytelizer_log("packed fixed field %u is not aligned to %u bytes", field->tag, _width);
+    return false;
+  }
+
+  if(_count > field->value.array.capacity - field->value.array.count) {
+    __bytelizer_log("protobuf repeated tag %u is over the capacity %u",
+      field->tag, field->value.array.capacity);
+    return false;
+  }
+
+#if BYTELIZER_ENDIANNESS == BYTELIZER_LITTLE_ENDIAN
+  memcpy((uint8_t *)field->value.array.data + (size_t)field->value.array.count * _width,
+    cursor, (size_t)_count * _width);
+  field->value.array.count += _count;
+#else
+  for(; cursor < end; cursor += _width) {
+    uint64_t _wire;
+    if(_width == sizeof(uint32_t)) {
+      uint32_t _value; memcpy(&_value, cursor, sizeof(uint32_t));
+      _wire = bitwise_le32(_value);
+    }
+    else {
+      memcpy(&_wire, cursor, sizeof(uint64_t));
+      _wire = bitwise_le64(_wire);
+    }
+    __pbarray_store(field, _wire);
+  }
+#endif
+
+  return true;
+}
+
+// an element of a repeated bytes or message field, or a packed record
+static bool __pbarray_decode_delimited(const uint8_t* cursor, const uint8_t* end,
+bytelizer_pbfield_t* field, const bytelizer_pbmask_t* mask, uint32_t depth) {
+
+  if(field->scalar != bytelizer_pbscalar_bytes && field->scalar != bytelizer_pbscalar_message)
+    return __pbarray_decode(cursor, end, field);
+
+  if(field->value.array.count >= field->value.array.capacity) {
+    __bytelizer_log("protobuf repeated tag %u is over the capacity %u",
+      field->tag, field->value.array.capacity);
+    return false;
+  }
+
+  uint32_t _index = field->value.array.count++;
+
+  if(field->scalar == bytelizer_pbscalar_bytes) {
+    bytelizer_pbslice_t* _items = field->value.array.data;
+    _items[_index] = (bytelizer_pbslice_t) { .data = cursor, .length = (uint32_t)(end - cursor) };
+    return true;
+  }
+
+  // every element is a message of its own
+  bytelizer_pbfield_t** _items = field->value.array.data;
+  if(_items[_index] == NULL) return true;
+
+  __pbstruct_reset(_items[_index], mask, depth + 1);
+  return __pbstruct_decode(cursor, end, _items[_index], mask, depth + 1);
+}
+
+void __pbstruct_reset(bytelizer_pbfield_t* pbroot, const bytelizer_pbmask_t* mask, uint32_t depth) {
+
+  if(depth > BYTELIZER_PBSTRUCT_DEPTH) return;
+
+  for(bytelizer_pbfield_t* _field = pbroot; _field->tag != 0; ++_field) {
+
+    const __pbmask_entry_t* _entry = NULL;
+    if(mask != NULL && (_entry = __pbmask_find(mask, _field->tag)) == NULL) continue;
+
+    if(_field->repeated)
+      _field->value.array.count = 0;
+    else if(_field->subtags && _field->value.message != NULL)
+      __pbstruct_reset(_field->value.message, _entry ? _entry->child : NULL, depth + 1);
+  }
+}
+
+bool __pbstruct_decode(const uint8_t* cursor, const uint8_t* end,
+bytelizer_pbfield_t* pbroot, const bytelizer_pbmask_t* mask, uint32_t depth) {
+
+  if(depth > BYTELIZER_PBSTRUCT_DEPTH) {
+    __bytelizer_log("protobuf struct is nested too deep");
+    return false;
+  }
+
+  bytelizer_pbfield_t* _hint = pbroot;
+  uint64_t _varint;
+  uint32_t _length;
+
+  // the repeated fields are filled from the beginning, a sub message
+  // seen again on the wire is merged and keeps appending
+  if(depth == 0) __pbstruct_reset(pbroot, mask, 0);
+
+  while(cursor < end) {
 
     // get the tag
-    uint64_t _varint = 0;
-    bytelizer_get_varint(ctx, &_varint);
+    if((_length = __varint_decode(cursor, end, &_varint)) == 0) {
+      __bytelizer_log("truncated protobuf tag");
+      return false;
+    }
+    cursor += _length;
+
     bytelizer_pbtype_t _type = (bytelizer_pbtype_t)(_varint & 0b111);
-    uint32_t _tag = ((uint32_t)_varint) >> 3;
+    uint64_t _tag = _varint >> 3;
 
-    // strict type check
-    if(pbroot->tag != _tag || pbroot->type != _type) {
+    if(_tag == 0 || _tag > BYTELIZER_PBTAG_MAX) {
+      __bytelizer_log("invalid protobuf tag %llu", (unsigned long long)_tag);
       return false;
     }
 
-    // set the value
-    switch(pbroot->type) {
+    // the fields out of the mask are not looked into
+    const bytelizer_pbmask_t* _child = NULL;
+    if(mask != NULL) {
+      const __pbmask_entry_t* _entry = __pbmask_find(mask, (uint32_t)_tag);
+      if(_entry == NULL) {
+        if((cursor = __pbfield_skip(cursor, end, _type)) == NULL) {
+          __bytelizer_log("truncated protobuf field, tag %u", (uint32_t)_tag);
+          return false;
+        }
+        continue;
+      }
+      _child = _entry->child;
+    }
+
+    // unknown fields and the ones of another wire type are skipped
+    bytelizer_pbfield_t* _field = __pbstruct_find(pbroot, _hint, (uint32_t)_tag);
+    // a repeated field may come packed or not
+    if(_field != NULL && _field->repeated) {
+      if(_type != __pbscalar_wiretype(_field->scalar) &&
+         _type != bytelizer_pbtype_length_delimited) {
+        __bytelizer_log("protobuf repeated tag %u has wire type %d", (uint32_t)_tag, _type);
+        _field = NULL;
+      }
+    }
+
+    else if(_field != NULL && _field->type != _type) {
+      __bytelizer_log("protobuf tag %u has wire type %d, expected %d",
+        (uint32_t)_tag, _type, _field->type);
+      _field = NULL;
+    }
+
+    if(_field != NULL) _hint = _field + 1;
+
+    // set the value, the last occurrence wins
+    switch(_type) {
 
       case bytelizer_pbtype_varint: {
-        uint64_t _value = 0;
-        bytelizer_get_varint(ctx, &_value);
-        pbroot->value.varint = _value;
+        if((_length = __varint_decode(cursor, end, &_varint)) == 0) {
+          __bytelizer_log("truncated protobuf varint, tag %u", (uint32_t)_tag);
+          return false;
+        }
+        cursor += _length;
+        if(_field == NULL) break;
+        if(!_field->repeated) __pbfield_set_varint(_field, _varint);
+        else if(!__pbarray_push(_field, _varint)) return false;
         break;
       }
 
       case bytelizer_pbtype_32bit: {
-        uint32_t _value = 0;
-        bytelizer_get_uint32(ctx, &_value);
-        pbroot->value.fixed32 = _value;
+        if(end - cursor < (ptrdiff_t)sizeof(uint32_t)) {
+          __bytelizer_log("truncated protobuf fixed32, tag %u", (uint32_t)_tag);
+          return false;
+        }
+        if(_field) {
+          uint32_t _value; memcpy(&_value, cursor, sizeof(uint32_t));
+          if(!_field->repeated) _field->value.fixed32 = bitwise_le32(_value);
+          else if(!__pbarray_push(_field, bitwise_le32(_value))) return false;
+        }
+        cursor += sizeof(uint32_t);
         break;
       }
-      
+
       case bytelizer_pbtype_64bit: {
-        uint64_t _value = 0;
-        bytelizer_get_uint64(ctx, &_value);
-        pbroot->value.fixed64= _value;
+        if(end - cursor < (ptrdiff_t)sizeof(uint64_t)) {
+          __bytelizer_log("truncated protobuf fixed64, tag %u", (uint32_t)_tag);
+          return false;
+        }
+        if(_field) {
+          uint64_t _value; memcpy(&_value, cursor, sizeof(uint64_t));
+          if(!_field->repeated) _field->value.fixed64 = bitwise_le64(_value);
+          else if(!__pbarray_push(_field, bitwise_le64(_value))) return false;
+        }
+        cursor += sizeof(uint64_t);
+        break;
       }
 
       case bytelizer_pbtype_length_delimited: {
-        
-        bytelizer_get_varint(ctx, &_varint);
-
-        // pure bytes
-        if(!pbroot->subtags) {
-          // assume the buffer is linear
-          pbroot->value.length_delimited.data = ctx->cursor;
-          pbroot->value.length_delimited.length = (uint32_t)_varint;
-          bytelizer_update_cursor(ctx, (uint32_t)_varint);
-          break;
+
+        if((_length = __varint_decode(cursor, end, &_varint)) == 0) {
+          __bytelizer_log("truncated protobuf length, tag %u", (uint32_t)_tag);
+          return false;
+        }
+        cursor += _length;
+
+        // the body must be inside the parent
+        if(_varint > (uint64_t)(end - cursor)) {
+          __bytelizer_log("protobuf length %llu of tag %u is out of bounds",
+            (unsigned long long)_varint, (uint32_t)_tag);
+          return false;
         }
 
-        // if contains sub tags
-        // try decode the struct recursively
-        bytelizer_get_pbstruct(ctx, pbroot->value.message);
+        if(_field != NULL) {
+
+          if(_field->repeated) {
+            if(!__pbarray_decode_delimited(cursor, cursor + _varint, _field, _child, depth))
+              return false;
+          }
+
+          // the sub struct is decoded in place, repeated ones are merged
+          else if(_field->subtags) {
+            if(_field->value.message != NULL &&
+               !__pbstruct_decode(cursor, cursor + _varint, _field->value.message, _child, depth + 1))
+              return false;
+          }
+
+          // pure bytes point into the buffer
+          else {
+            _field->value.length_delimited.data = (uint8_t *)cursor;
+            _field->value.length_delimited.length = (uint32_t)_varint;
+          }
+        }
+
+        cursor += _varint;
         break;
       }
 
-      default: 
-        break;
+      default:
+        __bytelizer_log("unsupported protobuf wire type %d, tag %u", _type, (uint32_t)_tag);
+        return false;
     }
+  }
 
-    ++pbroot;
+  return true;
+}
+
+bool __pbstruct_get(bytelizer_ctx_t* ctx, uint32_t length, __pbstruct_decoder_t decode, void* userdata) {
+
+  // bytes point into the buffer, it must be a single piece
+  if(ctx->blocks != NULL) {
+    __bytelizer_log("protobuf struct can only be decoded from a linear buffer");
+    return false;
   }
 
+  if(length > bytelizer_remain(ctx)) {
+    __bytelizer_log("protobuf struct length %u is out of bounds", length);
+    return false;
+  }
+
+  // the cursor is moved only if the whole struct is good
+  if(!decode(ctx->cursor, length, userdata))
+    return false;
+
+  bytelizer_update_cursor(ctx, length);
+  return true;
+}
+
+bool __pbstruct_get_masked(const uint8_t* data, uint32_t length, void* userdata) {
+  __pbstruct_target_t* _target = userdata;
+  return __pbstruct_decode(data, data + length, _target->pbroot, _target->mask, 0);
+}
+
+bool bytelizer_get_pbstruct_ex(bytelizer_ctx_t* ctx, bytelizer_pbfield_t* pbroot, uint32_t length) {
+
+  if(pbroot == NULL) return false;
+
+  __pbstruct_target_t _target = { .pbroot = pbroot, .mask = NULL };
+  return __pbstruct_get(ctx, length, __pbstruct_get_masked, &_target);
+}
+
+bool bytelizer_get_pbdelimited(bytelizer_ctx_t* ctx, bytelizer_pbfield_t* pbroot) {
+
+  if(pbroot == NULL) return false;
+
+  if(ctx->blocks != NULL) {
+    __bytelizer_log("protobuf struct can only be decoded from a linear buffer");
+    return false;
+  }
+
+  const uint8_t* _end = ctx->cursor + bytelizer_remain(ctx);
+  uint64_t _length;
+
+  uint32_t _prefix = __varint_decode(ctx->cursor, _end, &_length);
+  if(_prefix == 0 || _length > (uint64_t)(_end - ctx->cursor - _prefix)) {
+    __bytelizer_log("truncated delimited protobuf struct");
+    return false;
+  }
+
+  // the cursor is moved only if the whole struct is good
+  const uint8_t* _body = ctx->cursor + _prefix;
+  if(!__pbstruct_decode(_body, _body + _length, pbroot, NULL, 0))
+    return false;
+
+  bytelizer_update_cursor(ctx, _prefix + (uint32_t)_length);
   return true;
 }
@@ -13,6 +13,12 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+
+#include "compiler.h"
+#include "codec.h"
+#include "varint.h"
+#include "debug/log.h"
 
 typedef enum {
   bytelizer_pbtype_varint = 0,
@@ -21,12 +27,38 @@ typedef enum {
   bytelizer_pbtype_32bit = 5,
 } bytelizer_pbtype_t;
 
+// the element type of sint and repeated fields
+typedef enum {
+  bytelizer_pbscalar_none = 0,
+  bytelizer_pbscalar_uint32,
+  bytelizer_pbscalar_uint64,
+  bytelizer_pbscalar_int32,
+  bytelizer_pbscalar_int64,
+  bytelizer_pbscalar_sint32,
+  bytelizer_pbscalar_sint64,
+  bytelizer_pbscalar_fixed32,
+  bytelizer_pbscalar_fixed64,
+  bytelizer_pbscalar_float,
+  bytelizer_pbscalar_double,
+  bytelizer_pbscalar_bytes,
+  bytelizer_pbscalar_message,
+} bytelizer_pbscalar_t;
+
+// an element of a repeated bytes field
+typedef struct {
+  const uint8_t* data;
+  uint32_t length;
+} bytelizer_pbslice_t;
+
 typedef struct _bytelizer_pfield_t {
   uint32_t tag;
   bytelizer_pbtype_t type;
   bool subtags;
+  bool repeated;
+  bytelizer_pbscalar_t scalar;
   union {
     uint64_t varint;
+    int64_t svarint;
     uint64_t fixed64;
     struct {
       uint32_t length;
@@ -34,11 +66,125 @@ typedef struct _bytelizer_pfield_t {
     } length_delimited;
     uint32_t fixed32;
     struct _bytelizer_pfield_t* message;
+
+    // the caller array of a repeated field, decoding
+    // fills up to the capacity and sets the count
+    struct {
+      void* data;
+      uint32_t count;
+      uint32_t capacity;
+    } array;
   } value;
 } bytelizer_pbfield_t;
 
+typedef struct _bytelizer_pbmask_t bytelizer_pbmask_t;
+
+// the nested message sizes kept on the stack before spilling into the heap
+#ifndef BYTELIZER_PBSTRUCT_SIZES
+  #define BYTELIZER_PBSTRUCT_SIZES 32
+#endif
+
+// the sizes of the nested messages, in pre-order
+typedef struct {
+  uint32_t* sizes;
+  uint32_t count;
+  uint32_t capacity;
+  uint32_t cursor;
+  bool failed;
+  uint32_t stack[BYTELIZER_PBSTRUCT_SIZES];
+} __pbsizes_t;
+
+#define __pbsizes_init(name) \
+  __pbsizes_t name = { \
+    .sizes = name.stack, \
+    .capacity = BYTELIZER_PBSTRUCT_SIZES, \
+  }
+
+#define __pbsizes_release(name) \
+  if(name.sizes != name.stack) free(name.sizes)
+
+// spill the sizes into the heap, the failed flag is set if it is out of memory
+bool __pbsizes_grow(__pbsizes_t* sizes);
+
+// take the slot of the next nested message
+_inline static uint32_t __pbsizes_reserve(__pbsizes_t* sizes) {
+  if(sizes->count == sizes->capacity && !__pbsizes_grow(sizes)) return 0;
+  return sizes->count++;
+}
+
+/**
+ * @brief put a protobuf struct, the nested message sizes are measured
+ * first, then the struct is written in a single pass without copying
+ * @param ctx the bytelizer context
+ * @param pbroot the protobuf struct
+ */
 void bytelizer_put_pbstruct(bytelizer_ctx_t* ctx, const bytelizer_pbfield_t* pbroot);
 
+/**
+ * @brief put a protobuf struct prefixed by its varint length, the
+ * framing of a message in a delimited stream
+ * @param ctx the bytelizer context
+ * @param pbroot the protobuf struct
+ * @return false if the struct can not be measured or written
+ */
+bool bytelizer_put_pbdelimited(bytelizer_ctx_t* ctx, const bytelizer_pbfield_t* pbroot);
+
+// the maximal nested message depth while decoding
+#ifndef BYTELIZER_PBSTRUCT_DEPTH
+  #define BYTELIZER_PBSTRUCT_DEPTH 64
+#endif
+
+// the largest field number
+#define BYTELIZER_PBTAG_MAX ((1u << 29) - 1)
+
+/**
+ * @brief get a protobuf struct of the given length from a linear
+ * (attached) buffer. The fields may come in any order, unknown fields
+ * are skipped, the last occurrence of a field wins and repeated
+ * messages are merged. Bytes point into the buffer, fields absent
+ * from the wire keep their values. Repeated fields accept packed and
+ * unpacked elements, they are filled from the beginning of the caller
+ * array up to its capacity and the count is set.
+ * @param ctx the bytelizer context
+ * @param pbroot the protobuf struct to be filled
+ * @param length the encoded length of the struct
+ * @return false if the data is malformed, the cursor is not moved
+ */
+bool bytelizer_get_pbstruct_ex(bytelizer_ctx_t* ctx, bytelizer_pbfield_t* pbroot, uint32_t length);
+
+/**
+ * @brief get a protobuf struct taking the rest of the buffer
+ * @param ctx the bytelizer context
+ * @param pbroot the protobuf struct to be filled
+ */
+#define bytelizer_get_pbstruct(ctx, pbroot) \
+  bytelizer_get_pbstruct_ex(ctx, pbroot, bytelizer_remain(ctx))
+
+/**
+ * @brief get a protobuf struct prefixed by its varint length
+ * @param ctx the bytelizer context
+ * @param pbroot the protobuf struct to be filled
+ * @return false if the data is truncated or malformed, the cursor is not moved
+ */
+bool bytelizer_get_pbdelimited(bytelizer_ctx_t* ctx, bytelizer_pbfield_t* pbroot);
+
+/**
+ * @brief get the encoded size of a protobuf struct
+ * @param pbroot the protobuf struct
+ */
+uint32_t bytelizer_pbstruct_size(const bytelizer_pbfield_t* pbroot);
+
+// measure a protobuf struct appending the nested sizes, then write it by them,
+// the writing goes on from the cursor of the sizes
+uint32_t __pbstruct_measure_sizes(const bytelizer_pbfield_t* pbroot, __pbsizes_t* sizes);
+uint8_t* __pbstruct_write_sizes(uint8_t* cursor, uint8_t* end, const bytelizer_pbfield_t* pbroot, __pbsizes_t* sizes);
+
+// put a protobuf struct measured once, with its varint length in front if it is delimited
+bool __pbstruct_put(bytelizer_ctx_t* ctx, const bytelizer_pbfield_t* pbroot, bool delimited);
+
+// encode a protobuf struct into a buffer of its encoded size
+bool __pbstruct_encode(const bytelizer_pbfield_t* pbroot, uint8_t* buffer, uint32_t size);
+
 /**
  * @brief define a varint field
  * @param _tag the field index
@@ -124,6 +270,276 @@ void bytelizer_put_pbstruct(bytelizer_ctx_t* ctx, const bytelizer_pbfield_t* pbr
 
 #define PB_MESSAGE_END {.tag = 0 }
 
+/**
+ * @brief define a zigzag encoded sint32 field
+ * @param _tag the field index
+ * @param _name the name of the field
+ * @param _val the value of the field
+*/
+#define PB_SINT32(_tag, _name, _val) \
+  {.tag = _tag, .type = bytelizer_pbtype_varint, .scalar = bytelizer_pbscalar_sint32, .value.svarint = (int32_t)(_val) }
+
+/**
+ * @brief define a zigzag encoded sint64 field
+ * @param _tag the field index
+ * @param _name the name of the field
+ * @param _val the value of the field
+*/
+#define PB_SINT64(_tag, _name, _val) \
+  {.tag = _tag, .type = bytelizer_pbtype_varint, .scalar = bytelizer_pbscalar_sint64, .value.svarint = (int64_t)(_val) }
+
+#define __PB_ARRAY(_tag, _wire, _scalar, _val, _count) \
+  {.tag = _tag, .type = _wire, .repeated = true, .scalar = _scalar, \
+   .value.array = { .data = (void *)(_val), .count = _count, .capacity = _count }}
+
+/**
+ * @brief define a repeated field, one tag per element
+ * @param _tag the field index
+ * @param _name the name of the field
+ * @param _val the caller array, e.g. uint32_t[] for PB_REPEATED_UINT32
+ * @param _count the count of elements, also the capacity while decoding
+*/
+#define PB_REPEATED_UINT32(_tag, _name, _val, _count) __PB_ARRAY(_tag, bytelizer_pbtype_varint, bytelizer_pbscalar_uint32, _val, _count)
+#define PB_REPEATED_UINT64(_tag, _name, _val, _count) __PB_ARRAY(_tag, bytelizer_pbtype_varint, bytelizer_pbscalar_uint64, _val, _count)
+#define PB_REPEATED_INT32(_tag, _name, _val, _count) __PB_ARRAY(_tag, bytelizer_pbtype_varint, bytelizer_pbscalar_int32, _val, _count)
+#define PB_REPEATED_INT64(_tag, _name, _val, _count) __PB_ARRAY(_tag, bytelizer_pbtype_varint, bytelizer_pbscalar_int64, _val, _count)
+#define PB_REPEATED_SINT32(_tag, _name, _val, _count) __PB_ARRAY(_tag, bytelizer_pbtype_varint, bytelizer_pbscalar_sint32, _val, _count)
+#define PB_REPEATED_SINT64(_tag, _name, _val, _count) __PB_ARRAY(_tag, bytelizer_pbtype_varint, bytelizer_pbscalar_sint64, _val, _count)
+#define PB_REPEATED_FIXED32(_tag, _name, _val, _count) __PB_ARRAY(_tag, bytelizer_pbtype_32bit, bytelizer_pbscalar_fixed32, _val, _count)
+#define PB_REPEATED_FIXED64(_tag, _name, _val, _count) __PB_ARRAY(_tag, bytelizer_pbtype_64bit, bytelizer_pbscalar_fixed64, _val, _count)
+#define PB_REPEATED_FLOAT(_tag, _name, _val, _count) __PB_ARRAY(_tag, bytelizer_pbtype_32bit, bytelizer_pbscalar_float, _val, _count)
+#define PB_REPEATED_DOUBLE(_tag, _name, _val, _count) __PB_ARRAY(_tag, bytelizer_pbtype_64bit, bytelizer_pbscalar_double, _val, _count)
+
+/**
+ * @brief define a packed repeated field, all elements in one length-delimited record
+ * @param _tag the field index
+ * @param _name the name of the field
+ * @param _val the caller array, e.g. int64_t[] for PB_PACKED_SINT64
+ * @param _count the count of elements, also the capacity while decoding
+*/
+#define PB_PACKED_UINT32(_tag, _name, _val, _count) __PB_ARRAY(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_uint32, _val, _count)
+#define PB_PACKED_UINT64(_tag, _name, _val, _count) __PB_ARRAY(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_uint64, _val, _count)
+#define PB_PACKED_INT32(_tag, _name, _val, _count) __PB_ARRAY(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_int32, _val, _count)
+#define PB_PACKED_INT64(_tag, _name, _val, _count) __PB_ARRAY(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_int64, _val, _count)
+#define PB_PACKED_SINT32(_tag, _name, _val, _count) __PB_ARRAY(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_sint32, _val, _count)
+#define PB_PACKED_SINT64(_tag, _name, _val, _count) __PB_ARRAY(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_sint64, _val, _count)
+#define PB_PACKED_FIXED32(_tag, _name, _val, _count) __PB_ARRAY(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_fixed32, _val, _count)
+#define PB_PACKED_FIXED64(_tag, _name, _val, _count) __PB_ARRAY(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_fixed64, _val, _count)
+#define PB_PACKED_FLOAT(_tag, _name, _val, _count) __PB_ARRAY(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_float, _val, _count)
+#define PB_PACKED_DOUBLE(_tag, _name, _val, _count) __PB_ARRAY(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_double, _val, _count)
+
+/**
+ * @brief define a repeated bytes or string field
+ * @param _tag the field index
+ * @param _name the name of the field
+ * @param _val the caller array of bytelizer_pbslice_t
+ * @param _count the count of elements, also the capacity while decoding
+*/
+#define PB_REPEATED_BYTES(_tag, _name, _val, _count) __PB_ARRAY(_tag, bytelizer_pbtype_length_delimited, bytelizer_pbscalar_bytes, _val, _count)
+#define PB_REPEATED_STRING(_tag, _name, _val, _count) PB_REPEATED_BYTES(_tag, _name, _val, _count)
+
+/**
+ * @brief define a repeated message field
+ * @param _tag the field index
+ * @param _name the name of the field
+ * @param _val the caller array of protobuf structs, bytelizer_pbfield_t*[]
+ * @param _count the count of elements, also the capacity while decoding
+*/
+#define PB_REPEATED_MESSAGE(_tag, _name, _val, _count) \
+  {.tag = _tag, .type = bytelizer_pbtype_length_delimited, .subtags = true, .repeated = true, \
+   .scalar = bytelizer_pbscalar_message, .value.array = { .data = (void *)(_val), .count = _count, .capacity = _count }}
+
+// the wire type of an element
+_inline static bytelizer_pbtype_t __pbscalar_wiretype(bytelizer_pbscalar_t scalar) {
+  switch(scalar) {
+    case bytelizer_pbscalar_fixed32:
+    case bytelizer_pbscalar_float: return bytelizer_pbtype_32bit;
+    case bytelizer_pbscalar_fixed64:
+    case bytelizer_pbscalar_double: return bytelizer_pbtype_64bit;
+    case bytelizer_pbscalar_bytes:
+    case bytelizer_pbscalar_message: return bytelizer_pbtype_length_delimited;
+    default: return bytelizer_pbtype_varint;
+  }
+}
+
+// the width of an element in the caller array
+_inline static uint32_t __pbscalar_width(bytelizer_pbscalar_t scalar) {
+  switch(scalar) {
+    case bytelizer_pbscalar_uint32:
+    case bytelizer_pbscalar_int32:
+    case bytelizer_pbscalar_sint32:
+    case bytelizer_pbscalar_fixed32:
+    case bytelizer_pbscalar_float: return sizeof(uint32_t);
+    case bytelizer_pbscalar_bytes: return sizeof(bytelizer_pbslice_t);
+    case bytelizer_pbscalar_message: return sizeof(bytelizer_pbfield_t *);
+    default: return sizeof(uint64_t);
+  }
+}
+
+// a repeated field of scalars in a single length-delimited record
+#define __pbfield_packed(field) \
+  ((field)->type != __pbscalar_wiretype((field)->scalar))
+
+// the varint on the wire of a single varint field
+_inline static uint64_t __pbfield_varint(const bytelizer_pbfield_t* field) {
+  switch(field->scalar) {
+    case bytelizer_pbscalar_sint32: return __zigzag_encode32((int32_t)field->value.svarint);
+    case bytelizer_pbscalar_sint64: return __zigzag_encode64(field->value.svarint);
+    default: return field->value.varint;
+  }
+}
+
+// set a single varint field from the wire
+_inline static void __pbfield_set_varint(bytelizer_pbfield_t* field, uint64_t wire) {
+  switch(field->scalar) {
+    case bytelizer_pbscalar_sint32: field->value.svarint = __zigzag_decode32((uint32_t)wire); break;
+    case bytelizer_pbscalar_sint64: field->value.svarint = __zigzag_decode64(wire); break;
+    default: field->value.varint = wire; break;
+  }
+}
+
+/*
+  Run `body` for every element of a repeated field with `_wire` set to
+  the element value on the wire, zigzag and sign extension applied.
+  The loop is specialized per element type, `backward` is a constant.
+  Bytes and message elements are not scalars, they are not iterated here.
+*/
+#define __PBARRAY_LOOP(field, type, convert, backward, body) { \
+  const type* _items = (const type *)(field)->value.array.data; \
+  uint32_t _count = (field)->value.array.count; \
+  for(uint32_t _i = 0; _i < _count; ++_i) { \
+    uint64_t _wire = convert(_items[(backward) ? _count - 1 - _i : _i]); \
+    body; \
+  } \
+}
+
+#define __pbwire_u32(x) ((uint64_t)(x))
+#define __pbwire_i32(x) ((uint64_t)(int64_t)(x))
+#define __pbwire_s32(x) ((uint64_t)__zigzag_encode32(x))
+#define __pbwire_s64(x) __zigzag_encode64(x)
+#define __pbwire_raw(x) (x)
+
+_inline static uint64_t __pbwire_f32(float value) {
+  uint32_t _bits; memcpy(&_bits, &value, sizeof(uint32_t));
+  return _bits;
+}
+
+_inline static uint64_t __pbwire_f64(double value) {
+  uint64_t _bits; memcpy(&_bits, &value, sizeof(uint64_t));
+  return _bits;
+}
+
+#define __pbarray_foreach(field, backward, body) \
+  switch((field)->scalar) { \
+    case bytelizer_pbscalar_uint32: __PBARRAY_LOOP(field, uint32_t, __pbwire_u32, backward, body) break; \
+    case bytelizer_pbscalar_int32: __PBARRAY_LOOP(field, int32_t, __pbwire_i32, backward, body) break; \
+    case bytelizer_pbscalar_sint32: __PBARRAY_LOOP(field, int32_t, __pbwire_s32, backward, body) break; \
+    case bytelizer_pbscalar_sint64: __PBARRAY_LOOP(field, int64_t, __pbwire_s64, backward, body) break; \
+    case bytelizer_pbscalar_fixed32: __PBARRAY_LOOP(field, uint32_t, __pbwire_u32, backward, body) break; \
+    case bytelizer_pbscalar_float: __PBARRAY_LOOP(field, float, __pbwire_f32, backward, body) break; \
+    case bytelizer_pbscalar_double: __PBARRAY_LOOP(field, double, __pbwire_f64, backward, body) break; \
+    default: __PBARRAY_LOOP(field, uint64_t, __pbwire_raw, backward, body) break; \
+  }
+
+// store a scalar element from the wire
+_inline static void __pbscalar_store(bytelizer_pbscalar_t scalar, void* item, uint64_t wire) {
+
+  switch(scalar) {
+    case bytelizer_pbscalar_sint32: {
+      int32_t _value = __zigzag_decode32((uint32_t)wire);
+      memcpy(item, &_value, sizeof(int32_t));
+      break;
+    }
+    case bytelizer_pbscalar_sint64: {
+      int64_t _value = __zigzag_decode64(wire);
+      memcpy(item, &_value, sizeof(int64_t));
+      break;
+    }
+    default:
+      if(__pbscalar_width(scalar) == sizeof(uint32_t)) {
+        uint32_t _value = (uint32_t)wire;
+        memcpy(item, &_value, sizeof(uint32_t));
+      }
+      else memcpy(item, &wire, sizeof(uint64_t));
+      break;
+  }
+}
+
+// store an element from the wire into the caller array
+_inline static void __pbarray_store(bytelizer_pbfield_t* field, uint64_t wire) {
+  __pbscalar_store(field->scalar, (uint8_t *)field->value.array.data +
+    (size_t)field->value.array.count++ * __pbscalar_width(field->scalar), wire);
+}
+
+// append an element to the caller array of a repeated field
+_inline static bool __pbarray_push(bytelizer_pbfield_t* field, uint64_t wire) {
+
+  if(field->value.array.count >= field->value.array.capacity) {
+    __bytelizer_log("protobuf repeated tag %u is over the capacity %u",
+      field->tag, field->value.array.capacity);
+    return false;
+  }
+
+  __pbarray_store(field, wire);
+  return true;
+}
+
+// skip a field by its wire type, NULL if it is truncated
+_inline static const uint8_t* __pbfield_skip(const uint8_t* cursor, const uint8_t* end, bytelizer_pbtype_t type) {
+
+  uint64_t _length;
+  uint32_t _prefix;
+
+  switch(type) {
+    case bytelizer_pbtype_varint:
+      _prefix = __varint_skip(cursor, end);
+      return _prefix ? cursor + _prefix : NULL;
+
+    case bytelizer_pbtype_32bit:
+      return end - cursor >= (ptrdiff_t)sizeof(uint32_t) ? cursor + sizeof(uint32_t) : NULL;
+
+    case bytelizer_pbtype_64bit:
+      return end - cursor >= (ptrdiff_t)sizeof(uint64_t) ? cursor + sizeof(uint64_t) : NULL;
+
+    // the body is jumped over
+    case bytelizer_pbtype_length_delimited:
+      if((_prefix = __varint_decode(cursor, end, &_length)) == 0 ||
+         _length > (uint64_t)(end - cursor - _prefix))
+        return NULL;
+      return cursor + _prefix + _length;
+
+    default:
+      return NULL;
+  }
+}
+
+// append the elements of a packed record to the caller array
+bool __pbarray_decode(const uint8_t* cursor, const uint8_t* end, bytelizer_pbfield_t* field);
+
+// empty the repeated fields of a struct and its sub structs, before decoding a message
+void __pbstruct_reset(bytelizer_pbfield_t* pbroot, const bytelizer_pbmask_t* mask, uint32_t depth);
+
+// decode a message into a protobuf struct, only the fields in the mask if there is one,
+// the repeated fields are emptied on the top level, the merged sub messages append to them
+bool __pbstruct_decode(const uint8_t* cursor, const uint8_t* end,
+bytelizer_pbfield_t* pbroot, const bytelizer_pbmask_t* mask, uint32_t depth);
+
+// decode a message at the cursor of the given length
+typedef bool (*__pbstruct_decoder_t)(const uint8_t* data, uint32_t length, void* userdata);
+
+// get a message of the given length from a linear (attached) buffer by a decoder,
+// the cursor is moved only if it is good
+bool __pbstruct_get(bytelizer_ctx_t* ctx, uint32_t length, __pbstruct_decoder_t decode, void* userdata);
+
+// a protobuf struct with an optional mask, the userdata of __pbstruct_get_masked
+typedef struct {
+  bytelizer_pbfield_t* pbroot;
+  const bytelizer_pbmask_t* mask;
+} __pbstruct_target_t;
+
+// the decoder of a __pbstruct_target_t
+bool __pbstruct_get_masked(const uint8_t* data, uint32_t length, void* userdata);
+
 /**
  * @brief protobuf struct start
 */
@@ -0,0 +1,310 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include <bytelizer/common.h>
+#include <bytelizer/error.h>
+#include "debug/log.h"
+#include "list.h"
+#include "codec.h"
+#include "advanced.h"
+#include "protobuf.h"
+#include "reverse.h"
+
+#define ALLOC_ALIGNMENT(x) \
+  (x < BYTELIZER_REALLOC \
+    ? BYTELIZER_REALLOC \
+    : (x + (sizeof(size_t) - 1)) & ~(sizeof(size_t) - 1))
+
+_inline static uint8_t* __rblock_data(bytelizer_block_t* block) {
+  return (uint8_t *)block + sizeof(bytelizer_block_t);
+}
+
+// save the written length of the buffer being written
+static void __rsync_wrotes(bytelizer_rctx_t* ctx) {
+
+  if(ctx->blocks == NULL) {
+    ctx->stack_wrotes = (uint32_t)(ctx->stack + ctx->stack_length - ctx->cursor);
+    return;
+  }
+
+  bytelizer_block_t* _block = *(bytelizer_block_t **)ctx->blocks->tail->data;
+  _block->wrotes = (uint32_t)(__rblock_data(_block) + _block->length - ctx->cursor);
+}
+
+bool bytelizer_rensure_available(bytelizer_rctx_t* ctx, size_t request) {
+
+  if((size_t)(ctx->cursor - ctx->limit) >= request)
+    return true;
+
+  bytelizer_ret_t _result;
+
+  // the buffer being written is finished
+  __rsync_wrotes(ctx);
+
+  if(ctx->blocks == NULL) {
+    if((_result = bytelizer_list_create(&ctx->blocks)) != bytelizer_ret_ok) {
+      __bytelizer_log("creating heap buffer failure: code %d", _result);
+      return false;
+    }
+  }
+
+  uint32_t _size = ALLOC_ALIGNMENT(request);
+  bytelizer_block_t* _block = (bytelizer_block_t *)malloc(sizeof(bytelizer_block_t) + _size);
+  if(_block == NULL)
+    return false;
+
+  if(!bytelizer_ok(_result, bytelizer_list_put(ctx->blocks, &_block, sizeof(void *), NULL))) {
+    __bytelizer_log("failure while trying to append buffer block: code %d", _result);
+    free(_block);
+    return false;
+  }
+
+  _block->length = _size;
+  _block->wrotes = 0;
+
+  // fill from the end
+  ctx->limit = __rblock_data(_block);
+  ctx->cursor = ctx->limit + _size;
+
+  __bytelizer_log("new reverse buffer block [%p], %u bytes", _block, _size);
+  return true;
+}
+
+void bytelizer_rput_bytes(bytelizer_rctx_t* ctx, const uint8_t* value, uint32_t length) {
+
+  if(value == NULL || length == 0)
+    return;
+
+  // the tail of the value goes into the space left
+  uint32_t _available = (uint32_t)(ctx->cursor - ctx->limit);
+  if(_available >= length) {
+    ctx->cursor -= length;
+    ctx->total_length += length;
+    memcpy(ctx->cursor, value, length);
+    return;
+  }
+
+  ctx->cursor -= _available;
+  ctx->total_length += _available;
+  memcpy(ctx->cursor, value + length - _available, _available);
+  length -= _available;
+
+  // the head goes into a new block
+  if(!bytelizer_rensure_available(ctx, length)) {
+    __bytelizer_log("reverse put bytes failed");
+    return;
+  }
+
+  ctx->cursor -= length;
+  ctx->total_length += length;
+  memcpy(ctx->cursor, value, length);
+}
+
+void bytelizer_rput_prefix(bytelizer_rctx_t* ctx, bytelizer_prefix_t prefix, uint32_t length) {
+
+  bytelizer_prefix_t _basetype, _lentype;
+  __parse_prefix(prefix, length, &_basetype, &_lentype);
+
+  if(_basetype == prefix_withself) {
+
+    // the varint width depends on the value itself
+    if(_lentype == prefix_varint) {
+      uint32_t _width = __varint_length(length);
+      while(__varint_length((uint64_t)length + _width) != _width)
+        _width = __varint_length((uint64_t)length + _width);
+      length += _width;
+    }
+
+    else length += (uint32_t)__get_prefix_length_by_type(_lentype);
+  }
+
+  switch(_lentype) {
+    case prefix_uint8: bytelizer_rput_uint8(ctx, (uint8_t)length); break;
+    case prefix_uint16le: bytelizer_rput_uint16_le(ctx, (uint16_t)length); break;
+    case prefix_uint16be: bytelizer_rput_uint16_be(ctx, (uint16_t)length); break;
+    case prefix_uint32le: bytelizer_rput_uint32_le(ctx, length); break;
+    case prefix_uint32be: bytelizer_rput_uint32_be(ctx, length); break;
+    case prefix_uint64le: bytelizer_rput_uint64_le(ctx, length); break;
+    case prefix_uint64be: bytelizer_rput_uint64_be(ctx, length); break;
+    case prefix_varint: bytelizer_rput_varint(ctx, length); break;
+    default:
+      __bytelizer_log("unsupported prefix type: %d", _lentype);
+      break;
+  }
+}
+
+_inline static void __rput_pbfixed(bytelizer_rctx_t* ctx, bytelizer_pbtype_t type, uint64_t value) {
+  if(type == bytelizer_pbtype_32bit)
+    bytelizer_rput_uint32_le(ctx, (uint32_t)value);
+  else
+    bytelizer_rput_uint64_le(ctx, value);
+}
+
+// the elements are written from the last one
+static void __rput_pbarray(bytelizer_rctx_t* ctx, const bytelizer_pbfield_t* field) {
+
+  if(field->value.array.count == 0) return;
+
+  bytelizer_pbtype_t _type = __pbscalar_wiretype(field->scalar);
+  uint64_t _tag = field->tag << 3 | field->type;
+
+  if(field->scalar == bytelizer_pbscalar_bytes) {
+    const bytelizer_pbslice_t* _items = field->value.array.data;
+    for(uint32_t i = field->value.array.count; i-- > 0;) {
+      bytelizer_rput_bytes(ctx, _items[i].data, _items[i].length);
+      bytelizer_rput_varint(ctx, _items[i].length);
+      bytelizer_rput_varint(ctx, _tag);
+    }
+    return;
+  }
+
+  if(field->scalar == bytelizer_pbscalar_message) {
+    const bytelizer_pbfield_t* const* _items = field->value.array.data;
+    for(uint32_t i = field->value.array.count; i-- > 0;) {
+      uint32_t _mark = bytelizer_rmark(ctx);
+      bytelizer_rput_pbstruct(ctx, _items[i]);
+      bytelizer_rput_varint(ctx, ctx->total_length - _mark);
+      bytelizer_rput_varint(ctx, _tag);
+    }
+    return;
+  }
+
+  // one tag per element
+  if(!__pbfield_packed(field)) {
+    if(_type == bytelizer_pbtype_varint) {
+      __pbarray_foreach(field, true, {
+        bytelizer_rput_varint(ctx, _wire);
+        bytelizer_rput_varint(ctx, _tag);
+      });
+    }
+    else {
+      __pbarray_foreach(field, true, {
+        __rput_pbfixed(ctx, _type, _wire);
+        bytelizer_rput_varint(ctx, _tag);
+      });
+    }
+    return;
+  }
+
+  // packed
+  uint32_t _mark = bytelizer_rmark(ctx);
+
+  if(_type == bytelizer_pbtype_varint) {
+    __pbarray_foreach(field, true, bytelizer_rput_varint(ctx, _wire));
+  }
+  else {
+    __pbarray_foreach(field, true, __rput_pbfixed(ctx, _type, _wire));
+  }
+
+  bytelizer_rput_varint(ctx, ctx->total_length - _mark);
+  bytelizer_rput_varint(ctx, _tag);
+}
+
+void bytelizer_rput_pbstruct(bytelizer_rctx_t* ctx, const bytelizer_pbfield_t* pbroot) {
+
+  if(pbroot == NULL) return;
+
+  // the fields are written from the last one
+  const bytelizer_pbfield_t* _field = pbroot;
+  while(_field->tag != 0) ++_field;
+
+  while(_field-- != pbroot) {
+
+    if(_field->repeated) {
+      __rput_pbarray(ctx, _field);
+      continue;
+    }
+
+    // put the value
+    switch(_field->type) {
+
+      case bytelizer_pbtype_varint:
+        bytelizer_rput_varint(ctx, __pbfield_varint(_field));
+        break;
+
+      case bytelizer_pbtype_32bit:
+        bytelizer_rput_uint32_le(ctx, _field->value.fixed32);
+        break;
+
+      case bytelizer_pbtype_64bit:
+        bytelizer_rput_uint64_le(ctx, _field->value.fixed64);
+        break;
+
+      case bytelizer_pbtype_length_delimited: {
+
+        // the body is in front of us, the length is known now
+        uint32_t _mark = bytelizer_rmark(ctx);
+
+        if(_field->subtags)
+          bytelizer_rput_pbstruct(ctx, _field->value.message);
+        else
+          bytelizer_rput_bytes(ctx, _field->value.length_delimited.data,
+                                    _field->value.length_delimited.length);
+
+        bytelizer_rput_varint(ctx, ctx->total_length - _mark);
+        break;
+      }
+
+      default:
+        __bytelizer_log("uknown tag %d", _field->tag);
+    }
+
+    // put the tag
+    bytelizer_rput_varint(ctx, _field->tag << 3 | _field->type);
+  }
+}
+
+uint32_t bytelizer_rcopy_to(void* userdata, bytelizer_rctx_t* ctx, bytelizer_callback_copy_t callback) {
+
+  __rsync_wrotes(ctx);
+
+  // the newest block first
+  if(ctx->blocks != NULL) {
+
+    bytelizer_list_node_t* _node = ctx->blocks->tail;
+    while(_node != NULL) {
+
+      bytelizer_block_t* _block = *(bytelizer_block_t **)_node->data;
+      callback(userdata, __rblock_data(_block) + _block->length - _block->wrotes, _block->wrotes);
+
+      _node = _node->prev;
+    }
+  }
+
+  // then the stack
+  callback(userdata, ctx->stack + ctx->stack_length - ctx->stack_wrotes, ctx->stack_wrotes);
+
+  return ctx->total_length;
+}
+
+static void __rput_forward(void* userdata, uint8_t* buffer, size_t length) {
+  bytelizer_put_bytes((bytelizer_ctx_t *)userdata, buffer, (uint32_t)length);
+}
+
+void bytelizer_put_rbytelizer(bytelizer_ctx_t* ctx, bytelizer_rctx_t* value) {
+  bytelizer_rcopy_to(ctx, value, __rput_forward);
+}
+
+void bytelizer_rdestroy_unsafe(bytelizer_rctx_t* ctx) {
+
+  if(ctx->blocks == NULL) return;
+
+  bytelizer_list_node_t* _node = ctx->blocks->head;
+  while(_node != NULL) {
+    free(*(bytelizer_block_t **)_node->data);
+    _node = _node->next;
+  }
+
+  bytelizer_list_destroy(ctx->blocks);
+  ctx->blocks = NULL;
+}
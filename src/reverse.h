@@ -0,0 +1,228 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#ifndef _BYTELIZER_REVERSE_H
+#define _BYTELIZER_REVERSE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <bytelizer/common.h>
+
+#include "compiler.h"
+#include "codec.h"
+#include "advanced.h"
+#include "bitwise.h"
+#include "varint.h"
+#include "protobuf.h"
+#include "debug/log.h"
+
+/*
+  The reverse context is written from back to front, so a length
+  prefix is written after its body, when the length is known already.
+
+    bytelizer_ralloc(ctx, 256);
+      uint32_t _mark = bytelizer_rmark(ctx);
+      bytelizer_rput_bytes(ctx, body, length);     // the body first
+      bytelizer_rput_prefix_since(ctx, prefix_length_only | prefix_varint, _mark);
+      bytelizer_rput_uint8(ctx, 0x0a);             // then the tag
+    bytelizer_rdestroy(ctx);
+
+  Every buffer is filled from its end. When the stack is full a heap
+  block is chained, the newest block holds the logically first bytes:
+
+    logical order:  [newest block] ... [oldest block] [stack]
+*/
+
+typedef struct _bytelizer_rctx_t {
+  uint32_t total_length;
+  uint8_t* stack;
+  uint32_t stack_wrotes;
+  uint32_t stack_length;
+  bytelizer_list_ctx_t* blocks;
+
+  // the first written byte, moves toward the limit
+  uint8_t* cursor;
+  uint8_t* limit;
+} bytelizer_rctx_t;
+
+/**
+ * @brief reverse bytelizer initialize
+ * @param ctx the reverse bytelizer context
+ * @param size the stack buffer size
+ */
+#define bytelizer_ralloc(ctx, size) { \
+  uint8_t ctx##_buf[size]; \
+  bytelizer_rctx_t* ctx = &(bytelizer_rctx_t) { \
+    .stack = ctx##_buf, \
+    .stack_length = size, \
+    .stack_wrotes = 0, \
+    .total_length = 0, \
+    .blocks = NULL, \
+    .cursor = ctx##_buf + size, \
+    .limit = ctx##_buf, \
+  };
+
+/**
+ * @brief release the heap blocks of a reverse context
+ * @param ctx the reverse bytelizer context
+ */
+void bytelizer_rdestroy_unsafe(bytelizer_rctx_t* ctx);
+
+#define bytelizer_rdestroy(ctx) bytelizer_rdestroy_unsafe(ctx); }
+
+/**
+ * @brief get reverse bytelizer length
+ * @param ctx the reverse bytelizer context
+ */
+#define bytelizer_rlength(ctx) ((ctx)->total_length)
+
+/**
+ * @brief remember the length so far, the body written after
+ * the mark can be prefixed by @ref bytelizer_rput_prefix_since
+ * @param ctx the reverse bytelizer context
+ */
+#define bytelizer_rmark(ctx) ((ctx)->total_length)
+
+/**
+ * @brief ensure the space in front of the cursor is available
+ * @param ctx the reverse bytelizer context
+ * @param request the request length
+ */
+bool bytelizer_rensure_available(bytelizer_rctx_t* ctx, size_t request);
+
+_inline static uint8_t* __rput_reserve(bytelizer_rctx_t* ctx, uint32_t size) {
+
+  if((size_t)(ctx->cursor - ctx->limit) < size &&
+     !bytelizer_rensure_available(ctx, size)) {
+    __bytelizer_log("reverse put failed, is it out of memory?");
+    return NULL;
+  }
+
+  ctx->cursor -= size;
+  ctx->total_length += size;
+  return ctx->cursor;
+}
+
+#define __DEFINE_RPUT(name, type, utype, swap) \
+  _inline static void bytelizer_rput_##name(bytelizer_rctx_t* ctx, type value) { \
+    uint8_t* _cursor = __rput_reserve(ctx, sizeof(type)); \
+    if(_cursor == NULL) return; \
+    utype _value; memcpy(&_value, &value, sizeof(type)); \
+    _value = swap(_value); \
+    memcpy(_cursor, &_value, sizeof(type)); \
+  }
+
+#define __rput_noswap(x) (x)
+
+__DEFINE_RPUT(uint8, uint8_t, uint8_t, __rput_noswap)
+__DEFINE_RPUT(int8, int8_t, uint8_t, __rput_noswap)
+__DEFINE_RPUT(uint16_le, uint16_t, uint16_t, bitwise_le16)
+__DEFINE_RPUT(uint32_le, uint32_t, uint32_t, bitwise_le32)
+__DEFINE_RPUT(uint64_le, uint64_t, uint64_t, bitwise_le64)
+__DEFINE_RPUT(int16_le, int16_t, uint16_t, bitwise_le16)
+__DEFINE_RPUT(int32_le, int32_t, uint32_t, bitwise_le32)
+__DEFINE_RPUT(int64_le, int64_t, uint64_t, bitwise_le64)
+__DEFINE_RPUT(float_le, float, uint32_t, bitwise_le32)
+__DEFINE_RPUT(double_le, double, uint64_t, bitwise_le64)
+__DEFINE_RPUT(uint16_be, uint16_t, uint16_t, bitwise_be16)
+__DEFINE_RPUT(uint32_be, uint32_t, uint32_t, bitwise_be32)
+__DEFINE_RPUT(uint64_be, uint64_t, uint64_t, bitwise_be64)
+__DEFINE_RPUT(int16_be, int16_t, uint16_t, bitwise_be16)
+__DEFINE_RPUT(int32_be, int32_t, uint32_t, bitwise_be32)
+__DEFINE_RPUT(int64_be, int64_t, uint64_t, bitwise_be64)
+__DEFINE_RPUT(float_be, float, uint32_t, bitwise_be32)
+__DEFINE_RPUT(double_be, double, uint64_t, bitwise_be64)
+
+#undef __DEFINE_RPUT
+
+/**
+ * @brief put varint in front of the cursor
+ * @param ctx the reverse bytelizer context
+ * @param value the value
+ */
+_inline static void bytelizer_rput_varint(bytelizer_rctx_t* ctx, uint64_t value) {
+
+  uint8_t _buffer[BYTELIZER_VARINT64_MAX];
+  uint32_t _length = __number_tovarint(value, _buffer);
+
+  uint8_t* _cursor = __rput_reserve(ctx, _length);
+  if(_cursor != NULL) memcpy(_cursor, _buffer, _length);
+}
+
+/**
+ * @brief put bytes in front of the cursor
+ * @param ctx the reverse bytelizer context
+ * @param value the value
+ * @param length the length of value
+ */
+void bytelizer_rput_bytes(bytelizer_rctx_t* ctx, const uint8_t* value, uint32_t length);
+
+/**
+ * @brief put string in front of the cursor
+ * @param ctx the reverse bytelizer context
+ * @param value the value
+ */
+#define bytelizer_rput_string(ctx, value) \
+  bytelizer_rput_bytes(ctx, (const uint8_t *)(value), (uint32_t)strlen(value))
+
+/**
+ * @brief put the length prefix of the body already written
+ * @param ctx the reverse bytelizer context
+ * @param prefix the prefix, the same as @ref bytelizer_put_bytes_ex
+ * @param length the length of the body
+ */
+void bytelizer_rput_prefix(bytelizer_rctx_t* ctx, bytelizer_prefix_t prefix, uint32_t length);
+
+/**
+ * @brief put the length prefix of everything written since a mark
+ * @param ctx the reverse bytelizer context
+ * @param prefix the prefix
+ * @param mark the mark, see @ref bytelizer_rmark
+ */
+#define bytelizer_rput_prefix_since(ctx, prefix, mark) \
+  bytelizer_rput_prefix(ctx, prefix, (ctx)->total_length - (mark))
+
+/**
+ * @brief put bytes with a length prefix in front of the cursor
+ * @param ctx the reverse bytelizer context
+ * @param value the value
+ * @param length the length of value
+ * @param prefix the prefix
+ */
+#define bytelizer_rput_bytes_ex(ctx, value, length, prefix) { \
+  bytelizer_rput_bytes(ctx, value, length); \
+  bytelizer_rput_prefix(ctx, prefix, length); \
+}
+
+/**
+ * @brief put a protobuf struct back to front, nested messages
+ * are prefixed in place without temporary buffers
+ * @param ctx the reverse bytelizer context
+ * @param pbroot the protobuf struct
+ */
+void bytelizer_rput_pbstruct(bytelizer_rctx_t* ctx, const bytelizer_pbfield_t* pbroot);
+
+/**
+ * @brief copy the reverse buffer to callback in the logical order
+ * @param userdata user data
+ * @param ctx the reverse bytelizer context
+ * @param callback the callback function
+ * @return the total length of wrote
+ */
+uint32_t bytelizer_rcopy_to(void* userdata, bytelizer_rctx_t* ctx, bytelizer_callback_copy_t callback);
+
+/**
+ * @brief put a reverse bytelizer into a bytelizer in the logical order
+ * @param ctx the bytelizer context
+ * @param value the reverse bytelizer context
+ */
+void bytelizer_put_rbytelizer(bytelizer_ctx_t* ctx, bytelizer_rctx_t* value);
+
+#endif /* _BYTELIZER_REVERSE_H */
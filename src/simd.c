@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <bytelizer/common.h>
+#include "simd.h"
+
+uint32_t bytelizer_simd_features(void) {
+
+  uint32_t _features = simd_feature_none;
+
+#if BYTELIZER_SIMD_X86
+  // the cpu model is filled by libgcc constructor,
+  // the builtins are only a load and a test afterwards
+  if(__builtin_cpu_supports("ssse3")) _features |= simd_feature_ssse3;
+  if(__builtin_cpu_supports("sse4.2")) _features |= simd_feature_sse42;
+  if(__builtin_cpu_supports("avx2")) _features |= simd_feature_avx2;
+  if(__builtin_cpu_supports("bmi2")) _features |= simd_feature_bmi2;
+#endif
+
+  return _features;
+}
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#ifndef _BYTELIZER_SIMD_H
+#define _BYTELIZER_SIMD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <bytelizer/common.h>
+
+#if BYTELIZER_ENABLE_SIMD == true && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__))
+  #define BYTELIZER_SIMD_X86 1
+  #include <immintrin.h>
+
+  /**
+   * @brief compile a single function for a specific instruction set
+   * the caller must check the cpu feature before calling it
+   */
+  #define __simd_target(x) __attribute__((target(x)))
+#else
+  #define BYTELIZER_SIMD_X86 0
+#endif
+
+typedef enum {
+  simd_feature_none  = 0,
+  simd_feature_ssse3 = 1 << 0,
+  simd_feature_sse42 = 1 << 1,
+  simd_feature_avx2  = 1 << 2,
+  simd_feature_bmi2  = 1 << 3,
+} bytelizer_simd_feature_t;
+
+/**
+ * @brief detect the simd features of the running cpu
+ * @return the feature bits, see @ref bytelizer_simd_feature_t
+ */
+uint32_t bytelizer_simd_features(void);
+
+/**
+ * @brief check whether the running cpu supports a feature
+ * @param feature the feature bits
+ */
+#define bytelizer_simd_has(feature) \
+  ((bytelizer_simd_features() & (feature)) == (feature))
+
+#endif /* _BYTELIZER_SIMD_H */
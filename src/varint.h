@@ -0,0 +1,353 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*******************************************************************************
+ * This file is the part of the Bytelizer library
+ *
+ * (C) Copyright 2024 TheSnowfield.
+ *
+ * Authors: TheSnowfield <17957399+TheSnowfield@users.noreply.github.com>
+ ****************************************************************************/
+
+#ifndef _BYTELIZER_VARINT_H
+#define _BYTELIZER_VARINT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdbool.h>
+#include <bytelizer/common.h>
+
+#include "compiler.h"
+#include "codec.h"
+#include "simd.h"
+#include "bitwise.h"
+#include "debug/log.h"
+
+/**
+ * @brief the maximal length of a varint encoded uint32
+ */
+#define BYTELIZER_VARINT32_MAX 5
+
+/**
+ * @brief the maximal length of a varint encoded uint64
+ */
+#define BYTELIZER_VARINT64_MAX 10
+
+// the pdep/pext path is taken when the compiler targets bmi2,
+// e.g. -mbmi2 or -march=native, the varint kernels are too small
+// to be dispatched at runtime
+#if BYTELIZER_SIMD_X86 && defined(__BMI2__)
+  #define BYTELIZER_VARINT_BMI2 1
+#else
+  #define BYTELIZER_VARINT_BMI2 0
+#endif
+
+#define __VARINT_PAYLOAD 0x7f7f7f7f7f7f7f7full
+#define __VARINT_CONTINUE 0x8080808080808080ull
+
+/**
+ * @brief get the encoded length of a varint
+ * @param value the value
+ */
+_inline static uint32_t __varint_length(uint64_t value) {
+
+  // tags and small numbers are the most
+  if(value < 0x80) return 1;
+
+#ifdef __GNUC__
+  // 7 bits a byte, (bits * 9 + 73) / 64 is the same as ceil(bits / 7)
+  return (uint32_t)(((63 - __builtin_clzll(value | 1)) * 9 + 73) / 64);
+#else
+  uint32_t _len = 1;
+  while(value > 127) {
+    value >>= 7;
+    ++_len;
+  }
+  return _len;
+#endif
+}
+
+// spread the low 56 bits into 7 bits a byte
+_inline static uint64_t __varint_spread(uint64_t value) {
+#if BYTELIZER_VARINT_BMI2
+  return _pdep_u64(value, __VARINT_PAYLOAD);
+#else
+  value = (value & 0x000000000fffffffull) | ((value & 0x00fffffff0000000ull) << 4);
+  value = (value & 0x00003fff00003fffull) | ((value & 0x0fffc0000fffc000ull) << 2);
+  value = (value & 0x007f007f007f007full) | ((value & 0x3f803f803f803f80ull) << 1);
+  return value;
+#endif
+}
+
+// gather 7 bits a byte into the low 56 bits
+_inline static uint64_t __varint_gather(uint64_t word) {
+#if BYTELIZER_VARINT_BMI2
+  return _pext_u64(word, __VARINT_PAYLOAD);
+#else
+  word &= __VARINT_PAYLOAD;
+  word = ((word & 0x7f007f007f007f00ull) >> 1) | (word & 0x007f007f007f007full);
+  word = ((word & 0x3fff00003fff0000ull) >> 2) | (word & 0x00003fff00003fffull);
+  word = ((word & 0x0fffffff00000000ull) >> 4) | (word & 0x000000000fffffffull);
+  return word;
+#endif
+}
+
+// the length of a varint from its stop bits
+_inline static uint32_t __varint_stop_length(uint64_t stops) {
+#ifdef __GNUC__
+  return (uint32_t)(__builtin_ctzll(stops) >> 3) + 1;
+#else
+  uint32_t _len = 1;
+  while((stops & 0x80) == 0) {
+    stops >>= 8;
+    ++_len;
+  }
+  return _len;
+#endif
+}
+
+/**
+ * @brief encode a varint, up to 8 bytes are written in a single store
+ * @param value the value
+ * @param varint the output buffer, must have BYTELIZER_VARINT64_MAX bytes
+ * writable even if the varint is shorter
+ * @return the varint length
+ */
+_inline static uint32_t __number_tovarint(uint64_t value, uint8_t* varint) {
+
+  if(value < 0x80) {
+    *varint = (uint8_t)value;
+    return 1;
+  }
+
+  uint32_t _len = __varint_length(value);
+
+  // set the continuation bit of every byte but the last one
+  uint64_t _word = __varint_spread(value);
+  if(_len <= sizeof(uint64_t)) {
+    _word |= __VARINT_CONTINUE & ((1ull << (8 * _len - 8)) - 1);
+    _word = bitwise_le64(_word);
+    memcpy(varint, &_word, sizeof(uint64_t));
+    return _len;
+  }
+
+  // the rare 9 or 10 bytes
+  _word = bitwise_le64(_word | __VARINT_CONTINUE);
+  memcpy(varint, &_word, sizeof(uint64_t));
+  varint[8] = (uint8_t)((value >> 56) & 0x7f) | (_len == 10 ? 0x80 : 0);
+  varint[9] = (uint8_t)(value >> 63);
+
+  return _len;
+}
+
+/**
+ * @brief encode a varint into a bounded buffer, the single store
+ * is used while the buffer has room for it
+ * @param value the value
+ * @param cursor the output buffer
+ * @param end the end of the output buffer, the varint must fit
+ * @return the varint length
+ */
+_inline static uint32_t __varint_encode(uint64_t value, uint8_t* cursor, uint8_t* end) {
+
+  if(value < 0x80) {
+    *cursor = (uint8_t)value;
+    return 1;
+  }
+
+  if(end - cursor >= BYTELIZER_VARINT64_MAX)
+    return __number_tovarint(value, cursor);
+
+  uint8_t _buffer[BYTELIZER_VARINT64_MAX];
+  uint32_t _len = __number_tovarint(value, _buffer);
+  memcpy(cursor, _buffer, _len);
+  return _len;
+}
+
+/**
+ * @brief zigzag encode a signed number, small negative numbers get short varints
+ * @param value the value
+ */
+_inline static uint64_t __zigzag_encode64(int64_t value) {
+  return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+_inline static uint32_t __zigzag_encode32(int32_t value) {
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+_inline static int64_t __zigzag_decode64(uint64_t value) {
+  return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+_inline static int32_t __zigzag_decode32(uint32_t value) {
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+/**
+ * @brief encode a varint into exactly `width` bytes,
+ * the unused groups are padded with redundant 0x80 bytes.
+ * @param value the value
+ * @param varint the output buffer
+ * @param width the output length, must not be less than the varint length
+ */
+_inline static void __number_tovarint_padded(uint64_t value, uint8_t* varint, uint32_t width) {
+
+  for(uint32_t i = 0; i < width - 1; ++i) {
+    varint[i] = (uint8_t)((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+
+  varint[width - 1] = (uint8_t)value;
+}
+
+/**
+ * @brief decode a varint of a known length
+ * @param varint the varint
+ * @param varint_len the varint length
+ */
+_inline static uint64_t __varint_to_number(uint8_t* varint, uint8_t varint_len) {
+
+  uint64_t _result = 0;
+
+  for(uint32_t i = 0; i < varint_len && i < BYTELIZER_VARINT64_MAX; ++i)
+    _result |= (uint64_t)(varint[i] & 0x7f) << (7 * i);
+
+  return _result;
+}
+
+/**
+ * @brief decode a varint from a bounded buffer
+ * @param cursor the first byte of the varint
+ * @param end the end of the readable buffer
+ * @param value the decoded value
+ * @return the varint length, 0 if it is truncated or overlong
+ */
+_inline static uint32_t __varint_decode(const uint8_t* cursor, const uint8_t* end, uint64_t* value) {
+
+  size_t _available = (size_t)(end - cursor);
+
+  if(_available != 0 && *cursor < 0x80) {
+    *value = *cursor;
+    return 1;
+  }
+
+  // one unaligned load covers varints up to 8 bytes
+  if(_available >= sizeof(uint64_t)) {
+
+    uint64_t _word;
+    memcpy(&_word, cursor, sizeof(uint64_t));
+    _word = bitwise_le64(_word);
+
+    uint64_t _stops = ~_word & __VARINT_CONTINUE;
+    if(_stops != 0) {
+      // keep the bytes until the first one without the continuation bit
+      *value = __varint_gather(_word & (_stops ^ (_stops - 1)));
+      return __varint_stop_length(_stops);
+    }
+
+    // the rare 9 or 10 bytes
+    uint64_t _value = __varint_gather(_word);
+    for(uint32_t i = 8; i < BYTELIZER_VARINT64_MAX && i < _available; ++i) {
+      _value |= (uint64_t)(cursor[i] & 0x7f) << (7 * i);
+      if((cursor[i] & 0x80) == 0) {
+        *value = _value;
+        return i + 1;
+      }
+    }
+
+    return 0;
+  }
+
+  uint64_t _value = 0;
+  for(uint32_t i = 0; i < _available; ++i) {
+    _value |= (uint64_t)(cursor[i] & 0x7f) << (7 * i);
+    if((cursor[i] & 0x80) == 0) {
+      *value = _value;
+      return i + 1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * @brief get the length of a varint without decoding it
+ * @param cursor the first byte of the varint
+ * @param end the end of the readable buffer
+ * @return the varint length, 0 if it is truncated or overlong
+ */
+_inline static uint32_t __varint_skip(const uint8_t* cursor, const uint8_t* end) {
+
+  size_t _available = (size_t)(end - cursor);
+
+  if(_available != 0 && *cursor < 0x80)
+    return 1;
+
+  // the first stop bit of a word
+  if(_available >= sizeof(uint64_t)) {
+    uint64_t _word;
+    memcpy(&_word, cursor, sizeof(uint64_t));
+
+    uint64_t _stops = ~bitwise_le64(_word) & __VARINT_CONTINUE;
+    if(_stops != 0) return __varint_stop_length(_stops);
+  }
+
+  for(uint32_t i = 0; i < _available && i < BYTELIZER_VARINT64_MAX; ++i)
+    if((cursor[i] & 0x80) == 0) return i + 1;
+
+  return 0;
+}
+
+_inline static void bytelizer_put_varint(bytelizer_ctx_t* ctx, uint64_t value) {
+  uint8_t _buffer[BYTELIZER_VARINT64_MAX];
+  uint32_t _length = __number_tovarint(value, _buffer);
+  bytelizer_put_bytes(ctx, _buffer, _length);
+}
+
+/**
+ * @brief get varint from an attached buffer
+ * @param ctx the bytelizer context
+ * @param value the value
+ * @return false if the varint is truncated, the cursor is not moved
+ */
+_inline static bool bytelizer_get_varint(bytelizer_ctx_t* ctx, uint64_t* value) {
+
+  uint64_t _value = 0;
+  uint32_t _length = __varint_decode(ctx->cursor, ctx->cursor + bytelizer_remain(ctx), &_value);
+
+  if(_length == 0) {
+    __bytelizer_log("truncated varint");
+    return false;
+  }
+
+  bytelizer_update_cursor(ctx, _length);
+  if(value) *value = _value;
+  return true;
+}
+
+/**
+ * @brief put zigzag encoded signed varint
+ * @param ctx the bytelizer context
+ * @param value the value
+ */
+_inline static void bytelizer_put_svarint(bytelizer_ctx_t* ctx, int64_t value) {
+  bytelizer_put_varint(ctx, __zigzag_encode64(value));
+}
+
+/**
+ * @brief get zigzag encoded signed varint from an attached buffer
+ * @param ctx the bytelizer context
+ * @param value the value
+ * @return false if the varint is truncated, the cursor is not moved
+ */
+_inline static bool bytelizer_get_svarint(bytelizer_ctx_t* ctx, int64_t* value) {
+
+  uint64_t _value = 0;
+  if(!bytelizer_get_varint(ctx, &_value))
+    return false;
+
+  if(value) *value = __zigzag_decode64(_value);
+  return true;
+}
+
+#endif /* _BYTELIZER_VARINT_H */